@@ -5,6 +5,38 @@
 #include <cstdlib>
 #include <fstream>
 #include <sstream>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <unordered_map>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <limits>
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <cstdint>
+#include <cstring>
+#include <csignal>
+#include <cerrno>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <climits>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
 
 using namespace std;
 
@@ -12,974 +44,6336 @@ struct Block { // Block structure
     int blockNumber; // Block number
     string currentHashNumber; // Current hash number
     string previousHashNumber; // Previous hash number
-    string currentTimeStamp; // Current time stamp
+    uint64_t currentTimeStamp; // Hybrid logical clock time stamp, formatted as text only when the block is shown or exported
     vector<pair<string, string> > information;  // Information stored in the block
     bool isHardDeleted; // Flag to indicate if block is deleted
     bool isSoftDeleted; // Flag to indicate if block is deleted
-
-    Block(int blockN, string currentH, string previousH, string timeStamp) { // Constructor for Block
+    uint64_t nonce; // Nonce found when the block was sealed by proof of work
+    int difficulty; // Leading zero bits the block's hash was sealed with, 0 when the block is not sealed by proof of work
+    string signer; // Username of the operator who wrote the block, empty for an unsigned block
+    string signerKey; // Ed25519 public key of the signer, 32 bytes
+    string signature; // Ed25519 signature of the signer over the block's body and hash, 64 bytes
+    string encoded; // Canonical encoding of the block, made once when it is linked into a chain and reused for hashing, the log, checkpoints, replication and the server, empty for blocks outside a chain
+
+    Block(int blockN, string currentH, string previousH, uint64_t timeStamp) { // Constructor for Block
         blockNumber = blockN; // Set block number
         currentHashNumber = currentH; // Set current hash number
         previousHashNumber = previousH; // Set previous hash number
         currentTimeStamp = timeStamp; // Set current time stamp
         isHardDeleted = false; // Set isHardDeleted flag to false
         isSoftDeleted = false; // Set isSoftDeleted flag to false
+        nonce = 0; // No nonce yet
+        difficulty = 0; // Not sealed by proof of work
+    }
+};
+
+const int CLOCK_LOGICAL_BITS = 16; // Low bits of a time stamp that count the stamps taken within the same millisecond
+const uint64_t MAX_CLOCK_DRIFT_MILLIS = 60000; // Furthest a stamp from another process or an earlier run may be ahead of the wall clock, a block stamped further ahead would drag every later stamp with it
+
+uint64_t coarseMillis() { // Function to read the wall clock in milliseconds from the coarse clock, it only moves every few milliseconds but is read without a system call
+#ifdef CLOCK_REALTIME_COARSE
+    timespec now; // Declare the time
+    clock_gettime(CLOCK_REALTIME_COARSE, &now); // Read the coarse clock
+    return static_cast<uint64_t>(now.tv_sec) * 1000 + static_cast<uint64_t>(now.tv_nsec) / 1000000; // Return the milliseconds
+#else
+    return static_cast<uint64_t>(chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch()).count()); // Return the milliseconds
+#endif
+}
+
+class HybridLogicalClock { // Clock giving every block a 64 bit time stamp, the wall clock milliseconds in the high 48 bits and a counter in the low 16 bits, stamps only ever increase and no two are equal however many threads take them
+private: // Private members
+    atomic<uint64_t> latest; // Latest stamp handed out or observed
+
+public: // Public members
+    HybridLogicalClock() : latest(0) { // Constructor for HybridLogicalClock
+    }
+
+    uint64_t now() { // Method to take a new stamp, later than every stamp handed out or observed before
+        uint64_t physical = coarseMillis() << CLOCK_LOGICAL_BITS; // Wall clock with the counter at zero
+        uint64_t previous = latest.load(memory_order_relaxed); // Latest stamp so far
+        uint64_t next; // Declare the new stamp
+        do { // Loop until no other thread took a stamp in between
+            next = physical > previous ? physical : previous + 1; // Follow the wall clock when it has moved on, otherwise count within the millisecond, a full counter carries into the milliseconds
+        } while (!latest.compare_exchange_weak(previous, next, memory_order_relaxed));
+        return next; // Return the stamp
+    }
+
+    bool isTooFarAhead(uint64_t stamp) const { // Method to check if a stamp is further ahead of the wall clock than the clocks of two processes may drift apart, a stamp received from another process is refused if it is
+        return (stamp >> CLOCK_LOGICAL_BITS) > coarseMillis() + MAX_CLOCK_DRIFT_MILLIS; // Compare the milliseconds of the stamp
+    }
+
+    void observe(uint64_t stamp) { // Method to merge a stamp taken by another shard or process, or recovered from this chain's own files, so every later stamp orders after it, even when the wall clock has stepped back since
+        uint64_t previous = latest.load(memory_order_relaxed); // Latest stamp so far
+        while (stamp > previous && !latest.compare_exchange_weak(previous, stamp, memory_order_relaxed)) { // Move the clock forward if the stamp is later
+        }
+    }
+};
+
+HybridLogicalClock blockClock; // Clock shared by every chain and shard of the process, so their stamps compare
+
+string formatTimeStamp(uint64_t stamp) { // Function to format a time stamp as text for displays and exports, in the ctime layout the chain has always been shown in
+    time_t seconds = static_cast<time_t>((stamp >> CLOCK_LOGICAL_BITS) / 1000); // Seconds part of the wall clock
+    tm local; // Declare the local time
+    localtime_r(&seconds, &local); // Convert to local time
+    char text[32]; // Buffer for the text
+    strftime(text, sizeof(text), "%a %b %e %H:%M:%S %Y\n", &local); // Format like ctime, which ends with a new line
+    return text; // Return the text
+}
+
+const int STAGE_COUNT = 8; // Number of stages a shipment goes through
+const char* const STAGE_NAMES[STAGE_COUNT] = { "Procurement Information", "Inventory Information", "Order Fulfillment Information", "Transportation Information", "Customer Delivery Satisfactory Information", "Quality Inspection Control Information", "Product Returns Information", "Product Worthiness Information" }; // Value of the "Block" key for each stage, in the order of the add block menu
+const string LOCAL_SHIPMENT = "LOCAL"; // Shipment ID used for blocks that carry no "Shipment ID", such as the blocks added from the menu
+
+int stageIndexOf(const Block& block) { // Function to find the stage of a block from its "Block" information, returns -1 if the block holds no stage
+    for (size_t i = 0; i < block.information.size(); ++i) { // For loop to find the "Block" key
+        if (block.information[i].first == "Block") { // If this is the stage name
+            for (int stage = 0; stage < STAGE_COUNT; stage++) { // For loop over the stage names
+                if (block.information[i].second == STAGE_NAMES[stage]) { // If the stage name matches
+                    return stage; // Return the stage
+                }
+            }
+            return -1; // The stage name is unknown
+        }
+    }
+    return -1; // The block holds no stage
+}
+
+string shipmentIdOf(const Block& block) { // Function to get the shipment a block belongs to
+    for (size_t i = 0; i < block.information.size(); ++i) { // For loop to find the "Shipment ID" key
+        if (block.information[i].first == "Shipment ID") { // If this is the shipment ID
+            return block.information[i].second; // Return the shipment ID
+        }
+    }
+    return LOCAL_SHIPMENT; // Blocks without a shipment ID belong to the local shipment
+}
+
+struct BlockNode; // Node of a chain, defined with the block encoding
+
+struct ShipmentLifecycle { // Latest block of each stage of one shipment
+    const BlockNode* stages[STAGE_COUNT]; // Node of the latest block of each stage, nullptr if the stage has not happened yet, the node is kept rather than the block so the view does not hold evicted blocks in memory
+
+    ShipmentLifecycle() { // Constructor for ShipmentLifecycle
+        for (int i = 0; i < STAGE_COUNT; i++) { // For loop over the stages
+            stages[i] = nullptr; // No block yet
+        }
     }
 };
 
-struct BlockNode { // BlockNode structure
-    Block data; // Block data
+void appendUint32(string& out, uint32_t value) { // Function to append a 32 bit number to a byte buffer, most significant byte first
+    out += static_cast<char>((value >> 24) & 0xFF); // Append the first byte
+    out += static_cast<char>((value >> 16) & 0xFF); // Append the second byte
+    out += static_cast<char>((value >> 8) & 0xFF); // Append the third byte
+    out += static_cast<char>(value & 0xFF); // Append the fourth byte
+}
+
+void appendString(string& out, const string& value) { // Function to append a length prefixed string to a byte buffer
+    appendUint32(out, static_cast<uint32_t>(value.size())); // Append the length of the string
+    out += value; // Append the characters of the string
+}
+
+bool readUint32(const string& in, size_t& pos, uint32_t& value) { // Function to read a 32 bit number from a byte buffer, returns false if the buffer is too short
+    if (in.size() < pos + 4) { // If there are not enough bytes left
+        return false; // Return false
+    }
+    value = 0; // Reset the value
+    for (int i = 0; i < 4; i++) { // For loop to read the 4 bytes
+        value = (value << 8) | static_cast<unsigned char>(in[pos + i]); // Shift in the next byte
+    }
+    pos += 4; // Move past the number
+    return true; // Return true
+}
+
+bool readString(const string& in, size_t& pos, string& value) { // Function to read a length prefixed string from a byte buffer, returns false if the buffer is too short
+    uint32_t length; // Declare the length of the string
+    if (!readUint32(in, pos, length) || in.size() - pos < length) { // If the length or the characters are missing
+        return false; // Return false
+    }
+    value = in.substr(pos, length); // Copy the characters of the string
+    pos += length; // Move past the string
+    return true; // Return true
+}
+
+void encodeBlockBody(const Block& block, string& out, bool withInformation = true) { // Function to encode the part of a block its hash is taken over, which is the start of its canonical encoding
+    appendUint32(out, static_cast<uint32_t>(block.blockNumber)); // Append the block number
+    appendString(out, block.previousHashNumber); // Append the previous hash number
+    appendUint32(out, static_cast<uint32_t>(block.currentTimeStamp >> 32)); // Append the high half of the time stamp
+    appendUint32(out, static_cast<uint32_t>(block.currentTimeStamp)); // Append the low half of the time stamp
+    out += static_cast<char>(block.difficulty); // Append the difficulty
+    appendString(out, block.signer); // Append the signer, inside the body so the hash and signature cover who wrote the block
+    appendString(out, block.signerKey); // Append the signer's public key
+    uint32_t count = withInformation ? static_cast<uint32_t>(block.information.size()) : 0; // Number of information pairs written
+    appendUint32(out, count); // Append the number of information pairs
+    for (uint32_t i = 0; i < count; i++) { // For loop to append the information pairs
+        appendString(out, block.information[i].first); // Append the key
+        appendString(out, block.information[i].second); // Append the value
+    }
+}
+
+void encodeBlockTrailer(const Block& block, string& out) { // Function to encode the part of a block that follows its body, the hash and nonce that seal the body, the signature over both and the deletion flags, which a deletion may change without changing the hash
+    appendString(out, block.currentHashNumber); // Append the current hash number
+    appendUint32(out, static_cast<uint32_t>(block.nonce >> 32)); // Append the high half of the nonce
+    appendUint32(out, static_cast<uint32_t>(block.nonce)); // Append the low half of the nonce
+    appendString(out, block.signature); // Append the signature
+    out += static_cast<char>((block.isSoftDeleted ? 1 : 0) | (block.isHardDeleted ? 2 : 0)); // Append the deletion flags
+}
+
+void encodeBlock(const Block& block, string& out, bool withDeletedInformation = false) { // Function to encode a block, the information of a soft deleted block is left out for clients and kept when it is replicated or logged
+    encodeBlockBody(block, out, !block.isSoftDeleted || withDeletedInformation); // Append the body
+    encodeBlockTrailer(block, out); // Append the trailer
+}
+
+size_t blockBodyLength(const Block& block) { // Function to get the length of the body at the start of a block's canonical encoding
+    return block.encoded.size() - (4 + block.currentHashNumber.size() + 8 + 4 + block.signature.size() + 1); // The trailer is the hash with its length, the nonce, the signature with its length and the flags
+}
+
+void appendEncodedBlock(const Block& block, string& out, bool withDeletedInformation = false) { // Function to append the encoding of a block, the encoding made when the block was linked is copied as it is unless soft deleted information has to be left out
+    if (!block.encoded.empty() && (!block.isSoftDeleted || withDeletedInformation)) { // If the canonical encoding can be used
+        out += block.encoded; // Copy it
+        return;
+    }
+    encodeBlock(block, out, withDeletedInformation); // Encode the block
+}
+
+bool decodeBlock(const string& in, size_t& pos, Block& block) { // Function to read a block written by encodeBlock, returns false if the bytes are damaged, the bytes read are kept as the block's encoding so linking it does not encode it again
+    size_t start = pos; // Start of the block
+    uint32_t blockNumber, count, timeHigh, timeLow, nonceHigh, nonceLow; // Declare the block number, the number of information pairs and the two halves of the time stamp and of the nonce
+    if (!readUint32(in, pos, blockNumber) || !readString(in, pos, block.previousHashNumber) || !readUint32(in, pos, timeHigh) || !readUint32(in, pos, timeLow) || in.size() - pos < 1) { // If the start of the body is damaged
+        return false;
+    }
+    block.blockNumber = static_cast<int>(blockNumber); // Set the block number
+    block.currentTimeStamp = (static_cast<uint64_t>(timeHigh) << 32) | timeLow; // Set the time stamp
+    block.difficulty = static_cast<unsigned char>(in[pos++]); // Set the difficulty
+    if (!readString(in, pos, block.signer) || !readString(in, pos, block.signerKey) || !readUint32(in, pos, count)) { // If the signer or the number of pairs is missing
+        return false;
+    }
+    block.information.clear(); // Clear the information
+    for (uint32_t i = 0; i < count; i++) { // For loop to read the information pairs
+        string key, value; // Declare the key and the value
+        if (!readString(in, pos, key) || !readString(in, pos, value)) { // If the pair is damaged
+            return false;
+        }
+        block.information.push_back(make_pair(key, value)); // Add the pair to the block
+    }
+    if (!readString(in, pos, block.currentHashNumber) || !readUint32(in, pos, nonceHigh) || !readUint32(in, pos, nonceLow) || !readString(in, pos, block.signature) || in.size() - pos < 1 || (in[pos] & ~3) != 0) { // If the trailer is damaged or has unknown flags
+        return false;
+    }
+    block.nonce = (static_cast<uint64_t>(nonceHigh) << 32) | nonceLow; // Set the nonce
+    block.isSoftDeleted = (in[pos] & 1) != 0; // Set the soft deleted flag
+    block.isHardDeleted = (in[pos] & 2) != 0; // Set the hard deleted flag
+    pos++; // Move past the flags
+    block.encoded.assign(in, start, pos - start); // Keep the bytes read
+    return true;
+}
+
+const uint64_t COLD_NONE = UINT64_MAX; // Cold offset of a block that is still in memory
+const int BLOCK_CACHE_SHARDS = 16; // Shards of the block cache, each with its own lock
+const uint64_t PREFETCH_BYTES = 256 * 1024; // Most bytes of the cold store read ahead once a thread reads evicted blocks one after another
+const int PREFETCH_STREAK = 2; // Reads in a row of neighbouring evicted blocks before a thread starts reading ahead
+const size_t PREFETCH_BLOCKS = 64; // Most blocks read ahead at a time, fewer when the cache is small so blocks read ahead do not push each other out before they are used
+const size_t DEFAULT_CACHE_BLOCKS = 16384; // Blocks the cache of the cold store holds unless --cache-blocks is given
+
+struct BlockNode { // BlockNode structure, a node is never changed once it is linked into a chain so snapshots can share it, apart from its whole block moving to the cold store
+    Block data; // Header of the block, everything but its information and encoding, always in memory so the chain can be walked without reading evicted blocks
     BlockNode* next; // Pointer to the next block
+    shared_ptr<const Block> resident; // Whole block while it is hot, emptied when it is evicted to the cold store, only read and written with atomic_load and atomic_store as snapshots, feeds and checkpoints may share the node
+    atomic<uint64_t> coldOffset; // Position of the whole block in the cold store once it has been evicted
+
+    BlockNode(const Block& block, bool keepEncoding = false) : data(block.blockNumber, block.currentHashNumber, block.previousHashNumber, block.currentTimeStamp), coldOffset(COLD_NONE) { // Constructor for BlockNode, the block is encoded here once unless the caller passes a block whose encoding is known to be current
+        next = nullptr; // Set next to nullptr
+        data.isHardDeleted = block.isHardDeleted; // Copy the hard deleted flag
+        data.isSoftDeleted = block.isSoftDeleted; // Copy the soft deleted flag
+        data.nonce = block.nonce; // Copy the nonce
+        data.difficulty = block.difficulty; // Copy the difficulty
+        data.signer = block.signer; // Copy the signer
+        data.signerKey = block.signerKey; // Copy the signer's key, kept in the header with the signature so every block claiming to be signed is found without reading evicted blocks
+        data.signature = block.signature; // Copy the signature
+        shared_ptr<Block> whole = make_shared<Block>(block); // Copy the whole block
+        if (!keepEncoding || whole->encoded.empty()) { // If the block has to be encoded, a copy of a block that was changed still carries the old encoding
+            whole->encoded.clear(); // Forget any old encoding
+            encodeBlock(*whole, whole->encoded, true); // Encode the block with all of its information
+        }
+        resident = whole; // The new block is hot
+    }
 
-    BlockNode(Block block) : data(block) { // Constructor for BlockNode
+    BlockNode(const BlockNode& other) : data(other.data), coldOffset(COLD_NONE) { // Copy constructor for BlockNode, the copy shares the whole block of the original, in memory or in the cold store, used when the nodes in front of a changed block are copied
         next = nullptr; // Set next to nullptr
+        resident = atomic_load(&other.resident); // Share the whole block, empty if it was evicted
+        coldOffset.store(other.coldOffset.load(memory_order_acquire), memory_order_release); // Read after the block, the offset is always set before the block is emptied
     }
 };
 
-class Blockchain { // Blockchain class
+class BlockCache { // Cache of the blocks read back from the cold store, split into shards with a lock each so threads reading different blocks rarely wait, every shard evicts with the CLOCK algorithm
 private: // Private members
-    BlockNode* head; // Pointer to the head of the blockchain
-    int currentBlockNumber; // Current block number
-    string hashNumber; // Hash number
+    struct Entry { // One cached block
+        uint64_t key; // Cold offset of the block
+        shared_ptr<const Block> block; // The block
+        bool referenced; // Reference bit, set by every hit and cleared as the hand passes, so a block is only evicted if it was not read for a whole turn of the hand
+        bool prefetched; // Flag to indicate that the block was read ahead and has not been asked for yet
+    };
+
+    struct Shard { // One shard of the cache
+        mutex lock; // Lock of the shard
+        vector<Entry> entries; // Slots of the shard, the hand turns over them
+        unordered_map<uint64_t, size_t> slots; // Slot of each cached block
+        size_t hand; // Next slot the hand looks at
+    };
+
+    Shard shards[BLOCK_CACHE_SHARDS]; // The shards
+    size_t shardCapacity; // Blocks each shard holds
+
+    Shard& shardOf(uint64_t key) { // Find the shard of a block, the offsets are mixed so neighbouring blocks spread over the shards
+        return shards[(key * 0x9E3779B97F4A7C15ULL) >> 60];
+    }
 
-    bool procurementAdded; // Procurement information added flag
-    bool inventoryAdded; // Inventory information added flag
-    bool orderFulfillmentAdded; // Order fulfillment information added flag
-    bool transportationAdded; // Transportation information added flag
-    bool customerDeliverySatisfactionAdded; // Customer delivery satisfaction information added flag
-    bool qualityControlAdded; // Quality control information added flag
-    bool productReturn; // Product return information added flag
-    bool productWorthiness; // Product worthiness information added flag
+public: // Public members
+    atomic<uint64_t> hits; // Reads served from the cache
+    atomic<uint64_t> misses; // Reads that went to the cold store
+    atomic<uint64_t> prefetched; // Blocks read ahead into the cache
+    atomic<uint64_t> prefetchHits; // Reads served by a block read ahead
+    atomic<uint64_t> evictions; // Blocks dropped to make room
+
+    BlockCache() : shardCapacity(0), hits(0), misses(0), prefetched(0), prefetchHits(0), evictions(0) { // Constructor for BlockCache, nothing is cached until a size is set
+        for (int i = 0; i < BLOCK_CACHE_SHARDS; i++) { // For loop over the shards
+            shards[i].hand = 0; // Start the hand at the first slot
+        }
+    }
+
+    void setCapacity(size_t blocks) { // Set the number of blocks the cache holds, called before any block is read from the cold store
+        shardCapacity = (blocks + BLOCK_CACHE_SHARDS - 1) / BLOCK_CACHE_SHARDS; // Split the blocks over the shards
+    }
+
+    size_t capacity() const { // Number of blocks the cache holds
+        return shardCapacity * BLOCK_CACHE_SHARDS;
+    }
+
+    shared_ptr<const Block> get(uint64_t key) { // Look a block up, returns an empty pointer on a miss
+        Shard& shard = shardOf(key); // Shard of the block
+        lock_guard<mutex> lock(shard.lock); // Lock the shard
+        unordered_map<uint64_t, size_t>::iterator it = shard.slots.find(key); // Find the block
+        if (it == shard.slots.end()) { // If the block is not cached
+            misses.fetch_add(1, memory_order_relaxed); // Count the miss
+            return shared_ptr<const Block>();
+        }
+        Entry& entry = shard.entries[it->second]; // Slot of the block
+        entry.referenced = true; // The block was used
+        if (entry.prefetched) { // If the block was read ahead
+            entry.prefetched = false;
+            prefetchHits.fetch_add(1, memory_order_relaxed); // Count the read ahead as useful
+        }
+        hits.fetch_add(1, memory_order_relaxed); // Count the hit
+        return entry.block;
+    }
+
+    void put(uint64_t key, const shared_ptr<const Block>& block, bool prefetch) { // Add a block, evicting the first block the hand finds unreferenced when the shard is full
+        if (shardCapacity == 0) { // If caching is off
+            return;
+        }
+        Shard& shard = shardOf(key); // Shard of the block
+        lock_guard<mutex> lock(shard.lock); // Lock the shard
+        if (shard.slots.count(key) != 0) { // If another thread cached the block first
+            return;
+        }
+        Entry entry; // Declare the new entry
+        entry.key = key;
+        entry.block = block;
+        entry.referenced = !prefetch; // A block read ahead has to be asked for before it survives the hand
+        entry.prefetched = prefetch;
+        if (prefetch) { // If the block was read ahead
+            prefetched.fetch_add(1, memory_order_relaxed); // Count it
+        }
+        if (shard.entries.size() < shardCapacity) { // If the shard has a free slot
+            shard.slots[key] = shard.entries.size(); // Use it
+            shard.entries.push_back(entry);
+            return;
+        }
+        while (shard.entries[shard.hand].referenced) { // Turn the hand past the blocks used since it last passed, clearing their bits
+            shard.entries[shard.hand].referenced = false;
+            shard.hand = (shard.hand + 1) % shard.entries.size();
+        }
+        shard.slots.erase(shard.entries[shard.hand].key); // Evict the block under the hand
+        shard.entries[shard.hand] = entry; // Put the new block in its slot
+        shard.slots[key] = shard.hand;
+        shard.hand = (shard.hand + 1) % shard.entries.size(); // Move the hand on
+        evictions.fetch_add(1, memory_order_relaxed); // Count the eviction
+    }
+};
+
+class ColdStore { // File the blocks evicted from memory are written to, each as its canonical encoding with its length before and after it, so a scan can read a run of blocks in either direction in one read
+private: // Private members
+    string filename; // Name of the file
+    int fd; // File descriptor, -1 until the first block is evicted
+    mutex writeLock; // Lock held while a block is written, blocks are only read without it
+    atomic<uint64_t> fileSize; // Bytes written so far, every byte below it belongs to a whole record
+    size_t hotBlocks; // Blocks each chain keeps in memory, 0 keeps every block in memory
+    bool reportedError; // Flag to indicate that a read or write error was already shown
+
+    bool readRange(uint64_t offset, size_t length, string& out) { // Read bytes of the file, returns false if they could not all be read
+        out.resize(length); // Make room for the bytes
+        for (size_t done = 0; done < length; ) { // For loop until every byte is read
+            ssize_t result = pread(fd, &out[done], length - done, static_cast<off_t>(offset + done)); // Read the rest
+            if (result <= 0 && !(result < 0 && errno == EINTR)) { // If the read failed or the file ended
+                return false;
+            }
+            done += result > 0 ? static_cast<size_t>(result) : 0; // Count the bytes read
+        }
+        coldReads.fetch_add(1, memory_order_relaxed); // Count the read
+        return true;
+    }
+
+    bool decodeRecord(const string& window, size_t pos, size_t length, Block& block) { // Decode the block of one record, checking the length written after it
+        size_t blockPos = pos + 4; // Start of the block
+        uint32_t trailingLength; // Length written after the block
+        size_t trailingPos = pos + 4 + length; // Position of the length after the block
+        return readUint32(window, trailingPos, trailingLength) && trailingLength == length && decodeBlock(window, blockPos, block) && blockPos == pos + 4 + length;
+    }
 
 public: // Public members
-    Blockchain() {  // Constructor for Blockchain
-        head = nullptr; // Set head to nullptr, which is the start of the blockchain
-        currentBlockNumber = 0; // Set current block number to 1
-        hashNumber = generateRandomHash(); // Generate a random hash number
-        time_t timeNow = time(0); // Get the current time
-        char* dateTime = ctime(&timeNow); // Convert the current time to a string so it can be stored in the block
-        Block firstBlock(currentBlockNumber, hashNumber, hashNumber, dateTime); // Create the first block
-        head = new BlockNode(firstBlock); // Set the head of the blockchain to the first block
+    BlockCache cache; // Blocks read back recently
+    atomic<uint64_t> evicted; // Blocks written to the file
+    atomic<uint64_t> coldReads; // Reads of the file
 
-        procurementAdded = false; // Set procurement information added flag to false
-        inventoryAdded = false; // Set inventory information added flag to false
-        orderFulfillmentAdded = false; // Set order fulfillment information added flag to false
-        transportationAdded = false; // Set transportation information added flag to false
-        customerDeliverySatisfactionAdded = false; // Set customer delivery satisfaction information added flag to false
-        qualityControlAdded = false; // Set quality control information added flag to false
-        productReturn = false; // Set product return information added flag to false
-        productWorthiness = false; // Set product worthiness information added flag to false
+    ColdStore() : fd(-1), fileSize(0), hotBlocks(0), reportedError(false), evicted(0), coldReads(0) { // Constructor for ColdStore, every block stays in memory until a limit is set
     }
 
-    void addBlock(const vector<pair<string, string> >& info) { // Add a block to the blockchain with the information passed in, information is a vector pair of strings
-        hashNumber = generateRandomHash(); // Generate a random hash number for the new block to be added
-        time_t timeNow = time(0); // Get the current time for the new block to be added
-        char* dateTime = ctime(&timeNow); // Convert the current time to a string so it can be stored in the block because the time is stored as a string in the block
-        int chosenBlockNumber; // Chosen block number by the user to add to the blockchain
+    ~ColdStore() { // Destructor for ColdStore, the file was removed from the directory when it was created, so closing it frees it
+        if (fd != -1) { // If the file was created
+            close(fd); // Close it
+        }
+    }
 
-        Block newBlock(currentBlockNumber, hashNumber, head->data.currentHashNumber, dateTime); // Create a new block with the current block number, the hash number, the previous hash number, and the current time
-        newBlock.information = info; // Set the information of the new block to the information passed in as a parameter
+    void configure(const string& file, size_t hotLimit, size_t cacheBlocks) { // Set the file, the number of blocks each chain keeps in memory and the size of the cache, called before any chain is built
+        filename = file;
+        hotBlocks = hotLimit;
+        cache.setCapacity(cacheBlocks);
+    }
 
-        do { // Loop until the user chooses to add all the blocks they want to add, only one of each block can be added
-            cout << "\nWhich block do you want to add? (1-8):" << endl; // Ask the user which block they want to add
-            cout << "\n1. Procurement Stage" << endl; // Add Procurement Stage
-            cout << "\n2. Inventory Storage Stage" << endl; // Add Inventory Storage Stage
-            cout << "\n3. Order Fulfillment Stage" << endl; // Add Order Fulfillment Stage
-            cout << "\n4. Transportation Stage" << endl; // Add Transportation Stage
-            cout << "\n5. Customer Delivery Satisfaction Stage" << endl; // Add Customer Delivery Satisfaction Stage
-            cout << "\n6. Quality Control Stage" << endl; // Add Quality Control Stage
-            cout << "\n7. Product Return Stage" << endl; // Add Product Return Stage
-            cout << "\n8. Product Worthiness Stage" << endl; // Add Product Worthiness Stage
-            cout << "\nEnter your choice: "; // Ask the user to enter their choice
-            cin >> chosenBlockNumber; // Get the user's choice
-            cin.ignore(); // Ignore the newline character
+    size_t hotLimit() const { // Number of blocks each chain keeps in memory, 0 when every block stays in memory
+        return hotBlocks;
+    }
 
-            if (cin.fail()) { // If the user enters an invalid input
-                cin.clear(); // Clear the input buffer
-                cin.ignore(numeric_limits<streamsize>::max(), '\n'); // Ignore the rest of the input
-                cout << "\nInvalid input. Please enter a number." << endl; // Tell the user that they entered an invalid input
-                continue; // Continue to the next iteration of the loop
+    uint64_t bytes() const { // Bytes written to the file
+        return fileSize.load(memory_order_acquire);
+    }
+
+    uint64_t store(const Block& block) { // Append an evicted block to the file, returns its offset, or COLD_NONE if it could not be written and has to stay in memory
+        lock_guard<mutex> lock(writeLock); // One writer at a time
+        if (fd == -1) { // If this is the first block evicted
+            string processFile = filename + "." + to_string(getpid()); // Name the file after the process, so two processes in one directory never share it
+            fd = open(processFile.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600); // Create the file, blocks evicted by an earlier run are in the log and checkpoints
+            if (fd != -1) { // If the file was created
+                unlink(processFile.c_str()); // Remove its name at once, it only holds copies of blocks in the log and checkpoints, so it is reached through fd alone and disappears even if the process crashes
+            } else { // If the file could not be created
+                if (!reportedError) { // Tell the user once
+                    cout << "Error: Unable to create cold store " << filename << ", blocks stay in memory." << endl;
+                    reportedError = true;
+                }
+                return COLD_NONE;
+            }
+        }
+        string record; // Declare the record
+        appendUint32(record, static_cast<uint32_t>(block.encoded.size())); // Append the length of the block
+        record += block.encoded; // Append the canonical encoding, it keeps any soft deleted information
+        appendUint32(record, static_cast<uint32_t>(block.encoded.size())); // Append the length again, so the record can be found from its end
+        uint64_t offset = fileSize.load(memory_order_relaxed); // The record goes at the end of the file
+        for (size_t written = 0; written < record.size(); ) { // For loop until the whole record is written
+            ssize_t result = pwrite(fd, record.data() + written, record.size() - written, static_cast<off_t>(offset + written)); // Write the rest
+            if (result < 0 && errno != EINTR) { // If the write failed
+                if (!reportedError) { // Tell the user once
+                    cout << "Error: Unable to write to cold store " << filename << ", blocks stay in memory." << endl;
+                    reportedError = true;
+                }
+                return COLD_NONE;
             }
+            written += result > 0 ? static_cast<size_t>(result) : 0; // Count the bytes written
+        }
+        fileSize.store(offset + record.size(), memory_order_release); // Readers may now read the record
+        evicted.fetch_add(1, memory_order_relaxed); // Count the block
+        return offset;
+    }
 
-            switch (chosenBlockNumber) { // Switch statement based on the user's choice
-                case 1: // If the user chooses 1
-                    if(procurementAdded) { // If procurement information has already been added
-                        cout << "Procurement Information has already been added." << endl; // Tell the user that procurement information has already been added
-                        chosenBlockNumber = 0; // Set chosen block number to 0 because the user has already added procurement information so the switch statement will break
-                        break; // Break out of the switch statement
-                    }
-                    addProcurementInformation(newBlock); // Add procurement information to the new block
-                    procurementAdded = true; // Set procurement information added flag to true
-                    break; // Break out of the switch statement
-                case 2:  // If the user chooses 2
-                    if(inventoryAdded) { // If inventory information has already been added
-                        cout << "Inventory Information has already been added." << endl; // Tell the user that inventory information has already been added
-                        chosenBlockNumber = 0; // Set chosen block number to 0 because the user has already added inventory information so the switch statement will break
-                        break; // Break out of the switch statement
-                    }
-                    addInventoryInformation(newBlock); // Add inventory information to the new block
-                    inventoryAdded = true; // Set inventory information added flag to true
-                    break; // Break out of the switch statement
-                case 3: // If the user chooses 3
-                    if(orderFulfillmentAdded) { // If order fulfillment information has already been added
-                        cout << "Order Fulfillment Information has already been added." << endl; // Tell the user that order fulfillment information has already been added
-                        chosenBlockNumber = 0; // Set chosen block number to 0 because the user has already added order fulfillment information so the switch statement will break
-                        break; // Break out of the switch statement
-                    }
-                    addOrderFulfillmentInformation(newBlock); // Add order fulfillment information to the new block
-                    orderFulfillmentAdded = true; // Set order fulfillment information added flag to true
-                    break; // Break out of the switch statement
-                case 4: // If the user chooses 4
-                    if(transportationAdded) { // If transportation information has already been added
-                        cout << "Transportation Information has already been added." << endl; // Tell the user that transportation information has already been added
-                        chosenBlockNumber = 0; // Set chosen block number to 0 because the user has already added transportation information so the switch statement will break
-                        break; // Break out of the switch statement
-                    }
-                    addTransportationInformation(newBlock); // Add transportation information to the new block
-                    transportationAdded = true; // Set transportation information added flag to true
-                    break; // Break out of the switch statement
-                case 5: // If the user chooses 5
-                    if(customerDeliverySatisfactionAdded) { // If customer delivery satisfaction information has already been added
-                        cout << "Customer Delivery Satisfaction Information has already been added." << endl; // Tell the user that customer delivery satisfaction information has already been added
-                        chosenBlockNumber = 0; // Set chosen block number to 0 because the user has already added customer delivery satisfaction information so the switch statement will break
-                        break; // Break out of the switch statement
+    shared_ptr<const Block> load(uint64_t offset) { // Read an evicted block from the cache, or from the file, reading the blocks around it ahead when this thread is scanning, returns an empty pointer if the file cannot be read
+        shared_ptr<const Block> found = cache.get(offset); // Try the cache first
+        if (found) { // If the block was cached
+            return found;
+        }
+        thread_local uint64_t lastStart = COLD_NONE; // Start of the lowest record this thread last read from the file
+        thread_local uint64_t lastEnd = COLD_NONE; // End of the highest record this thread last read from the file, where the record above it starts
+        thread_local uint64_t lastBelow = COLD_NONE; // Start of the record just below the lowest one read, COLD_NONE if it is not known
+        thread_local int streak = 0; // Reads in a row this thread made next to the one before, blocks are only read ahead once a scan is under way so reading two neighbouring blocks does not read sixty
+        uint64_t size = fileSize.load(memory_order_acquire); // Bytes that hold whole records
+        size_t prefetchLimit = min(PREFETCH_BLOCKS, cache.capacity() / 4); // Blocks read ahead at a time
+        uint64_t windowBytes = min(PREFETCH_BYTES, prefetchLimit * (size / max<uint64_t>(1, evicted.load(memory_order_relaxed)) + 1)); // Bytes read ahead, enough for that many blocks of the average size
+        bool forward = offset == lastEnd; // The scan reads the file upwards, as when oldest blocks are read first
+        bool backward = offset == lastBelow && lastStart - offset <= windowBytes; // The scan reads the file downwards, as when the chain is walked from its head
+        streak = forward || backward ? streak + 1 : 0; // Count the reads in a row
+        if (prefetchLimit > 1 && streak >= PREFETCH_STREAK) { // If this thread is scanning and the cache has room for the blocks read ahead
+            uint64_t windowEnd = forward ? min(size, offset + windowBytes) : lastStart; // End of the bytes read ahead, for a backward scan the start of the block read before, which the block asked for ends at
+            uint64_t windowStart = forward ? offset : (windowEnd > windowBytes ? windowEnd - windowBytes : 0); // Start of the bytes read ahead
+            string window; // Bytes read ahead
+            if (readRange(windowStart, static_cast<size_t>(windowEnd - windowStart), window)) { // If they could be read
+                vector<pair<uint64_t, shared_ptr<const Block> > > blocks; // Blocks found in the window
+                size_t pos = forward ? 0 : window.size(); // Forward scans parse from the start, backward scans from the end
+                while (blocks.size() < prefetchLimit) { // Parse the whole records in the window, starting with the block asked for
+                    uint32_t length; // Length of the block
+                    size_t recordStart; // Start of the record in the window
+                    if (forward) { // If parsing upwards
+                        size_t lengthPos = pos;
+                        if (!readUint32(window, lengthPos, length) || window.size() - pos < 8 + static_cast<size_t>(length)) { // If the record runs past the window
+                            break;
+                        }
+                        recordStart = pos;
+                    } else { // If parsing downwards
+                        size_t lengthPos = pos - 4;
+                        if (pos < 8 || !readUint32(window, lengthPos, length) || pos - 8 < length) { // If the record starts before the window
+                            break;
+                        }
+                        recordStart = pos - 8 - length;
                     }
-                    addCustomerDeliverySatisfactionInformation(newBlock); // Add customer delivery satisfaction information to the new block
-                    customerDeliverySatisfactionAdded = true; // Set customer delivery satisfaction information added flag to true
-                    break; // Break out of the switch statement
-                case 6: // If the user chooses 6
-                    if(qualityControlAdded) { // If quality control information has already been added
-                        cout << "Quality Control Information has already been added." << endl; // Tell the user that quality control information has already been added
-                        chosenBlockNumber = 0; // Set chosen block number to 0 because the user has already added quality control information so the switch statement will break
-                        break; // Break out of the switch statement
+                    shared_ptr<Block> block = make_shared<Block>(0, "", "", 0); // Declare the block
+                    if (!decodeRecord(window, recordStart, length, *block)) { // If the record is damaged
+                        break;
                     }
-                    addQualityInspectionControlInformation(newBlock); // Add quality control information to the new block
-                    qualityControlAdded = true; // Set quality control information added flag to true
-                    break; // Break out of the switch statement
-                case 7: // If the user chooses 7
-                    if(productReturn) { // If product return information has already been added
-                        cout << "Product Return Information has already been added." << endl; // Tell the user that product return information has already been added
-                        chosenBlockNumber = 0; // Set chosen block number to 0 because the user has already added product return information so the switch statement will break
-                        break; // Break out of the switch statement
-                    } // Add product return information to the new block 
-                    addProductReturnInformation(newBlock); // Add product return information to the new block
-                    productReturn = true; // Set product return information added flag to true
-                    break; // Break out of the switch statement
-                case 8: // If the user chooses 8
-                    if(productWorthiness) { // If product worthiness information has already been added
-                        cout << "Product Worthiness Information has already been added." << endl; // Tell the user that product worthiness information has already been added
-                        chosenBlockNumber = 0; // Set chosen block number to 0 because the user has already added product worthiness information so the switch statement will break
-                        break; // Break out of the switch statement
+                    blocks.push_back(make_pair(windowStart + recordStart, shared_ptr<const Block>(block))); // Keep the block
+                    pos = forward ? recordStart + 8 + length : recordStart; // Move past the record
+                }
+                for (size_t i = 0; i < blocks.size(); ++i) { // For loop to cache the blocks
+                    if (blocks[i].first == offset) { // If this is the block asked for
+                        found = blocks[i].second;
                     }
-                    addProductWorthinessInformation(newBlock); // Add product worthiness information to the new block
-                    productWorthiness = true; // Set product worthiness information added flag to true
-                    break; // Break out of the switch statement
-                default:
-                    cout << "Invalid choice. Please enter a number between 1-8." << endl; // Tell the user that their choice is invalid
-                    break; // Break out of the switch statement
+                    cache.put(blocks[i].first, blocks[i].second, blocks[i].first != offset); // The other blocks were read ahead
+                }
+                if (found) { // If the window held the block
+                    uint32_t belowLength; // Length of the block below the lowest one read
+                    size_t belowPos = pos - 4; // Its length is written just before the lowest record read
+                    lastStart = forward ? offset : blocks.back().first; // Lowest record read
+                    lastEnd = forward ? blocks.back().first + 8 + blocks.back().second->encoded.size() : windowEnd; // Highest record read
+                    lastBelow = !forward && pos >= 4 && readUint32(window, belowPos, belowLength) && windowStart + pos >= 8 + static_cast<uint64_t>(belowLength) ? windowStart + pos - 8 - belowLength : COLD_NONE; // A backward scan continues at the record below
+                    return found;
+                }
             }
-        } while (chosenBlockNumber < 1 || chosenBlockNumber > 8); // Keep asking the user to enter a number between 1-8 until they do so
-        
-        if (currentBlockNumber == 0) { // If the current block number is 1
-            head->data.information = newBlock.information;  // Set the head's data to the new block's information
-        } else { // If the current block number is not 1
-            BlockNode* newNode = new BlockNode(newBlock); // Create a new block node with the new block's information
-            newNode->next = head; // Set the new node's next to the head
-            head = newNode; // Set the head to the new node
         }
-
-        currentBlockNumber++; // Increment the current block number
+        string record; // The record on its own, when this thread is not scanning or the block did not fit in the window
+        uint32_t length, belowLength = 0; // Length of the block and of the block below it
+        uint64_t first = offset >= 8 ? offset - 4 : offset; // The length of the block below is read with the length of the block, so a scan going down is spotted on the next read
+        size_t pos = 0; // Position in the record
+        shared_ptr<Block> block = make_shared<Block>(0, "", "", 0); // Declare the block
+        if (offset >= size || !readRange(first, static_cast<size_t>(offset + 4 - first), record) || (first < offset && !readUint32(record, pos, belowLength)) || !readUint32(record, pos, length) || offset + 8 + length > size || !readRange(offset, 8 + static_cast<size_t>(length), record) || !decodeRecord(record, 0, length, *block)) { // If the record cannot be read
+            return shared_ptr<const Block>();
+        }
+        lastStart = offset; // Remember where this thread read
+        lastEnd = offset + 8 + length;
+        lastBelow = first < offset && offset >= 8 + static_cast<uint64_t>(belowLength) ? offset - 8 - belowLength : COLD_NONE;
+        cache.put(offset, block, false); // Cache the block
+        return block;
+    }
+};
+
+ColdStore coldStore; // Cold store and cache shared by every chain, configured from the command line
+
+shared_ptr<const Block> blockOf(const BlockNode* node) { // Function to get the whole block of a node, from memory while it is hot and from the cache or the cold store once it has been evicted
+    shared_ptr<const Block> block = atomic_load(&node->resident); // Read the block if it is hot
+    if (block) { // If it is
+        return block;
+    }
+    block = coldStore.load(node->coldOffset.load(memory_order_acquire)); // The offset is set before the block is emptied
+    if (!block) { // If the cold store could not be read
+        cout << "Error: Unable to read block " << node->data.blockNumber << " from the cold store." << endl; // Tell the user, only the header of the block is shown
+        block = make_shared<Block>(node->data);
+    }
+    return block;
+}
+
+const int SEGMENT_BLOCKS = 1024; // Number of blocks stored in each persisted segment
+
+class PayloadDictionary { // Dictionary of strings that repeat across the blocks of a segment, such as the information keys and the status values, each entry is stored as a one byte code when a block is compressed
+private: // Private members
+    vector<string> entries; // Dictionary entries, code 1 stands for the first entry, code 0 marks a literal string
+    unordered_map<string, unsigned char> codes; // Code of each dictionary entry
+
+    void countString(unordered_map<string, int>& counts, const string& value) { // Count one use of a string while training
+        if (value.size() > 1) { // Strings of one character are cheaper as literals
+            counts[value]++; // Count the string
+        }
+    }
+
+public: // Public members
+    void train(const vector<shared_ptr<const Block> >& blocks) { // Build the dictionary from the strings that save the most bytes across the blocks passed in
+        unordered_map<string, int> counts; // Number of times each string appears
+        for (size_t i = 0; i < blocks.size(); ++i) { // For loop to count the strings of every block
+            for (size_t j = 0; j < blocks[i]->information.size(); ++j) { // For loop to count the information
+                countString(counts, blocks[i]->information[j].first); // Count the key
+                countString(counts, blocks[i]->information[j].second); // Count the value
+            }
+        }
+
+        vector<pair<long, string> > savings; // Bytes saved by each repeated string
+        for (unordered_map<string, int>::const_iterator it = counts.begin(); it != counts.end(); ++it) { // For loop over the counted strings
+            if (it->second > 1) { // Strings seen once are not worth a dictionary entry
+                savings.push_back(make_pair(-static_cast<long>(it->second) * static_cast<long>(it->first.size()), it->first)); // Negative so the largest saving sorts first
+            }
+        }
+        sort(savings.begin(), savings.end()); // Sort by the bytes saved
+
+        entries.clear(); // Clear the old dictionary
+        codes.clear(); // Clear the old codes
+        for (size_t i = 0; i < savings.size() && entries.size() < 255; ++i) { // For loop to keep the best 255 strings
+            add(savings[i].second); // Add the string to the dictionary
+        }
+    }
+
+    void add(const string& entry) { // Add an entry to the dictionary, used when a dictionary is read back from a segment
+        codes[entry] = static_cast<unsigned char>(entries.size() + 1); // Give the entry the next code
+        entries.push_back(entry); // Store the entry
+    }
+
+    size_t size() { // Method to get the number of dictionary entries
+        return entries.size(); // Return the number of entries
+    }
+
+    const string& entry(size_t index) { // Method to get a dictionary entry
+        return entries[index]; // Return the entry
+    }
+
+    void compressString(const string& value, string& out) { // Append a string to a compressed payload, as a code when it is in the dictionary and as a literal otherwise
+        unordered_map<string, unsigned char>::const_iterator it = codes.find(value); // Look the string up
+        if (it != codes.end()) { // If the string is in the dictionary
+            out += static_cast<char>(it->second); // Append its code
+            return;
+        }
+        out += static_cast<char>(0); // Mark a literal
+        size_t length = value.size(); // Length of the literal
+        while (length >= 0x80) { // Append the length seven bits at a time
+            out += static_cast<char>((length & 0x7F) | 0x80); // Append the low bits with the continue flag
+            length >>= 7; // Move to the next bits
+        }
+        out += static_cast<char>(length); // Append the last bits
+        out += value; // Append the characters
+    }
+
+    bool decompressString(const string& in, size_t& pos, string& value) { // Read a string from a compressed payload, returns false if the payload is damaged
+        if (pos >= in.size()) { // If the payload is too short
+            return false;
+        }
+        unsigned char code = static_cast<unsigned char>(in[pos++]); // Read the code
+        if (code != 0) { // If the string is in the dictionary
+            if (code > entries.size()) { // If the code is unknown
+                return false;
+            }
+            value = entries[code - 1]; // Copy the dictionary entry
+            return true;
+        }
+        size_t length = 0; // Length of the literal
+        for (int shift = 0; ; shift += 7) { // Read the length seven bits at a time
+            if (pos >= in.size() || shift > 28) { // If the length is damaged
+                return false;
+            }
+            unsigned char part = static_cast<unsigned char>(in[pos++]); // Read the next bits
+            length |= static_cast<size_t>(part & 0x7F) << shift; // Add them to the length
+            if ((part & 0x80) == 0) { // If these were the last bits
+                break;
+            }
+        }
+        if (in.size() - pos < length) { // If the characters are missing
+            return false;
+        }
+        value = in.substr(pos, length); // Copy the characters
+        pos += length; // Move past the literal
+        return true;
+    }
+
+    string compressBlock(const Block& block) { // Compress one block on its own, so any block of a segment can be read without the others
+        string out; // Declare the compressed payload
+        appendUint32(out, static_cast<uint32_t>(block.blockNumber)); // Append the block number
+        compressString(block.currentHashNumber, out); // Append the current hash number
+        compressString(block.previousHashNumber, out); // Append the previous hash number
+        appendUint32(out, static_cast<uint32_t>(block.currentTimeStamp >> 32)); // Append the high half of the time stamp
+        appendUint32(out, static_cast<uint32_t>(block.currentTimeStamp)); // Append the low half of the time stamp
+        appendUint32(out, static_cast<uint32_t>(block.nonce >> 32)); // Append the high half of the nonce
+        appendUint32(out, static_cast<uint32_t>(block.nonce)); // Append the low half of the nonce
+        out += static_cast<char>(block.difficulty); // Append the difficulty
+        out += static_cast<char>((block.isSoftDeleted ? 1 : 0) | (block.isHardDeleted ? 2 : 0)); // Append the deletion flags
+        compressString(block.signer, out); // Append the signer
+        compressString(block.signerKey, out); // Append the signer's public key
+        compressString(block.signature, out); // Append the signature
+        appendUint32(out, static_cast<uint32_t>(block.information.size())); // Append the number of information pairs
+        for (size_t i = 0; i < block.information.size(); ++i) { // For loop to append the information pairs
+            compressString(block.information[i].first, out); // Append the key
+            compressString(block.information[i].second, out); // Append the value
+        }
+        return out; // Return the compressed payload
+    }
+
+    bool decompressBlock(const string& in, Block& block) { // Rebuild a block from its compressed payload, returns false if the payload is damaged
+        size_t pos = 0; // Read position in the payload
+        uint32_t blockNumber, count, timeHigh, timeLow, nonceHigh, nonceLow; // Declare the block number, the number of information pairs and the two halves of the time stamp and of the nonce
+        if (!readUint32(in, pos, blockNumber) || !decompressString(in, pos, block.currentHashNumber) || !decompressString(in, pos, block.previousHashNumber) || !readUint32(in, pos, timeHigh) || !readUint32(in, pos, timeLow) || !readUint32(in, pos, nonceHigh) || !readUint32(in, pos, nonceLow) || in.size() - pos < 2) { // If the header is damaged
+            return false;
+        }
+        block.blockNumber = static_cast<int>(blockNumber); // Set the block number
+        block.nonce = (static_cast<uint64_t>(nonceHigh) << 32) | nonceLow; // Set the nonce
+        block.difficulty = static_cast<unsigned char>(in[pos++]); // Set the difficulty
+        block.currentTimeStamp = (static_cast<uint64_t>(timeHigh) << 32) | timeLow; // Set the time stamp
+        block.isSoftDeleted = (in[pos] & 1) != 0; // Set the soft deleted flag
+        block.isHardDeleted = (in[pos] & 2) != 0; // Set the hard deleted flag
+        pos++; // Move past the flags
+        if (!decompressString(in, pos, block.signer) || !decompressString(in, pos, block.signerKey) || !decompressString(in, pos, block.signature) || !readUint32(in, pos, count)) { // If the signature or the number of pairs is missing
+            return false;
+        }
+        block.information.clear(); // Clear the information
+        for (uint32_t i = 0; i < count; i++) { // For loop to read the information pairs
+            string key, value; // Declare the key and the value
+            if (!decompressString(in, pos, key) || !decompressString(in, pos, value)) { // If the pair is damaged
+                return false;
+            }
+            block.information.push_back(make_pair(key, value)); // Add the pair to the block
+        }
+        return true;
+    }
+};
+
+bool isIdField(const string& key) { // Function to check if an information key holds a Supplier ID, Warehouse ID or Customer ID
+    return key == "Supplier ID" || key == "Warehouse ID" || key == "Customer ID"; // Return true for the ID keys
+}
+
+class BloomFilter { // Bloom filter over the IDs of one segment, a negative answer means the ID is certainly not in the segment so the segment does not need to be scanned
+private: // Private members
+    static const size_t BITS = SEGMENT_BLOCKS * 16; // Number of bits, enough for one ID per block at a false positive rate of about 0.1%
+    static const int HASHES = 6; // Number of bits set for each ID
+    string bits; // The bits of the filter, eight to a character
+
+    void hashes(const string& id, uint64_t& first, uint64_t& second) { // Work out the two hashes that every bit position is made from
+        first = 14695981039346656037ULL; // FNV-1a offset basis
+        for (size_t i = 0; i < id.size(); ++i) { // For loop over the characters of the ID
+            first = (first ^ static_cast<unsigned char>(id[i])) * 1099511628211ULL; // Mix in the character
+        }
+        second = (first >> 33) | 1; // The second hash is odd so every bit position can be reached
+    }
+
+public: // Public members
+    BloomFilter() { // Constructor for BloomFilter, starts with no IDs
+        bits.assign(BITS / 8, '\0'); // Clear every bit
+    }
+
+    void add(const string& id) { // Add an ID to the filter
+        uint64_t first, second; // Declare the two hashes
+        hashes(id, first, second); // Work out the hashes
+        for (int i = 0; i < HASHES; i++) { // For loop to set the bits
+            size_t bit = static_cast<size_t>((first + i * second) % BITS); // Position of the bit
+            bits[bit / 8] |= static_cast<char>(1 << (bit % 8)); // Set the bit
+        }
+    }
+
+    bool mayContain(const string& id) { // Method to check an ID, returns false only if the ID was never added
+        uint64_t first, second; // Declare the two hashes
+        hashes(id, first, second); // Work out the hashes
+        for (int i = 0; i < HASHES; i++) { // For loop to check the bits
+            size_t bit = static_cast<size_t>((first + i * second) % BITS); // Position of the bit
+            if ((bits[bit / 8] & (1 << (bit % 8))) == 0) { // If the bit is not set
+                return false; // The ID was never added
+            }
+        }
+        return true; // The ID may have been added
+    }
+
+    const string& data() { // Method to get the bits so they can be saved with a segment
+        return bits; // Return the bits
+    }
+
+    bool load(const string& saved) { // Load bits saved with a segment, returns false if they do not fit the filter
+        if (saved.size() != BITS / 8) { // If the saved filter has the wrong size
+            return false;
+        }
+        bits = saved; // Use the saved bits
+        return true;
+    }
+};
+
+bool readStreamUint32(istream& in, uint32_t& value) { // Function to read a 32 bit number from a file, most significant byte first
+    unsigned char bytes[4]; // Declare the bytes of the number
+    if (!in.read(reinterpret_cast<char*>(bytes), 4)) { // If the number could not be read
+        return false;
+    }
+    value = (static_cast<uint32_t>(bytes[0]) << 24) | (static_cast<uint32_t>(bytes[1]) << 16) | (static_cast<uint32_t>(bytes[2]) << 8) | bytes[3]; // Put the bytes together
+    return true;
+}
+
+bool readStreamString(istream& in, string& value) { // Function to read a length prefixed string from a file
+    uint32_t length; // Declare the length of the string
+    if (!readStreamUint32(in, length) || length > (1u << 20)) { // If the length is missing or not believable
+        return false;
+    }
+    value.resize(length); // Make room for the characters
+    return length == 0 || static_cast<bool>(in.read(&value[0], length)); // Read the characters
+}
+
+const uint32_t SHA256_ROUND_CONSTANTS[64] = { // Round constants of SHA-256
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+const uint32_t SHA256_INITIAL_STATE[8] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 }; // Starting state of SHA-256
+const int HASH_LANES = 8; // Number of nonces hashed side by side by the proof of work search
+const uint64_t NONCE_CHUNK = 4096; // Number of nonces a search thread claims at a time
+const int MAX_PROOF_OF_WORK_DIFFICULTY = 32; // Most leading zero bits a block can be sealed with, about four billion hashes per block on average, beyond this a search runs for hours
+
+inline uint32_t rotateRight(uint32_t value, int bits) { // Function to rotate a 32 bit number right
+    return (value >> bits) | (value << (32 - bits)); // Return the rotated number
+}
+
+void sha256Compress(uint32_t state[8], const unsigned char* chunk) { // Function to mix one 64 byte chunk into a SHA-256 state
+    uint32_t w[64]; // Message schedule
+    for (int i = 0; i < 16; i++) { // For loop to read the chunk as 16 words, most significant byte first
+        w[i] = (static_cast<uint32_t>(chunk[i * 4]) << 24) | (static_cast<uint32_t>(chunk[i * 4 + 1]) << 16) | (static_cast<uint32_t>(chunk[i * 4 + 2]) << 8) | chunk[i * 4 + 3]; // Read the word
+    }
+    for (int i = 16; i < 64; i++) { // For loop to extend the schedule
+        uint32_t s0 = rotateRight(w[i - 15], 7) ^ rotateRight(w[i - 15], 18) ^ (w[i - 15] >> 3); // First mixing term
+        uint32_t s1 = rotateRight(w[i - 2], 17) ^ rotateRight(w[i - 2], 19) ^ (w[i - 2] >> 10); // Second mixing term
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1; // Extend the schedule
+    }
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4], f = state[5], g = state[6], h = state[7]; // Working variables
+    for (int i = 0; i < 64; i++) { // For loop over the rounds
+        uint32_t t1 = h + (rotateRight(e, 6) ^ rotateRight(e, 11) ^ rotateRight(e, 25)) + ((e & f) ^ (~e & g)) + SHA256_ROUND_CONSTANTS[i] + w[i]; // First temporary
+        uint32_t t2 = (rotateRight(a, 2) ^ rotateRight(a, 13) ^ rotateRight(a, 22)) + ((a & b) ^ (a & c) ^ (b & c)); // Second temporary
+        h = g; g = f; f = e; e = d + t1; d = c; c = b; b = a; a = t1 + t2; // Rotate the working variables
+    }
+    state[0] += a; state[1] += b; state[2] += c; state[3] += d; state[4] += e; state[5] += f; state[6] += g; state[7] += h; // Add the chunk into the state
+}
+
+void sha256CompressLanes(uint32_t state[8][HASH_LANES], const uint32_t words[16][HASH_LANES]) { // Function to mix one chunk into each of HASH_LANES SHA-256 states at once, the lane is the inner loop everywhere so the compiler can use vector instructions
+    uint32_t w[64][HASH_LANES]; // Message schedule of every lane
+    for (int i = 0; i < 16; i++) { // For loop to copy the chunk words
+        for (int lane = 0; lane < HASH_LANES; lane++) { // For loop over the lanes
+            w[i][lane] = words[i][lane]; // Copy the word
+        }
+    }
+    for (int i = 16; i < 64; i++) { // For loop to extend the schedules
+        for (int lane = 0; lane < HASH_LANES; lane++) { // For loop over the lanes
+            uint32_t s0 = rotateRight(w[i - 15][lane], 7) ^ rotateRight(w[i - 15][lane], 18) ^ (w[i - 15][lane] >> 3); // First mixing term
+            uint32_t s1 = rotateRight(w[i - 2][lane], 17) ^ rotateRight(w[i - 2][lane], 19) ^ (w[i - 2][lane] >> 10); // Second mixing term
+            w[i][lane] = w[i - 16][lane] + s0 + w[i - 7][lane] + s1; // Extend the schedule
+        }
+    }
+    uint32_t v[8][HASH_LANES]; // Working variables of every lane
+    for (int j = 0; j < 8; j++) { // For loop over the working variables
+        for (int lane = 0; lane < HASH_LANES; lane++) { // For loop over the lanes
+            v[j][lane] = state[j][lane]; // Start from the state
+        }
+    }
+    for (int i = 0; i < 64; i++) { // For loop over the rounds
+        for (int lane = 0; lane < HASH_LANES; lane++) { // For loop over the lanes
+            uint32_t a = v[0][lane], b = v[1][lane], c = v[2][lane], d = v[3][lane], e = v[4][lane], f = v[5][lane], g = v[6][lane], h = v[7][lane]; // Working variables of the lane
+            uint32_t t1 = h + (rotateRight(e, 6) ^ rotateRight(e, 11) ^ rotateRight(e, 25)) + ((e & f) ^ (~e & g)) + SHA256_ROUND_CONSTANTS[i] + w[i][lane]; // First temporary
+            uint32_t t2 = (rotateRight(a, 2) ^ rotateRight(a, 13) ^ rotateRight(a, 22)) + ((a & b) ^ (a & c) ^ (b & c)); // Second temporary
+            v[7][lane] = g; v[6][lane] = f; v[5][lane] = e; v[4][lane] = d + t1; v[3][lane] = c; v[2][lane] = b; v[1][lane] = a; v[0][lane] = t1 + t2; // Rotate the working variables
+        }
+    }
+    for (int j = 0; j < 8; j++) { // For loop over the working variables
+        for (int lane = 0; lane < HASH_LANES; lane++) { // For loop over the lanes
+            state[j][lane] += v[j][lane]; // Add the chunk into the state
+        }
+    }
+}
+
+string sha256Padding(size_t messageLength, size_t tailLength) { // Function to build the SHA-256 padding for a message, given how many of its bytes are in the final unprocessed part
+    string padding(1, static_cast<char>(0x80)); // The padding starts with a single set bit
+    while ((tailLength + padding.size()) % 64 != 56) { // Pad with zeros until 8 bytes are left in the chunk
+        padding += static_cast<char>(0); // Add a zero
+    }
+    uint64_t bitLength = static_cast<uint64_t>(messageLength) * 8; // Length of the message in bits
+    for (int i = 7; i >= 0; i--) { // For loop to append the length, most significant byte first
+        padding += static_cast<char>((bitLength >> (i * 8)) & 0xFF); // Append the byte
+    }
+    return padding; // Return the padding
+}
+
+string sha256Hex(const string& message) { // Function to work out the SHA-256 hash of a message as 64 hexadecimal characters
+    uint32_t state[8]; // Declare the state
+    memcpy(state, SHA256_INITIAL_STATE, sizeof(state)); // Start from the initial state
+    string padded = message + sha256Padding(message.size(), message.size()); // Pad the message to whole chunks
+    for (size_t pos = 0; pos < padded.size(); pos += 64) { // For loop over the chunks
+        sha256Compress(state, reinterpret_cast<const unsigned char*>(padded.data() + pos)); // Mix in the chunk
+    }
+    static const char digits[] = "0123456789abcdef"; // Hexadecimal digits
+    string hex; // Declare the hexadecimal hash
+    for (int i = 0; i < 8; i++) { // For loop over the state words
+        for (int shift = 28; shift >= 0; shift -= 4) { // For loop over the digits of the word
+            hex += digits[(state[i] >> shift) & 0xF]; // Append the digit
+        }
+    }
+    return hex; // Return the hash
+}
+
+string nonceHex(uint64_t nonce) { // Function to write a nonce as 16 hexadecimal characters, so every nonce has the same length
+    static const char digits[] = "0123456789abcdef"; // Hexadecimal digits
+    string hex(16, '0'); // Declare the characters
+    for (int i = 15; i >= 0; i--) { // For loop over the digits, last first
+        hex[i] = digits[nonce & 0xF]; // Set the digit
+        nonce >>= 4; // Move to the next digit
+    }
+    return hex; // Return the characters
+}
+
+int leadingZeroBits(const string& hexHash) { // Function to count the zero bits at the start of a hexadecimal hash
+    int bits = 0; // Number of zero bits
+    for (size_t i = 0; i < hexHash.size(); ++i) { // For loop over the digits
+        int digit = isdigit(hexHash[i]) ? hexHash[i] - '0' : hexHash[i] - 'a' + 10; // Value of the digit
+        if (digit != 0) { // If the digit has a set bit
+            return bits + (digit >= 8 ? 0 : digit >= 4 ? 1 : digit >= 2 ? 2 : 3); // Add the zero bits at the start of the digit
+        }
+        bits += 4; // The whole digit is zero
+    }
+    return bits; // Every bit is zero
+}
+
+string blockHeader(const Block& block) { // Function to get the bytes a block's proof of work hash is taken over, the body at the start of its canonical encoding
+    if (!block.encoded.empty()) { // If the block is already encoded
+        return block.encoded.substr(0, blockBodyLength(block)); // Take the body from the encoding
+    }
+    string header; // Declare the header
+    encodeBlockBody(block, header); // Encode the body
+    return header; // Return the header
+}
+
+void searchNonces(const string& header, int difficulty, atomic<uint64_t>& nextChunk, atomic<bool>& found, atomic<uint64_t>& foundNonce) { // Search thread, claims chunks of nonces until one gives a hash with enough leading zero bits
+    size_t midLength = header.size() / 64 * 64; // Whole chunks before the nonce are the same for every nonce
+    uint32_t midState[8]; // State after the shared chunks
+    memcpy(midState, SHA256_INITIAL_STATE, sizeof(midState)); // Start from the initial state
+    for (size_t pos = 0; pos < midLength; pos += 64) { // For loop over the shared chunks
+        sha256Compress(midState, reinterpret_cast<const unsigned char*>(header.data() + pos)); // Mix in the chunk once
+    }
+    string tail = header.substr(midLength) + string(16, '0'); // Bytes after the shared chunks, with room for the nonce
+    tail += sha256Padding(header.size() + 16, tail.size()); // Add the padding
+    size_t nonceOffset = header.size() - midLength; // Position of the nonce in the tail
+    size_t tailChunks = tail.size() / 64; // Chunks hashed for every nonce
+
+    vector<string> laneTails(HASH_LANES, tail); // Tail of every lane
+    uint32_t state[8][HASH_LANES]; // State of every lane
+    uint32_t words[16][HASH_LANES]; // Chunk words of every lane
+    while (!found.load(memory_order_relaxed)) { // Keep searching until any thread finds a nonce
+        uint64_t first = nextChunk.fetch_add(NONCE_CHUNK); // Claim the next chunk of nonces, faster threads simply claim more chunks
+        for (uint64_t base = first; base < first + NONCE_CHUNK && !found.load(memory_order_relaxed); base += HASH_LANES) { // For loop over the chunk, a lane batch at a time, stopping as soon as a nonce is found
+            for (int lane = 0; lane < HASH_LANES; lane++) { // For loop to set up the lanes
+                string hex = nonceHex(base + lane); // Nonce of the lane
+                memcpy(&laneTails[lane][nonceOffset], hex.data(), 16); // Write it into the lane's tail
+                for (int j = 0; j < 8; j++) { // For loop over the state words
+                    state[j][lane] = midState[j]; // Start from the shared state
+                }
+            }
+            for (size_t chunk = 0; chunk < tailChunks; ++chunk) { // For loop over the tail chunks
+                for (int i = 0; i < 16; i++) { // For loop over the words of the chunk
+                    for (int lane = 0; lane < HASH_LANES; lane++) { // For loop over the lanes
+                        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(laneTails[lane].data() + chunk * 64 + i * 4); // Bytes of the word
+                        words[i][lane] = (static_cast<uint32_t>(bytes[0]) << 24) | (static_cast<uint32_t>(bytes[1]) << 16) | (static_cast<uint32_t>(bytes[2]) << 8) | bytes[3]; // Read the word
+                    }
+                }
+                sha256CompressLanes(state, words); // Mix the chunk into every lane
+            }
+            for (int lane = 0; lane < HASH_LANES; lane++) { // For loop to check the lanes
+                int zeros = 0; // Leading zero bits of the lane's hash
+                for (int j = 0; j < 8 && zeros == j * 32; j++) { // For loop over the hash words while they are all zero
+                    zeros += state[j][lane] == 0 ? 32 : __builtin_clz(state[j][lane]); // Count the zero bits of the word
+                }
+                if (zeros >= difficulty && !found.exchange(true)) { // If the hash is good enough and no other thread got there first
+                    foundNonce = base + lane; // Record the nonce
+                }
+            }
+        }
+    }
+}
+
+class NonceSearchPool { // Search threads started once and kept for the whole run, one per core, so sealing a block does not start and join a thread per core every time
+private: // Private members
+    vector<thread> workers; // The search threads, started by the first search
+    mutex searchMutex; // Lets one search run at a time, a search already uses every core
+    mutex jobMutex; // Protects the members below
+    condition_variable jobReady; // Wakes the workers when a search starts or the pool stops
+    condition_variable jobDone; // Wakes the caller when every worker has finished the search
+    uint64_t generation; // Number of the current search, a worker waits for it to change
+    size_t running; // Workers still searching
+    bool stopping; // Flag to tell the workers to finish
+    const string* header; // Header of the current search
+    int difficulty; // Difficulty of the current search
+    atomic<uint64_t> nextChunk; // Next chunk of nonces to claim
+    atomic<bool> found; // Flag set as soon as any worker finds a nonce
+    atomic<uint64_t> foundNonce; // The nonce found
+
+    void work() { // Worker thread, runs every search until the pool stops
+        uint64_t seen = 0; // Last search this worker ran
+        unique_lock<mutex> lock(jobMutex); // Lock the job
+        while (true) { // Loop over the searches
+            jobReady.wait(lock, [this, seen] { return stopping || generation != seen; }); // Wait for a new search
+            if (stopping) { // If the pool is stopping
+                return;
+            }
+            seen = generation; // The worker runs this search
+            lock.unlock(); // Search without holding the lock
+            searchNonces(*header, difficulty, nextChunk, found, foundNonce); // Search until any worker finds a nonce
+            lock.lock(); // Lock the job again
+            if (--running == 0) { // If this was the last worker searching
+                jobDone.notify_all(); // Wake the caller
+            }
+        }
+    }
+
+public: // Public members
+    NonceSearchPool() : generation(0), running(0), stopping(false), header(nullptr), difficulty(0), nextChunk(0), found(false), foundNonce(0) { // Constructor for NonceSearchPool, the threads start with the first search
+    }
+
+    ~NonceSearchPool() { // Destructor for NonceSearchPool, stops the workers
+        {
+            lock_guard<mutex> lock(jobMutex); // Lock the job
+            stopping = true; // Ask the workers to finish
+        }
+        jobReady.notify_all(); // Wake them
+        for (size_t i = 0; i < workers.size(); ++i) { // For loop over the workers
+            workers[i].join(); // Wait for the worker
+        }
+    }
+
+    uint64_t search(const string& headerToSeal, int bits) { // Find a nonce whose hash with the header has at least the bits passed in as leading zero bits, using every worker
+        lock_guard<mutex> searchLock(searchMutex); // One search at a time, shards sealing blocks together take turns
+        unique_lock<mutex> lock(jobMutex); // Lock the job
+        if (workers.empty()) { // If this is the first search
+            int threadCount = max(1u, thread::hardware_concurrency()); // One search thread per core
+            for (int i = 0; i < threadCount; i++) { // For loop to start the workers
+                workers.push_back(thread(&NonceSearchPool::work, this)); // Start the worker
+            }
+        }
+        header = &headerToSeal; // Set the header
+        difficulty = bits; // Set the difficulty
+        nextChunk.store(0); // Start from the first nonce
+        found.store(false); // Nothing found yet
+        foundNonce.store(0); // No nonce yet
+        running = workers.size(); // Every worker takes part
+        generation++; // Start the search
+        jobReady.notify_all(); // Wake the workers
+        jobDone.wait(lock, [this] { return running == 0; }); // Wait for every worker to stop searching, so none still reads the header
+        return foundNonce.load(); // Return the nonce found
+    }
+};
+
+NonceSearchPool nonceSearchPool; // Search threads shared by every chain of the process
+
+uint64_t findNonce(const string& header, int difficulty) { // Function to find a nonce whose hash with the header has at least the difficulty in leading zero bits, the search is split across every core
+    return nonceSearchPool.search(header, difficulty); // Search on the pool
+}
+
+bool hasValidProofOfWork(const Block& block) { // Function to check that a sealed block's hash is the hash of its header and nonce and meets its difficulty
+    string hash = sha256Hex(blockHeader(block) + nonceHex(block.nonce)); // Work out the hash again
+    return hash == block.currentHashNumber && leadingZeroBits(hash) >= block.difficulty; // Check the hash and the difficulty
+}
+
+bool blockLinksAfter(const Block& block, int blockNumber, const string& previousHash, uint64_t previousTimeStamp, int requiredDifficulty) { // Function to check that a block can be linked as the block number passed in, after a block with the hash and time stamp passed in, in a chain whose first block set the difficulty passed in, the first block links to itself and sets the difficulty instead
+    if (block.blockNumber != blockNumber) { // If the block is not the next one
+        return false;
+    }
+    if (blockNumber == 0) { // The first block links to itself
+        return block.previousHashNumber == block.currentHashNumber;
+    }
+    return block.previousHashNumber == previousHash && block.currentTimeStamp > previousTimeStamp && block.difficulty >= requiredDifficulty && (block.difficulty == 0 || hasValidProofOfWork(block)); // The block must link to the one before it, be stamped after it, claim at least the work the chain requires and carry a valid proof of work
+}
+
+string toLowerCase(string text) { // Function to convert text to lowercase, used to compare query fields and values without caring about case
+    transform(text.begin(), text.end(), text.begin(), ::tolower); // Convert every character
+    return text; // Return the lowercase text
+}
+
+string trimSpaces(const string& text) { // Function to remove the spaces around text
+    size_t first = text.find_first_not_of(" \t"); // First character that is not a space
+    if (first == string::npos) { // If the text is only spaces
+        return "";
+    }
+    return text.substr(first, text.find_last_not_of(" \t") - first + 1); // Return the text between the spaces
+}
+
+int compareQueryValues(const string& left, const string& right) { // Function to compare two values of a query, dates (dd/mm/yy) are compared by date, numbers by value and anything else as lowercase text, returns below, equal to or above zero
+    if (left.size() == 8 && right.size() == 8 && left[2] == '/' && left[5] == '/' && right[2] == '/' && right[5] == '/') { // If both values are dates
+        string leftDate = left.substr(6, 2) + left.substr(3, 2) + left.substr(0, 2); // Rewrite the date as yymmdd so it sorts as text
+        string rightDate = right.substr(6, 2) + right.substr(3, 2) + right.substr(0, 2); // Rewrite the other date the same way
+        return leftDate.compare(rightDate); // Compare the dates
+    }
+    char* leftEnd; // End of the number read from the left value
+    char* rightEnd; // End of the number read from the right value
+    double leftNumber = strtod(left.c_str(), &leftEnd); // Read the left value as a number
+    double rightNumber = strtod(right.c_str(), &rightEnd); // Read the right value as a number
+    if (!left.empty() && !right.empty() && *leftEnd == '\0' && *rightEnd == '\0') { // If both values are whole numbers
+        return leftNumber < rightNumber ? -1 : leftNumber > rightNumber ? 1 : 0; // Compare the numbers
+    }
+    return toLowerCase(left).compare(toLowerCase(right)); // Compare the values as text
+}
+
+struct QueryPredicate { // One condition of a query, such as mode=Air
+    string field; // Lowercase field name, matched against the information keys
+    string op; // Comparison, one of = != < <= > >=
+    string value; // Value compared against
+    int stage; // Stage index when the field is "stage", -1 otherwise
+    bool exact; // Flag to compare the value exactly, used for IDs so the segment filters stay correct
+    bool indexed; // Flag to indicate that the field names one of the keys the segment filters hold, it then only matches that key so a filter that rules the value out is never wrong
+
+    bool accepts(int comparison) const { // Method to check if the result of a comparison satisfies the condition
+        if (op == "=") return comparison == 0;
+        if (op == "!=") return comparison != 0;
+        if (op == "<") return comparison < 0;
+        if (op == "<=") return comparison <= 0;
+        if (op == ">") return comparison > 0;
+        return comparison >= 0; // The only comparison left is >=
+    }
+
+    bool matchesKey(const string& key) const { // Method to check if an information key is named by the field, either the whole key or one of its words, so "mode" names "Transportation Mode"
+        string lowerKey = toLowerCase(key); // Lowercase key
+        if (indexed) { // A field the segment filters answer for names its key alone, so "supplier id" does not also name a key such as "Backup Supplier ID" the filters do not hold
+            return lowerKey == field && isIdField(key);
+        }
+        return lowerKey == field || (" " + lowerKey + " ").find(" " + field + " ") != string::npos; // Check the whole key, then its words
+    }
+
+    bool matchesInformation(const Block& block) const { // Method to check if any information of the block named by the field satisfies the condition
+        for (size_t i = 0; i < block.information.size(); ++i) { // For loop over the information
+            if (matchesKey(block.information[i].first)) { // If the key is named by the field
+                int comparison = exact ? block.information[i].second.compare(value) : compareQueryValues(block.information[i].second, value); // Compare the value
+                if (accepts(comparison)) { // If the condition holds
+                    return true;
+                }
+            }
+        }
+        return false; // No information satisfies the condition
+    }
+};
+
+struct ChainQuery { // Parsed query and the plan chosen to run it
+    vector<QueryPredicate> blockPredicates; // Conditions on the block number and the stage, checked before any other information of a block is read
+    vector<QueryPredicate> informationPredicates; // Conditions on the information of a block
+    int lowestBlock; // Lowest block number that can match, the scan stops below it
+    int highestBlock; // Highest block number that can match, the scan seeks past the blocks above it
+    vector<string> indexedIds; // IDs that must be present, segments whose filter rules any of them out are skipped
+    size_t limit; // Largest number of blocks returned, 0 when there is no limit
+    string plan; // Description of the plan, shown to the user
+};
+
+bool parseQueryNumber(const string& text, long long& number) { // Function to read a whole number of a query, returns false if the text is not a number or does not fit
+    if (text.empty()) { // If there is nothing to read
+        return false;
+    }
+    char* end; // End of the number read
+    errno = 0; // Clear the error left by an earlier call
+    number = strtoll(text.c_str(), &end, 10); // Read the number
+    return *end == '\0' && errno != ERANGE; // The whole text must be the number, and the number must fit
+}
+
+int clampToInt(long long number) { // Function to clamp a number to the range of an int, so a bound adjusted by one cannot overflow
+    return static_cast<int>(max<long long>(numeric_limits<int>::min(), min<long long>(numeric_limits<int>::max(), number)));
+}
+
+bool parseQuery(const string& text, ChainQuery& query, string& error) { // Function to parse a query such as "stage=transportation AND mode=Air AND arrival>=01/04/24 LIMIT 100" and plan it, returns false with an error message if the query is not valid
+    vector<pair<string, bool> > words; // Words of the query, and whether each was quoted
+    for (size_t pos = 0; pos < text.size(); ) { // For loop to split the query into words
+        if (isspace(static_cast<unsigned char>(text[pos]))) { // Skip spaces between words
+            pos++;
+            continue;
+        }
+        string word; // Declare the word
+        bool quoted = false; // Flag to indicate that part of the word was quoted
+        while (pos < text.size() && !isspace(static_cast<unsigned char>(text[pos]))) { // Read until the next space
+            if (text[pos] == '"') { // A quoted part may hold spaces
+                size_t close = text.find('"', pos + 1); // Find the closing quote
+                if (close == string::npos) { // If the quote is not closed
+                    error = "Missing closing quote.";
+                    return false;
+                }
+                word += text.substr(pos + 1, close - pos - 1); // Add the quoted part without its quotes
+                pos = close + 1; // Move past the closing quote
+                quoted = true; // The word was quoted
+            } else { // Ordinary character
+                word += text[pos++]; // Add the character
+            }
+        }
+        words.push_back(make_pair(word, quoted)); // Add the word
+    }
+
+    query = ChainQuery(); // Start from an empty query
+    query.lowestBlock = 0; // Every block number can match until a condition says otherwise
+    query.highestBlock = numeric_limits<int>::max();
+    query.limit = 0; // No limit until one is given
+    vector<string> conditions(1); // Text of each condition, the words between the ANDs
+    for (size_t i = 0; i < words.size(); ++i) { // For loop over the words
+        string keyword = words[i].second ? "" : toLowerCase(words[i].first); // Quoted words are never keywords
+        if (keyword == "and") { // Start the next condition
+            conditions.push_back("");
+        } else if (keyword == "limit") { // The limit ends the query
+            long long limit; // Largest number of blocks returned
+            if (i + 2 != words.size() || !parseQueryNumber(words[i + 1].first, limit) || limit <= 0) { // If the limit is not a positive number at the end
+                error = "LIMIT must be followed by a positive number at the end of the query.";
+                return false;
+            }
+            query.limit = static_cast<size_t>(limit); // Set the limit
+            break;
+        } else { // Part of the current condition
+            conditions.back() += (conditions.back().empty() ? "" : " ") + words[i].first; // Add the word
+        }
+    }
+
+    const char* const ops[] = { ">=", "<=", "!=", "=", ">", "<" }; // Comparisons, the two character ones are tried first
+    for (size_t i = 0; i < conditions.size(); ++i) { // For loop to parse the conditions
+        size_t opPos = string::npos; // Position of the comparison
+        string op; // The comparison
+        for (int j = 0; j < 6; j++) { // For loop to find the earliest comparison
+            size_t found = conditions[i].find(ops[j]); // Find the comparison
+            if (found != string::npos && (opPos == string::npos || found < opPos)) { // If it comes before the one found so far
+                opPos = found;
+                op = ops[j];
+            }
+        }
+        if (opPos == string::npos) { // If the condition has no comparison
+            error = "Condition \"" + conditions[i] + "\" needs a comparison (= != < <= > >=).";
+            return false;
+        }
+        QueryPredicate predicate; // Declare the condition
+        predicate.field = toLowerCase(trimSpaces(conditions[i].substr(0, opPos))); // Field before the comparison
+        predicate.op = op; // The comparison
+        predicate.value = trimSpaces(conditions[i].substr(opPos + op.size())); // Value after the comparison
+        predicate.stage = -1; // Not a stage condition yet
+        predicate.indexed = predicate.field == "supplier id" || predicate.field == "warehouse id" || predicate.field == "customer id"; // Only these keys are in the segment filters, "id" also names keys such as "Shipment ID" that are not
+        predicate.exact = predicate.indexed || predicate.field == "id"; // IDs are compared exactly
+        if (predicate.field.empty() || predicate.value.empty()) { // If the field or the value is missing
+            error = "Condition \"" + conditions[i] + "\" needs a field and a value.";
+            return false;
+        }
+
+        if (predicate.field == "block") { // Condition on the block number
+            long long number; // Block number compared against
+            if (!parseQueryNumber(predicate.value, number)) { // If the value is not a whole number
+                error = "Block \"" + predicate.value + "\" is not a whole number.";
+                return false;
+            }
+            number = max<long long>(numeric_limits<int>::min() - 1LL, min<long long>(numeric_limits<int>::max() + 1LL, number)); // Keep the number just outside the range of an int, so adding or subtracting one cannot overflow
+            if (op == "=" || op == ">=") query.lowestBlock = max(query.lowestBlock, clampToInt(number)); // Narrow the range from below
+            if (op == ">") query.lowestBlock = max(query.lowestBlock, clampToInt(number + 1));
+            if (op == "=" || op == "<=") query.highestBlock = min(query.highestBlock, clampToInt(number)); // Narrow the range from above
+            if (op == "<") query.highestBlock = min(query.highestBlock, clampToInt(number - 1));
+            query.blockPredicates.push_back(predicate); // The number is also checked on every block, for !=
+        } else if (predicate.field == "stage") { // Condition on the stage
+            for (int stage = 0; stage < STAGE_COUNT && predicate.stage == -1; stage++) { // For loop to find the stage named by the value
+                if (toLowerCase(STAGE_NAMES[stage]).find(toLowerCase(predicate.value)) == 0) { // If the stage name starts with the value
+                    predicate.stage = stage; // Remember the stage
+                }
+            }
+            if (predicate.stage == -1 || (op != "=" && op != "!=")) { // If the stage is unknown or compared by order
+                error = "Stage \"" + predicate.value + "\" is not a stage that can be compared with " + op + ".";
+                return false;
+            }
+            query.blockPredicates.push_back(predicate); // The stage is checked before the rest of the information
+        } else { // Condition on the information
+            if (predicate.indexed && op == "=") { // An ID that must be present under a key the filters hold can use the segment filters
+                query.indexedIds.push_back(predicate.value);
+            }
+            query.informationPredicates.push_back(predicate);
+        }
+    }
+
+    stringstream plan; // Declare the description of the plan
+    if (query.lowestBlock > 0 || query.highestBlock < numeric_limits<int>::max()) { // If the block number is bounded
+        plan << "seek blocks " << query.lowestBlock << " to " << (query.highestBlock == numeric_limits<int>::max() ? string("latest") : to_string(query.highestBlock)); // Seek to the range instead of scanning the chain
+    } else { // If every block number can match
+        plan << "scan every block";
+    }
+    if (!query.indexedIds.empty()) { // If IDs can rule segments out
+        plan << ", skipping segments whose ID filter rules out " << query.indexedIds[0]; // Look the ID up in the segment filters
+    }
+    plan << ", " << query.blockPredicates.size() << " block condition(s) checked before " << query.informationPredicates.size() << " information condition(s)"; // Cheap conditions first
+    if (query.limit > 0) { // If the results are limited
+        plan << ", stopping after " << query.limit << " block(s)";
+    }
+    query.plan = plan.str(); // Save the description
+    return true;
+}
+
+int stageNamed(const string& text) { // Function to find the stage whose name starts with the text, ignoring case, returns -1 if no stage does
+    string prefix = toLowerCase(trimSpaces(text)); // Lowercase text without surrounding spaces
+    for (int stage = 0; stage < STAGE_COUNT && !prefix.empty(); stage++) { // For loop over the stage names
+        if (toLowerCase(STAGE_NAMES[stage]).find(prefix) == 0) { // If the stage name starts with the text
+            return stage;
+        }
+    }
+    return -1; // No stage has the name
+}
+
+const char* const DEFAULT_CONSISTENCY_RULES[] = { "transportation.arrival >= transportation.departure", "product returns AFTER customer delivery", "inventory.quantity >= order fulfillment.quantity" }; // Rules checked when consistency_rules.txt does not exist
+
+struct ConsistencyRule { // One rule that every shipment must keep, compiled from text such as "inventory.quantity >= order fulfillment.quantity" or "product returns AFTER customer delivery"
+    string text; // Rule as written, shown when it is broken
+    bool ordering; // Flag to indicate that the rule orders two stages instead of comparing two values
+    int leftStage; // Stage of the left side, for an ordering rule the stage that must come later
+    string leftField; // Lowercase field of the left side, named like a query field
+    int acceptMask; // Comparison results that keep the rule, bit 0 for below, bit 1 for equal and bit 2 for above
+    int rightStage; // Stage of the right side, -1 when the right side is a value, for an ordering rule the stage that must come first
+    string rightField; // Lowercase field of the right side
+    string rightValue; // Value of the right side when it names no stage
+
+    static const string* fieldValue(const Block* block, const string& field) { // Function to find the value of a field in a block, returns nullptr if the block does not hold it
+        if (block == nullptr || block->isSoftDeleted) { // If the stage has not happened or its information was deleted
+            return nullptr;
+        }
+        QueryPredicate finder; // Field names match information keys the same way as in queries
+        finder.field = field;
+        for (size_t i = 0; i < block->information.size(); ++i) { // For loop over the information
+            if (finder.matchesKey(block->information[i].first)) { // If the key is named by the field
+                return &block->information[i].second;
+            }
+        }
+        return nullptr; // The block does not hold the field
+    }
+
+    bool holds(const ShipmentLifecycle& lifecycle) const { // Method to check the rule against the latest blocks of a shipment, a rule whose stages have not all happened yet still holds
+        const BlockNode* left = lifecycle.stages[leftStage]; // Latest block of the left stage
+        if (ordering) { // If the rule orders two stages
+            const BlockNode* right = lifecycle.stages[rightStage]; // Latest block of the stage that must come first
+            return left == nullptr || (right != nullptr && right->data.currentTimeStamp < left->data.currentTimeStamp); // The later stage needs the earlier one before it, the time stamps are in the headers kept in memory
+        }
+        shared_ptr<const Block> leftBlock = left != nullptr ? blockOf(left) : shared_ptr<const Block>(); // Whole block of the left stage, read back if it was evicted
+        shared_ptr<const Block> rightBlock = rightStage != -1 && lifecycle.stages[rightStage] != nullptr ? blockOf(lifecycle.stages[rightStage]) : shared_ptr<const Block>(); // Whole block of the right stage
+        const string* leftValue = fieldValue(leftBlock.get(), leftField); // Value of the left side
+        const string* rightSide = rightStage == -1 ? &rightValue : fieldValue(rightBlock.get(), rightField); // Value of the right side
+        if (leftValue == nullptr || rightSide == nullptr) { // If a side is missing
+            return true; // The rule cannot be checked yet
+        }
+        int comparison = compareQueryValues(*leftValue, *rightSide); // Compare the values like a query does
+        return (acceptMask & (comparison < 0 ? 1 : comparison == 0 ? 2 : 4)) != 0; // Check the result
+    }
+};
+
+class ConsistencyRules { // Compiled set of consistency rules, with the rules indexed by the stages they read so a new block only checks the rules it can affect
+private: // Private members
+    vector<ConsistencyRule> rules; // The rules
+    vector<int> rulesByStage[STAGE_COUNT]; // Rules that read each stage
+
+    static bool parseOperand(const string& text, int& stage, string& field) { // Function to split "stage.field" into its stage and lowercase field, returns false if the text names no stage
+        size_t dot = text.find('.'); // End of the stage name
+        if (dot == string::npos) { // If there is no field
+            return false;
+        }
+        stage = stageNamed(text.substr(0, dot)); // Find the stage
+        field = toLowerCase(trimSpaces(text.substr(dot + 1))); // Field after the dot
+        return stage != -1 && !field.empty();
+    }
+
+public: // Public members
+    bool addRule(const string& text, string& error) { // Method to compile a rule and add it, returns false with an error message if the rule is not valid
+        ConsistencyRule rule; // Declare the rule
+        rule.text = trimSpaces(text); // Keep the text
+        rule.rightStage = -1; // No right stage yet
+        rule.acceptMask = 0; // No comparison yet
+        string lower = toLowerCase(rule.text); // Lowercase text to find the keywords
+        size_t after = lower.find(" after "); // Ordering keyword, the left stage comes after the right stage
+        size_t before = lower.find(" before "); // Ordering keyword, the left stage comes before the right stage
+        if (after != string::npos || before != string::npos) { // If the rule orders two stages
+            bool isAfter = after != string::npos; // Which keyword was used
+            size_t keyword = isAfter ? after : before; // Position of the keyword
+            int first = stageNamed(rule.text.substr(0, keyword)); // Stage before the keyword
+            int second = stageNamed(rule.text.substr(keyword + (isAfter ? 7 : 8))); // Stage after the keyword
+            if (first == -1 || second == -1) { // If a stage is unknown
+                error = "Rule \"" + rule.text + "\" must name a stage on both sides of " + (isAfter ? "AFTER" : "BEFORE") + ".";
+                return false;
+            }
+            rule.ordering = true;
+            rule.leftStage = isAfter ? first : second; // The stage that must come later
+            rule.rightStage = isAfter ? second : first; // The stage that must come first
+        } else { // If the rule compares two values
+            const char* const ops[] = { ">=", "<=", "!=", "=", ">", "<" }; // Comparisons, the two character ones are tried first
+            const int masks[] = { 6, 3, 5, 2, 4, 1 }; // Comparison results each comparison accepts
+            size_t opPos = string::npos; // Position of the comparison
+            int op = -1; // Index of the comparison
+            for (int j = 0; j < 6; j++) { // For loop to find the earliest comparison
+                size_t found = rule.text.find(ops[j]); // Find the comparison
+                if (found != string::npos && (opPos == string::npos || found < opPos)) { // If it comes before the one found so far
+                    opPos = found;
+                    op = j;
+                }
+            }
+            if (op == -1 || !parseOperand(rule.text.substr(0, opPos), rule.leftStage, rule.leftField)) { // If there is no comparison or the left side names no stage
+                error = "Rule \"" + rule.text + "\" must compare a stage.field with a comparison (= != < <= > >=), or order two stages with AFTER or BEFORE.";
+                return false;
+            }
+            rule.ordering = false;
+            rule.acceptMask = masks[op]; // Compile the comparison
+            string right = trimSpaces(rule.text.substr(opPos + strlen(ops[op]))); // Right side
+            if (!parseOperand(right, rule.rightStage, rule.rightField)) { // If the right side names no stage it is a value
+                rule.rightStage = -1;
+                rule.rightValue = right;
+            }
+            if (right.empty()) { // If the right side is missing
+                error = "Rule \"" + rule.text + "\" needs a right side.";
+                return false;
+            }
+        }
+        int index = static_cast<int>(rules.size()); // Index of the new rule
+        rules.push_back(rule); // Add the rule
+        rulesByStage[rule.leftStage].push_back(index); // A block of the left stage can change the result
+        if (rule.rightStage != -1 && rule.rightStage != rule.leftStage) { // So can a block of the right stage
+            rulesByStage[rule.rightStage].push_back(index);
+        }
+        return true;
+    }
+
+    bool loadFromFile(const string& filename, string& error) { // Method to compile the rules listed one per line in a file, blank lines and lines starting with # are skipped, the built in rules are used if the file does not exist
+        ifstream file(filename); // Open the file
+        if (!file.is_open()) { // If there is no rules file
+            for (size_t i = 0; i < sizeof(DEFAULT_CONSISTENCY_RULES) / sizeof(DEFAULT_CONSISTENCY_RULES[0]); ++i) { // For loop over the built in rules
+                addRule(DEFAULT_CONSISTENCY_RULES[i], error); // Add the rule
+            }
+            return true;
+        }
+        string line; // Declare the line
+        while (getline(file, line)) { // While loop to read the file line by line
+            line = trimSpaces(line); // Ignore surrounding spaces
+            if (!line.empty() && line[0] != '#' && !addRule(line, error)) { // If the line holds a rule that is not valid
+                return false;
+            }
+        }
+        return true;
+    }
+
+    size_t size() const { // Method to get the number of rules
+        return rules.size();
+    }
+
+    const ConsistencyRule& rule(int index) const { // Method to get a rule
+        return rules[index];
+    }
+
+    const vector<int>& rulesReading(int stage) const { // Method to get the rules that read a stage
+        return rulesByStage[stage];
+    }
+
+    vector<int> brokenRules(const ShipmentLifecycle& lifecycle) const { // Method to check every rule against a shipment, returns the rules it breaks
+        vector<int> broken; // Declare the broken rules
+        for (size_t i = 0; i < rules.size(); ++i) { // For loop over the rules
+            if (!rules[i].holds(lifecycle)) { // If the shipment breaks the rule
+                broken.push_back(static_cast<int>(i));
+            }
+        }
+        return broken; // Return the broken rules
+    }
+
+    bool sameRules(const ConsistencyRules& other) const { // Method to check if two rule sets hold the same rules, so reloading an unchanged file skips the re-evaluation
+        if (rules.size() != other.rules.size()) { // If the number of rules differs
+            return false;
+        }
+        for (size_t i = 0; i < rules.size(); ++i) { // For loop over the rules
+            if (rules[i].text != other.rules[i].text) { // If a rule differs
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+#ifdef IOV_MAX
+const int WRITE_VECTOR_LIMIT = IOV_MAX; // Most records gathered into one pwritev
+#else
+const int WRITE_VECTOR_LIMIT = 16; // Most records gathered into one pwritev, the least POSIX allows
+#endif
+
+class PersistenceWriter { // Writes records to the end of a file on a background thread, so the thread adding blocks never waits for the disk
+private: // Private members
+    int fd; // File the records are written to
+    off_t writeOffset; // Position where the next record is written
+    bool failed; // Flag to indicate that a write or sync has failed, no record is accepted after the first failure as the records after a lost one could not be replayed
+    bool stopping; // Flag to tell the background thread to finish
+    uint64_t submittedCount; // Number of records handed to the writer
+    uint64_t durableCount; // Number of records written and synced to disk, only ever counts records that reached the disk
+    uint64_t submittedEnd; // Position in the file just after the last submitted record, moved back to the last record on disk if a write fails
+    deque<string> pending; // Records waiting to be written
+    mutex queueMutex; // Protects the members above
+    condition_variable workReady; // Wakes the background thread when records are queued
+    condition_variable durableReady; // Wakes threads waiting for records to reach the disk
+    thread worker; // Background thread writing the records
+
+    void writeLoop() { // Background thread, writes every queued record with one gathered pwritev and one fsync per batch
+        unique_lock<mutex> lock(queueMutex); // Lock the queue
+        while (true) { // Loop until the writer is stopped
+            workReady.wait(lock, [this] { return stopping || !pending.empty(); }); // Wait for records or a stop request
+            if (pending.empty()) { // If the writer is stopping and nothing is left
+                return;
+            }
+
+            vector<string> batch(make_move_iterator(pending.begin()), make_move_iterator(pending.end())); // Take the queued records without copying their bytes
+            size_t batchCount = batch.size(); // Number of records in the batch
+            pending.clear(); // The records are now owned by the batch
+            lock.unlock(); // Let new records queue up while the disk is busy
+
+            vector<iovec> pieces(batchCount); // Where each record's bytes are, the kernel gathers them into one write
+            size_t batchBytes = 0; // Total bytes of the batch
+            for (size_t i = 0; i < batchCount; ++i) { // For loop over the records
+                pieces[i].iov_base = const_cast<char*>(batch[i].data()); // Start of the record
+                pieces[i].iov_len = batch[i].size(); // Length of the record
+                batchBytes += batch[i].size(); // Count its bytes
+            }
+            bool ok = true; // Flag to indicate that the batch reached the disk
+            size_t written = 0; // Bytes written so far
+            size_t firstPiece = 0; // First record not completely written
+            while (ok && written < batchBytes) { // While loop until the whole batch is written
+                int pieceCount = static_cast<int>(min(pieces.size() - firstPiece, static_cast<size_t>(WRITE_VECTOR_LIMIT))); // Records passed to this write
+                ssize_t result = pwritev(fd, &pieces[firstPiece], pieceCount, writeOffset + static_cast<off_t>(written)); // Write the rest of the batch
+                if (result < 0 && errno != EINTR) { // If the write failed
+                    ok = false; // The batch did not reach the disk
+                } else if (result > 0) { // If bytes were written
+                    written += static_cast<size_t>(result); // Count the written bytes
+                    size_t left = static_cast<size_t>(result); // Bytes to skip in the pieces
+                    while (left > 0 && left >= pieces[firstPiece].iov_len) { // Skip the records written completely
+                        left -= pieces[firstPiece].iov_len;
+                        firstPiece++;
+                    }
+                    if (left > 0) { // Skip the written start of a record written in part
+                        pieces[firstPiece].iov_base = static_cast<char*>(pieces[firstPiece].iov_base) + left;
+                        pieces[firstPiece].iov_len -= left;
+                    }
+                }
+            }
+            ok = ok && fsync(fd) == 0; // Make the batch durable with a single sync
+
+            lock.lock(); // Lock the queue again
+            if (ok) { // If the batch is on disk
+                writeOffset += static_cast<off_t>(batchBytes); // Move the write position past the batch
+                durableCount += batchCount; // The batch is durable
+            } else { // If the batch did not reach the disk
+                failed = true; // Refuse every record from now on
+                pending.clear(); // Records queued behind the batch are lost with it
+                submittedEnd = static_cast<uint64_t>(writeOffset); // Nothing after the last good record is in the log, so a checkpoint never claims to cover the lost records
+                cout << "Error: Unable to persist blocks to disk, no further changes are accepted." << endl; // Tell the user that persisting failed
+            }
+            durableReady.notify_all(); // Wake the threads waiting for the batch, they find out from durableCount whether it was written
+        }
+    }
+
+public: // Public members
+    PersistenceWriter(const string& filename) { // Constructor for PersistenceWriter, opens the file for appending and starts the background thread
+        fd = open(filename.c_str(), O_WRONLY | O_CREAT, 0644); // Open the file, creating it if needed
+        writeOffset = fd == -1 ? 0 : lseek(fd, 0, SEEK_END); // New records go after what is already in the file
+        failed = fd == -1; // The writer has failed if the file could not be opened
+        stopping = false; // The writer is running
+        submittedCount = 0; // No records submitted yet
+        durableCount = 0; // No records written yet
+        submittedEnd = static_cast<uint64_t>(writeOffset); // Nothing submitted past the end of the file yet
+        if (fd == -1) { // If the file could not be opened
+            cout << "Error: Unable to open " << filename << " for writing." << endl; // Tell the user that the file could not be opened
+            return;
+        }
+        worker = thread(&PersistenceWriter::writeLoop, this); // Start the background thread
+    }
+
+    ~PersistenceWriter() { // Destructor for PersistenceWriter, writes everything still queued before closing the file
+        {
+            lock_guard<mutex> lock(queueMutex); // Lock the queue
+            stopping = true; // Ask the background thread to finish
+        }
+        workReady.notify_one(); // Wake the background thread
+        if (worker.joinable()) { // If the background thread was started
+            worker.join(); // Wait for it to finish
+        }
+        if (fd != -1) { // If the file is open
+            close(fd); // Close the file
+        }
+    }
+
+    bool isOpen() { // Method to check that the file is open and no write has failed
+        lock_guard<mutex> lock(queueMutex); // Lock the queue
+        return !failed; // Return true if the writer is healthy
+    }
+
+    uint64_t submit(string record) { // Queue a record to be written, returns a ticket that can be passed to waitDurable
+        lock_guard<mutex> lock(queueMutex); // Lock the queue
+        if (failed) { // If the file is not open or a write has failed
+            return ++submittedCount; // Nothing will be written, waitDurable reports the ticket as lost
+        }
+        submittedEnd += record.size(); // The record will end up just after the ones before it
+        pending.push_back(move(record)); // Queue the record without copying it
+        workReady.notify_one(); // Wake the background thread
+        return ++submittedCount; // Return the ticket of the record
+    }
+
+    bool waitDurable(uint64_t ticket) { // Block until the record with the ticket passed in, and every record before it, has been written and synced, returns false if the record was lost because a write failed
+        unique_lock<mutex> lock(queueMutex); // Lock the queue
+        durableReady.wait(lock, [this, ticket] { return durableCount >= ticket || failed; }); // Wait for the background thread
+        return durableCount >= ticket; // The record is durable only if it was counted
+    }
+
+    uint64_t endOffset() { // Method to get the position in the file just after the last submitted record
+        lock_guard<mutex> lock(queueMutex); // Lock the queue
+        return submittedEnd; // Return the position
+    }
+
+    bool flush() { // Block until every submitted record has been written and synced, returns false if any was lost
+        uint64_t ticket; // Ticket of the last submitted record
+        {
+            lock_guard<mutex> lock(queueMutex); // Lock the queue
+            ticket = submittedCount; // Get the last ticket
+        }
+        return waitDurable(ticket); // Wait for it
+    }
+};
+
+// Change feed, consumers subscribe from a block number and receive every block appended from then on.
+const int64_t FEED_CAPACITY = 4096; // Blocks held by the in-process ring, older blocks are walked from the chain
+const int FEED_MAX_SUBSCRIBERS = 16; // Largest number of subscribers of one feed
+const int FEED_BACKPRESSURE_MS = 100; // Longest the producer waits for a subscriber about to lose its place in the ring
+const int FEED_SPIN_CHECKS = 2000; // Times a subscriber checks for a new block before going to sleep, so a busy feed is read without a system call
+const int64_t SHARED_FEED_SLOTS = 1024; // Blocks held by the shared memory ring
+const size_t SHARED_FEED_SLOT_BYTES = 4096; // Largest encoded block a shared memory slot holds
+const int FEED_BLOCK = 0; // A block was read
+const int FEED_NONE = 1; // No new block arrived in time
+const int FEED_BEHIND = 2; // The subscriber asked for blocks no longer in the shared ring and was moved to its oldest block
+const int FEED_TOO_LARGE = 3; // The block is too large for a shared memory slot, fetch it from the server
+
+class WakeupSignal { // Wakes a sleeping thread, an eventfd on Linux and a pipe elsewhere
+private: // Private members
+    int readFd; // Descriptor waited on
+    int writeFd; // Descriptor written to wake the waiter
+
+public: // Public members
+    WakeupSignal() { // Constructor for WakeupSignal, creates the descriptors
+#ifdef __linux__
+        readFd = writeFd = eventfd(0, EFD_NONBLOCK); // One eventfd is both ends
+#else
+        int fds[2]; // Declare the two ends of the pipe
+        if (pipe(fds) != 0) { // If the pipe could not be created
+            fds[0] = fds[1] = -1;
+        }
+        readFd = fds[0]; // Read end
+        writeFd = fds[1]; // Write end
+        fcntl(readFd, F_SETFL, O_NONBLOCK); // Never block when draining
+        fcntl(writeFd, F_SETFL, O_NONBLOCK); // Never block when notifying
+#endif
+    }
+
+    ~WakeupSignal() { // Destructor for WakeupSignal, closes the descriptors
+        close(readFd); // Close the read end
+        if (writeFd != readFd) { // If there is a separate write end
+            close(writeFd); // Close it
+        }
+    }
+
+    void notify() { // Wake the waiting thread
+        uint64_t one = 1; // Value added to the eventfd counter
+        ssize_t result = write(writeFd, &one, sizeof(one)); // Signal the waiter
+        (void)result; // A full pipe already holds a wakeup
+    }
+
+    void wait(int timeoutMs) { // Sleep until notified or until the timeout passes
+        pollfd entry; // Declare the entry waited on
+        entry.fd = readFd; // Wait on the read end
+        entry.events = POLLIN; // Wait for a wakeup
+        entry.revents = 0; // No events yet
+        if (poll(&entry, 1, timeoutMs) > 0) { // If a wakeup arrived
+            char drain[64]; // Buffer to empty the descriptor
+            while (read(readFd, drain, sizeof(drain)) > 0) { // Empty it so the next wait sleeps again
+            }
+        }
+    }
+};
+
+class ChangeFeed { // In-process change feed, a lock-free ring of the latest appended nodes read by up to FEED_MAX_SUBSCRIBERS threads, blocks older than the ring are walked from the chain because nodes are never changed once linked
+private: // Private members
+    struct Subscriber { // State of one subscriber
+        atomic<int64_t> cursor; // Number of the next block the subscriber reads, -1 when the slot is free
+        atomic<bool> waiting; // Flag set while the subscriber sleeps on its signal
+        WakeupSignal signal; // Signal that wakes the subscriber
+        vector<const BlockNode*> backlog; // Blocks walked from the chain and not yet read, newest first, only used by the subscriber's own thread
+    };
+
+    atomic<const BlockNode*> slots[FEED_CAPACITY]; // Ring of the latest nodes, block n is in slot n % FEED_CAPACITY
+    atomic<int64_t> published; // Number of the next block to be published
+    Subscriber subscribers[FEED_MAX_SUBSCRIBERS]; // The subscribers
+    atomic<bool> producerWaiting; // Flag set while the producer waits for a subscriber
+    WakeupSignal spaceReady; // Signal that wakes the producer
+
+    bool subscriberNeedsSlot(int64_t blockNumber) { // Check if any subscriber still has to read the block about to be overwritten
+        for (int i = 0; i < FEED_MAX_SUBSCRIBERS; i++) { // For loop over the subscribers
+            if (subscribers[i].cursor.load(memory_order_acquire) == blockNumber) { // If the subscriber reads that block next
+                return true;
+            }
+        }
+        return false;
+    }
+
+public: // Public members
+    ChangeFeed() { // Constructor for ChangeFeed, starts with an empty ring and no subscribers
+        for (int64_t i = 0; i < FEED_CAPACITY; i++) { // For loop over the slots
+            slots[i].store(nullptr); // Empty the slot
+        }
+        for (int i = 0; i < FEED_MAX_SUBSCRIBERS; i++) { // For loop over the subscribers
+            subscribers[i].cursor.store(-1); // Free the slot
+            subscribers[i].waiting.store(false); // Not sleeping
+        }
+        published.store(0); // Nothing published yet
+        producerWaiting.store(false); // The producer is not waiting
+    }
+
+    void start(const BlockNode* head, int64_t blockCount) { // Start the feed on a chain that already has blocks, so subscribers can walk back to them
+        if (blockCount > 0) { // If the chain has blocks
+            slots[(blockCount - 1) % FEED_CAPACITY].store(head, memory_order_relaxed); // The head is the newest block
+        }
+        published.store(blockCount, memory_order_release); // The next block published follows the existing ones
+    }
+
+    void publish(const BlockNode* node) { // Publish a node just appended, called by the thread appending to the chain, waits at most FEED_BACKPRESSURE_MS for a subscriber about to lose its place in the ring
+        int64_t blockNumber = node->data.blockNumber; // Number of the block
+        chrono::steady_clock::time_point deadline = chrono::steady_clock::now() + chrono::milliseconds(FEED_BACKPRESSURE_MS); // Latest time to stop waiting
+        while (blockNumber >= FEED_CAPACITY && subscriberNeedsSlot(blockNumber - FEED_CAPACITY) && chrono::steady_clock::now() < deadline) { // While a subscriber still has to read the block in the slot
+            producerWaiting.store(true); // Ask the subscribers to wake the producer as they read
+            atomic_thread_fence(memory_order_seq_cst); // Pairs with the fence in next
+            if (subscriberNeedsSlot(blockNumber - FEED_CAPACITY)) { // Check again now the flag is visible
+                spaceReady.wait(FEED_BACKPRESSURE_MS); // Sleep until a subscriber reads
+            }
+            producerWaiting.store(false); // No longer waiting
+        }
+        slots[blockNumber % FEED_CAPACITY].store(node, memory_order_release); // Put the node in its slot
+        published.store(blockNumber + 1, memory_order_release); // Make it visible to the subscribers
+        atomic_thread_fence(memory_order_seq_cst); // Pairs with the fence in wait, so a subscriber going to sleep either sees the block or is woken
+        for (int i = 0; i < FEED_MAX_SUBSCRIBERS; i++) { // For loop over the subscribers
+            if (subscribers[i].waiting.load()) { // If the subscriber is asleep
+                subscribers[i].signal.notify(); // Wake it
+            }
+        }
+    }
+
+    int subscribe(int64_t fromBlockNumber) { // Subscribe from a block number, returns the subscriber ID or -1 if the feed is full
+        for (int i = 0; i < FEED_MAX_SUBSCRIBERS; i++) { // For loop over the subscriber slots
+            int64_t expected = -1; // A free slot holds -1
+            if (subscribers[i].cursor.compare_exchange_strong(expected, max<int64_t>(0, fromBlockNumber))) { // If the slot was free, claim it
+                subscribers[i].backlog.clear(); // Nothing walked yet
+                return i; // Return the subscriber ID
+            }
+        }
+        return -1; // Every slot is taken
+    }
+
+    void unsubscribe(int id) { // Give up a subscription, its slot can be reused
+        subscribers[id].backlog.clear(); // Forget the walked blocks
+        subscribers[id].cursor.store(-1, memory_order_release); // Free the slot
+    }
+
+    int64_t cursor(int id) { // Method to get the number of the next block a subscriber reads, a consumer that stops can subscribe from it later to resume
+        return subscribers[id].cursor.load(); // Return the cursor
+    }
+
+    shared_ptr<const Block> next(int id) { // Read the subscriber's next block without waiting, returns nullptr if no new block has been published
+        Subscriber& subscriber = subscribers[id]; // The subscriber
+        int64_t cursor = subscriber.cursor.load(memory_order_relaxed); // Next block to read
+        const BlockNode* node = nullptr; // Node read
+        if (!subscriber.backlog.empty()) { // If blocks walked from the chain are waiting
+            node = subscriber.backlog.back(); // Take the oldest
+            subscriber.backlog.pop_back();
+        } else { // Read from the ring
+            int64_t available = published.load(memory_order_acquire); // Blocks published so far
+            if (cursor >= available) { // If nothing new was published
+                return shared_ptr<const Block>();
+            }
+            node = slots[cursor % FEED_CAPACITY].load(memory_order_acquire); // Node in the cursor's slot
+            if (node == nullptr || node->data.blockNumber != cursor) { // If the slot was overwritten, or the block came before the feed started
+                for (const BlockNode* walk = slots[(available - 1) % FEED_CAPACITY].load(memory_order_acquire); walk != nullptr && walk->data.blockNumber >= cursor; walk = walk->next) { // Walk the chain down from a newer node to the cursor
+                    subscriber.backlog.push_back(walk); // Remember the block
+                }
+                if (subscriber.backlog.empty()) { // If the chain does not reach the cursor
+                    return shared_ptr<const Block>();
+                }
+                node = subscriber.backlog.back(); // Take the oldest
+                subscriber.backlog.pop_back();
+            }
+        }
+        subscriber.cursor.store(cursor + 1, memory_order_release); // Move the cursor past the block
+        atomic_thread_fence(memory_order_seq_cst); // Pairs with the producer setting its waiting flag, so a waiting producer is always woken
+        if (producerWaiting.load()) { // If the producer waits for a subscriber to read
+            spaceReady.notify(); // Wake it
+        }
+        return blockOf(node); // Return the block, read back from the cold store if the subscriber is far enough behind for it to have been evicted
+    }
+
+    shared_ptr<const Block> wait(int id, int timeoutMs) { // Read the subscriber's next block, waiting at most timeoutMs for one to be published, returns nullptr on timeout
+        for (int i = 0; i < FEED_SPIN_CHECKS; i++) { // Check for a while before sleeping, a block published in the meantime is read within microseconds
+            shared_ptr<const Block> block = next(id); // Try to read a block
+            if (block != nullptr) { // If one was published
+                return block;
+            }
+        }
+        chrono::steady_clock::time_point deadline = chrono::steady_clock::now() + chrono::milliseconds(timeoutMs); // Latest time to stop waiting
+        Subscriber& subscriber = subscribers[id]; // The subscriber
+        subscriber.waiting.store(true); // Ask the producer for a wakeup
+        atomic_thread_fence(memory_order_seq_cst); // Pairs with the fence in publish
+        shared_ptr<const Block> block = next(id); // Check again now the flag is visible
+        while (block == nullptr && chrono::steady_clock::now() < deadline) { // While nothing was published and time is left, a wakeup left over from an earlier block can end a sleep early
+            subscriber.signal.wait(static_cast<int>(max<int64_t>(1, chrono::duration_cast<chrono::milliseconds>(deadline - chrono::steady_clock::now()).count()))); // Sleep until woken
+            block = next(id); // Read the block that woke the subscriber
+        }
+        subscriber.waiting.store(false); // No longer asleep
+        return block; // Return the block, or nullptr on timeout
+    }
+};
+
+struct SharedFeedSlot { // One block in the shared memory ring
+    atomic<uint64_t> sequence; // Block number plus one once the slot holds a whole block, 0 while the block is being written
+    uint64_t publishedNanos; // Steady clock time the block was published, used to report latency
+    uint32_t length; // Length of the encoded block, 0 when the block was too large for the slot
+    char data[SHARED_FEED_SLOT_BYTES]; // Encoded block
+};
+
+struct SharedFeedRegion { // Layout of the shared memory of a feed
+    char magic[8]; // Format name, written last when the feed is created
+    atomic<uint64_t> published; // Number of the next block to be published
+    atomic<uint64_t> firstBlock; // Number of the first block published to the feed, older blocks are fetched from the server
+    atomic<uint32_t> wakeSequence; // Changed after every publish, consumers sleep until it changes
+    atomic<uint32_t> sleepers; // Number of consumers asleep
+    atomic<int64_t> consumerCursors[FEED_MAX_SUBSCRIBERS]; // Next block of each consumer, -1 when the slot is free
+    SharedFeedSlot slots[SHARED_FEED_SLOTS]; // Ring of the latest blocks, block n is in slot n % SHARED_FEED_SLOTS
+};
+
+class SharedChangeFeed { // Cross-process change feed, a ring of encoded blocks in POSIX shared memory written by the server and read by consumer processes
+private: // Private members
+    string name; // Name of the shared memory
+    bool owner; // Flag to indicate that this process created the feed
+    SharedFeedRegion* region; // Mapped shared memory, nullptr if it could not be mapped
+    int consumerSlot; // Cursor slot of this consumer, -1 when not subscribed
+
+    void sleepForChange(uint32_t seen, int timeoutMs) { // Sleep until the producer publishes or the timeout passes
+#ifdef __linux__
+        timespec timeout; // Declare the timeout
+        timeout.tv_sec = timeoutMs / 1000; // Whole seconds
+        timeout.tv_nsec = (timeoutMs % 1000) * 1000000L; // Rest in nanoseconds
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&region->wakeSequence), FUTEX_WAIT, seen, &timeout, nullptr, 0); // Sleep on the shared word, across processes
+#else
+        (void)seen;
+        (void)timeoutMs;
+        usleep(50); // Poll the shared word
+#endif
+    }
+
+public: // Public members
+    SharedChangeFeed(const string& feedName, bool create) { // Constructor for SharedChangeFeed, creates the feed when create is true and opens an existing one otherwise
+        name = feedName[0] == '/' ? feedName : "/" + feedName; // Shared memory names start with a slash
+        owner = create; // Remember who removes the feed
+        region = nullptr; // Not mapped yet
+        consumerSlot = -1; // Not subscribed
+        if (create) { // If this process is the producer
+            shm_unlink(name.c_str()); // Remove a feed left by an earlier run
+        }
+        int fd = shm_open(name.c_str(), create ? O_RDWR | O_CREAT | O_EXCL : O_RDWR, 0644); // Open the shared memory
+        if (fd == -1 || (create && ftruncate(fd, sizeof(SharedFeedRegion)) != 0)) { // If it could not be opened or sized
+            cout << "Error: Unable to open change feed " << feedName << "." << endl; // Tell the user
+            if (fd != -1) {
+                close(fd);
+            }
+            return;
+        }
+        void* memory = mmap(nullptr, sizeof(SharedFeedRegion), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0); // Map it
+        close(fd); // The mapping keeps the memory alive
+        if (memory == MAP_FAILED) { // If it could not be mapped
+            cout << "Error: Unable to map change feed " << feedName << "." << endl; // Tell the user
+            return;
+        }
+        region = static_cast<SharedFeedRegion*>(memory); // Use the mapping
+        if (create) { // If the feed is new
+            region->published.store(0); // Nothing published yet
+            region->firstBlock.store(0); // The feed starts at the first block until told otherwise
+            region->wakeSequence.store(0); // No publishes yet
+            region->sleepers.store(0); // Nobody asleep
+            for (int i = 0; i < FEED_MAX_SUBSCRIBERS; i++) { // For loop over the consumer slots
+                region->consumerCursors[i].store(-1); // Free the slot
+            }
+            for (int64_t i = 0; i < SHARED_FEED_SLOTS; i++) { // For loop over the ring
+                region->slots[i].sequence.store(0); // Empty the slot
+            }
+            atomic_thread_fence(memory_order_release); // Every field is set before the format name
+            memcpy(region->magic, "BCFEED1", 8); // Mark the feed as ready
+        } else if (memcmp(region->magic, "BCFEED1", 8) != 0) { // If the memory is not a ready feed
+            cout << "Error: " << feedName << " is not a change feed." << endl; // Tell the user
+            munmap(region, sizeof(SharedFeedRegion)); // Unmap it
+            region = nullptr;
+        }
+    }
+
+    ~SharedChangeFeed() { // Destructor for SharedChangeFeed, frees the consumer slot and unmaps the feed, the producer also removes it
+        if (region == nullptr) { // If the feed was never mapped
+            return;
+        }
+        if (consumerSlot != -1) { // If this process was subscribed
+            region->consumerCursors[consumerSlot].store(-1); // Free its slot
+        }
+        munmap(region, sizeof(SharedFeedRegion)); // Unmap the feed
+        if (owner) { // If this process created the feed
+            shm_unlink(name.c_str()); // Remove it
+        }
+    }
+
+    bool isOpen() { // Method to check that the feed is mapped
+        return region != nullptr;
+    }
+
+    void start(int64_t blockCount) { // Start the feed after the blocks the chain already has
+        region->firstBlock.store(static_cast<uint64_t>(blockCount), memory_order_relaxed); // The existing blocks are not in the feed
+        region->published.store(static_cast<uint64_t>(blockCount), memory_order_release); // The next block published follows the existing ones
+    }
+
+    void publish(const Block& block) { // Publish a block, waits at most FEED_BACKPRESSURE_MS for a consumer about to lose its place in the ring
+        int64_t blockNumber = block.blockNumber; // Number of the block
+        chrono::steady_clock::time_point deadline = chrono::steady_clock::now() + chrono::milliseconds(FEED_BACKPRESSURE_MS); // Latest time to stop waiting
+        bool consumerBehind = true; // Flag to indicate that a consumer still has to read the block in the slot
+        while (consumerBehind && blockNumber >= SHARED_FEED_SLOTS && chrono::steady_clock::now() < deadline) { // While a consumer still has to read it
+            consumerBehind = false;
+            for (int i = 0; i < FEED_MAX_SUBSCRIBERS && !consumerBehind; i++) { // For loop over the consumers
+                consumerBehind = region->consumerCursors[i].load(memory_order_acquire) == blockNumber - SHARED_FEED_SLOTS; // Check the consumer
+            }
+            if (consumerBehind) { // If a consumer is about to fall behind
+                usleep(20); // Give it a moment
+            }
+        }
+
+        string scratch; // Declare an encoding for a block whose canonical encoding cannot be sent
+        const string* encoded = &block.encoded; // Bytes copied into the slot, the canonical encoding made when the block was linked
+        if (block.encoded.empty() || block.isSoftDeleted) { // If the block has no encoding or its information must be left out
+            encodeBlock(block, scratch); // Encode the block
+            encoded = &scratch;
+        }
+        SharedFeedSlot& slot = region->slots[blockNumber % SHARED_FEED_SLOTS]; // Slot of the block
+        slot.sequence.store(0, memory_order_relaxed); // Mark the slot as being written
+        atomic_thread_fence(memory_order_release); // Readers see the mark before the new bytes
+        slot.length = encoded->size() <= SHARED_FEED_SLOT_BYTES ? static_cast<uint32_t>(encoded->size()) : 0; // Length, 0 when the block does not fit
+        memcpy(slot.data, encoded->data(), slot.length); // Copy the block
+        slot.publishedNanos = static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count()); // Time the block was published
+        slot.sequence.store(static_cast<uint64_t>(blockNumber) + 1, memory_order_release); // The slot holds the whole block
+        region->published.store(static_cast<uint64_t>(blockNumber) + 1, memory_order_release); // Make it visible to the consumers
+        region->wakeSequence.fetch_add(1, memory_order_release); // Change the word the consumers sleep on
+#ifdef __linux__
+        if (region->sleepers.load() > 0) { // If a consumer is asleep
+            syscall(SYS_futex, reinterpret_cast<uint32_t*>(&region->wakeSequence), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0); // Wake every consumer
+        }
+#endif
+    }
+
+    bool subscribe(int64_t fromBlockNumber) { // Subscribe this process from a block number, returns false if every consumer slot is taken
+        for (int i = 0; i < FEED_MAX_SUBSCRIBERS; i++) { // For loop over the consumer slots
+            int64_t expected = -1; // A free slot holds -1
+            if (region->consumerCursors[i].compare_exchange_strong(expected, max<int64_t>(0, fromBlockNumber))) { // If the slot was free, claim it
+                consumerSlot = i; // Remember the slot
+                return true;
+            }
+        }
+        return false; // Every slot is taken
+    }
+
+    int64_t cursor() { // Method to get the number of the next block this consumer reads, it can subscribe from it again to resume
+        return region->consumerCursors[consumerSlot].load(); // Return the cursor
+    }
+
+    int read(Block& block, uint64_t& latencyNanos, int timeoutMs) { // Read the next block, waiting at most timeoutMs, returns FEED_BLOCK, FEED_NONE, FEED_BEHIND or FEED_TOO_LARGE
+        atomic<int64_t>& cursor = region->consumerCursors[consumerSlot]; // Cursor of this consumer
+        chrono::steady_clock::time_point deadline = chrono::steady_clock::now() + chrono::milliseconds(timeoutMs); // Latest time to stop waiting
+        for (int checks = 0; ; checks++) { // Loop until a block arrives or the time runs out
+            int64_t next = cursor.load(memory_order_relaxed); // Next block to read
+            uint32_t seen = region->wakeSequence.load(memory_order_acquire); // Publishes seen so far
+            int64_t available = static_cast<int64_t>(region->published.load(memory_order_acquire)); // Blocks published so far
+            if (next < available) { // If the block was published
+                int64_t oldest = max(static_cast<int64_t>(region->firstBlock.load(memory_order_relaxed)), available - SHARED_FEED_SLOTS); // Oldest block still in the ring
+                if (next < oldest) { // If the block has already left the ring, or came before the feed started
+                    cursor.store(oldest, memory_order_release); // Move to the oldest block still there
+                    return FEED_BEHIND;
+                }
+                SharedFeedSlot& slot = region->slots[next % SHARED_FEED_SLOTS]; // Slot of the block
+                uint64_t sequence = slot.sequence.load(memory_order_acquire); // Version of the slot before copying
+                if (sequence == static_cast<uint64_t>(next) + 1) { // If the slot holds the block
+                    uint32_t length = slot.length; // Length of the block
+                    string encoded(slot.data, min<size_t>(length, SHARED_FEED_SLOT_BYTES)); // Copy the block out
+                    latencyNanos = static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count()) - slot.publishedNanos; // Time since the block was published
+                    atomic_thread_fence(memory_order_acquire); // Check the version after the copy
+                    if (slot.sequence.load(memory_order_relaxed) == sequence) { // If the slot was not overwritten while copying
+                        size_t pos = 0; // Position in the block
+                        cursor.store(next + 1, memory_order_release); // Move past the block
+                        if (length == 0 || !decodeBlock(encoded, pos, block)) { // If the block did not fit in the slot
+                            block.blockNumber = static_cast<int>(next); // Tell the caller which block to fetch
+                            return FEED_TOO_LARGE;
+                        }
+                        return FEED_BLOCK; // Return the block
+                    }
+                }
+                continue; // The slot changed under the reader, look again
+            }
+            if (chrono::steady_clock::now() >= deadline) { // If the time ran out
+                return FEED_NONE;
+            }
+            if (checks >= FEED_SPIN_CHECKS) { // If checking has not found a block for a while
+                region->sleepers.fetch_add(1); // Ask the producer for a wakeup
+                if (static_cast<int64_t>(region->published.load(memory_order_acquire)) <= next) { // Check again now the request is visible
+                    sleepForChange(seen, static_cast<int>(max<int64_t>(1, chrono::duration_cast<chrono::milliseconds>(deadline - chrono::steady_clock::now()).count()))); // Sleep until a publish
+                }
+                region->sleepers.fetch_sub(1); // Awake again
+            }
+        }
+    }
+};
+
+void publishToSharedFeed(ChangeFeed* feed, SharedChangeFeed* sharedFeed, int64_t fromBlockNumber, atomic<bool>* stopping) { // Feed thread, copies every block from the in-process feed into the shared memory feed, so encoding never holds up the appending thread
+    int id = feed->subscribe(fromBlockNumber); // Subscribe to the in-process feed
+    while (id != -1 && !stopping->load()) { // Loop until asked to stop
+        shared_ptr<const Block> block = feed->wait(id, 200); // Wait for the next block
+        if (block != nullptr) { // If a block arrived
+            sharedFeed->publish(*block); // Publish it to the other processes
+        }
+    }
+    if (id != -1) { // If the thread subscribed
+        feed->unsubscribe(id); // Give up the subscription
+    }
+}
+
+// Write-ahead log records: u32 payload length, u32 checksum of the payload, then the payload, which starts with the record type.
+const unsigned char WAL_APPEND = 1; // Payload: the block encoded with its information
+const unsigned char WAL_SOFT_DELETE = 2; // Payload: block number
+const unsigned char WAL_HARD_DELETE = 3; // Payload: block number
+const size_t WAL_CHECKPOINT_RECORDS = 4096; // Records logged between checkpoints, so recovery never replays more than this many records
+const size_t CHECKPOINT_WRITE_BYTES = 1 << 20; // Bytes of a checkpoint collected before they are written
+const size_t RECOVERY_BATCH_BYTES = 8 << 20; // Bytes of a checkpoint read and decoded at a time when the cold store has a limit, a batch is bounded by bytes so large blocks do not make it large
+
+uint32_t recordChecksum(const string& payload) { // Function to work out the FNV-1a checksum of a log record, used to find a record torn by a crash
+    uint32_t hash = 2166136261u; // FNV-1a offset basis
+    for (size_t i = 0; i < payload.size(); ++i) { // For loop over the bytes
+        hash = (hash ^ static_cast<unsigned char>(payload[i])) * 16777619u; // Mix in the byte
+    }
+    return hash; // Return the checksum
+}
+
+string walRecord(const string& payload) { // Function to frame a payload as a log record
+    string record; // Declare the record
+    appendUint32(record, static_cast<uint32_t>(payload.size())); // Append the length
+    appendUint32(record, recordChecksum(payload)); // Append the checksum
+    record += payload; // Append the payload
+    return record;
+}
+
+void forEachInParallel(size_t count, const function<void(size_t)>& work, size_t indexesPerThread = 256) { // Function to run work for every index below count, spread over the cores, with at least indexesPerThread indexes for every extra thread
+    size_t threadCount = min(static_cast<size_t>(max(1u, thread::hardware_concurrency())), count / indexesPerThread + 1); // Small jobs are not worth extra threads
+    vector<thread> workers; // Declare the worker threads
+    for (size_t t = 0; t < threadCount; ++t) { // For loop to start the workers
+        workers.push_back(thread([t, threadCount, count, &work] { // Each worker takes every threadCount-th index
+            for (size_t i = t; i < count; i += threadCount) { // For loop over the indexes of the worker
+                work(i); // Do the work
+            }
+        }));
+    }
+    for (size_t t = 0; t < workers.size(); ++t) { // For loop to wait for the workers
+        workers[t].join(); // Wait for the worker
+    }
+}
+
+const uint64_t SHA512_ROUND_CONSTANTS[80] = { // Round constants of SHA-512
+    0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL, 0xb5c0fbcfec4d3b2fULL, 0xe9b5dba58189dbbcULL, 0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL, 0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL,
+    0xd807aa98a3030242ULL, 0x12835b0145706fbeULL, 0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL, 0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL, 0x9bdc06a725c71235ULL, 0xc19bf174cf692694ULL,
+    0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL, 0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL, 0x2de92c6f592b0275ULL, 0x4a7484aa6ea6e483ULL, 0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL,
+    0x983e5152ee66dfabULL, 0xa831c66d2db43210ULL, 0xb00327c898fb213fULL, 0xbf597fc7beef0ee4ULL, 0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL, 0x06ca6351e003826fULL, 0x142929670a0e6e70ULL,
+    0x27b70a8546d22ffcULL, 0x2e1b21385c26c926ULL, 0x4d2c6dfc5ac42aedULL, 0x53380d139d95b3dfULL, 0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL, 0x81c2c92e47edaee6ULL, 0x92722c851482353bULL,
+    0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL, 0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL, 0xd192e819d6ef5218ULL, 0xd69906245565a910ULL, 0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL,
+    0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL, 0x2748774cdf8eeb99ULL, 0x34b0bcb5e19b48a8ULL, 0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL, 0x5b9cca4f7763e373ULL, 0x682e6ff3d6b2b8a3ULL,
+    0x748f82ee5defb2fcULL, 0x78a5636f43172f60ULL, 0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL, 0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL, 0xbef9a3f7b2c67915ULL, 0xc67178f2e372532bULL,
+    0xca273eceea26619cULL, 0xd186b8c721c0c207ULL, 0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL, 0x06f067aa72176fbaULL, 0x0a637dc5a2c898a6ULL, 0x113f9804bef90daeULL, 0x1b710b35131c471bULL,
+    0x28db77f523047d84ULL, 0x32caab7b40c72493ULL, 0x3c9ebe0a15c9bebcULL, 0x431d67c49c100d4cULL, 0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL, 0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL
+};
+const uint64_t SHA512_INITIAL_STATE[8] = { 0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL, 0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL, 0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL, 0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL }; // Starting state of SHA-512
+const size_t SIGNATURE_KEY_BYTES = 32; // Length of an Ed25519 public key or seed
+const size_t SIGNATURE_BYTES = 64; // Length of an Ed25519 signature
+const size_t SIGNATURE_BATCH = 256; // Signatures checked together by one batch verification, larger batches share more work but a bad signature sends the whole batch back to being checked one by one
+const int MSM_WINDOW_BITS = 5; // Bits of every scalar taken per round of the bucket method that adds up a batch's points
+const size_t SIGNATURE_CHUNK_BLOCKS = 16384; // Signed blocks gathered before they are checked together when a whole chain is checked
+
+inline uint64_t rotateRight64(uint64_t value, int bits) { // Function to rotate a 64 bit number right
+    return (value >> bits) | (value << (64 - bits)); // Return the rotated number
+}
+
+void sha512Compress(uint64_t state[8], const unsigned char* chunk) { // Function to mix one 128 byte chunk into a SHA-512 state
+    uint64_t w[80]; // Message schedule
+    for (int i = 0; i < 16; i++) { // For loop to read the chunk as 16 words, most significant byte first
+        w[i] = 0; // Reset the word
+        for (int j = 0; j < 8; j++) { // For loop over the bytes of the word
+            w[i] = (w[i] << 8) | chunk[i * 8 + j]; // Shift in the byte
+        }
+    }
+    for (int i = 16; i < 80; i++) { // For loop to extend the schedule
+        uint64_t s0 = rotateRight64(w[i - 15], 1) ^ rotateRight64(w[i - 15], 8) ^ (w[i - 15] >> 7); // First mixing term
+        uint64_t s1 = rotateRight64(w[i - 2], 19) ^ rotateRight64(w[i - 2], 61) ^ (w[i - 2] >> 6); // Second mixing term
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1; // Extend the schedule
+    }
+    uint64_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4], f = state[5], g = state[6], h = state[7]; // Working variables
+    for (int i = 0; i < 80; i++) { // For loop over the rounds
+        uint64_t t1 = h + (rotateRight64(e, 14) ^ rotateRight64(e, 18) ^ rotateRight64(e, 41)) + ((e & f) ^ (~e & g)) + SHA512_ROUND_CONSTANTS[i] + w[i]; // First temporary
+        uint64_t t2 = (rotateRight64(a, 28) ^ rotateRight64(a, 34) ^ rotateRight64(a, 39)) + ((a & b) ^ (a & c) ^ (b & c)); // Second temporary
+        h = g; g = f; f = e; e = d + t1; d = c; c = b; b = a; a = t1 + t2; // Rotate the working variables
+    }
+    state[0] += a; state[1] += b; state[2] += c; state[3] += d; state[4] += e; state[5] += f; state[6] += g; state[7] += h; // Add the chunk into the state
+}
+
+string sha512(const string& message) { // Function to work out the SHA-512 hash of a message as 64 raw bytes, the hash Ed25519 is defined with
+    uint64_t state[8]; // Declare the state
+    memcpy(state, SHA512_INITIAL_STATE, sizeof(state)); // Start from the initial state
+    string padded = message + static_cast<char>(0x80); // The padding starts with a single set bit
+    while (padded.size() % 128 != 112) { // Pad with zeros until 16 bytes are left in the chunk
+        padded += static_cast<char>(0); // Add a zero
+    }
+    padded += string(8, '\0'); // The high half of the length is always zero here
+    uint64_t bitLength = static_cast<uint64_t>(message.size()) * 8; // Length of the message in bits
+    for (int i = 7; i >= 0; i--) { // For loop to append the length, most significant byte first
+        padded += static_cast<char>((bitLength >> (i * 8)) & 0xFF); // Append the byte
+    }
+    for (size_t pos = 0; pos < padded.size(); pos += 128) { // For loop over the chunks
+        sha512Compress(state, reinterpret_cast<const unsigned char*>(padded.data() + pos)); // Mix in the chunk
+    }
+    string digest(64, '\0'); // Declare the hash
+    for (int i = 0; i < 8; i++) { // For loop over the state words
+        for (int j = 0; j < 8; j++) { // For loop over the bytes of the word, most significant first
+            digest[i * 8 + j] = static_cast<char>((state[i] >> (56 - j * 8)) & 0xFF); // Set the byte
+        }
+    }
+    return digest; // Return the hash
+}
+
+string toHex(const string& bytes) { // Function to write raw bytes as hexadecimal characters
+    static const char digits[] = "0123456789abcdef"; // Hexadecimal digits
+    string hex; // Declare the characters
+    for (size_t i = 0; i < bytes.size(); ++i) { // For loop over the bytes
+        hex += digits[(static_cast<unsigned char>(bytes[i]) >> 4) & 0xF]; // Append the high digit
+        hex += digits[static_cast<unsigned char>(bytes[i]) & 0xF]; // Append the low digit
+    }
+    return hex; // Return the characters
+}
+
+bool fromHex(const string& hex, string& bytes) { // Function to read hexadecimal characters back into raw bytes, returns false if a character is not a hexadecimal digit
+    if (hex.size() % 2 != 0) { // If a digit is missing
+        return false;
+    }
+    bytes.clear(); // Clear the bytes
+    for (size_t i = 0; i < hex.size(); i += 2) { // For loop over the pairs of digits
+        if (!isxdigit(static_cast<unsigned char>(hex[i])) || !isxdigit(static_cast<unsigned char>(hex[i + 1]))) { // If a character is not a digit
+            return false;
+        }
+        bytes += static_cast<char>(stoi(hex.substr(i, 2), nullptr, 16)); // Append the byte
+    }
+    return true;
+}
+
+// Ed25519 signatures (RFC 8032). Field elements are numbers modulo p = 2^255 - 19 held as five 51 bit limbs, points are on the
+// twisted Edwards curve -x^2 + y^2 = 1 + d x^2 y^2 in extended coordinates (X:Y:Z:T) with x = X/Z, y = Y/Z and xy = T/Z.
+// Scalars are numbers modulo the group order L held as four 64 bit limbs, least significant first.
+typedef unsigned __int128 uint128; // Double width product of two limbs
+
+const uint64_t FIELD_MASK = (1ULL << 51) - 1; // Bits of one field limb
+
+struct FieldElement { // Number modulo p
+    uint64_t v[5]; // Limbs, least significant first, each kept just above 51 bits at most between operations
+};
+
+const FieldElement FIELD_ZERO = {{0, 0, 0, 0, 0}}; // The number 0
+const FieldElement FIELD_ONE = {{1, 0, 0, 0, 0}}; // The number 1
+const FieldElement CURVE_D = {{0x34dca135978a3ULL, 0x1a8283b156ebdULL, 0x5e7a26001c029ULL, 0x739c663a03cbbULL, 0x52036cee2b6ffULL}}; // Curve constant d = -121665/121666
+const FieldElement CURVE_2D = {{0x69b9426b2f159ULL, 0x35050762add7aULL, 0x3cf44c0038052ULL, 0x6738cc7407977ULL, 0x2406d9dc56dffULL}}; // 2d, used by every point addition
+const FieldElement SQRT_MINUS_ONE = {{0x61b274a0ea0b0ULL, 0xd5a5fc8f189dULL, 0x7ef5e9cbd0c60ULL, 0x78595a6804c9eULL, 0x2b8324804fc1dULL}}; // A square root of -1, used when decoding points
+const uint64_t GROUP_ORDER[4] = { 0x5812631a5cf5d3edULL, 0x14def9dea2f79cd6ULL, 0, 0x1000000000000000ULL }; // L = 2^252 + 27742317777372353535851937790883648493
+
+inline void fieldCarry(FieldElement& r) { // Function to carry every limb into the next, the carry out of the top limb wraps round times 19 as 2^255 = 19 modulo p
+    uint64_t c; // Declare the carry
+    c = r.v[0] >> 51; r.v[0] &= FIELD_MASK; r.v[1] += c; // Carry the first limb
+    c = r.v[1] >> 51; r.v[1] &= FIELD_MASK; r.v[2] += c; // Carry the second limb
+    c = r.v[2] >> 51; r.v[2] &= FIELD_MASK; r.v[3] += c; // Carry the third limb
+    c = r.v[3] >> 51; r.v[3] &= FIELD_MASK; r.v[4] += c; // Carry the fourth limb
+    c = r.v[4] >> 51; r.v[4] &= FIELD_MASK; r.v[0] += c * 19; // Wrap the carry of the top limb
+}
+
+inline FieldElement fieldAdd(const FieldElement& a, const FieldElement& b) { // Function to add two field elements
+    FieldElement r; // Declare the sum
+    for (int i = 0; i < 5; i++) { // For loop over the limbs
+        r.v[i] = a.v[i] + b.v[i]; // Add the limbs
+    }
+    fieldCarry(r); // Keep the limbs small
+    return r; // Return the sum
+}
+
+inline FieldElement fieldSub(const FieldElement& a, const FieldElement& b) { // Function to subtract two field elements, 4p is added first so no limb goes below zero
+    FieldElement r; // Declare the difference
+    r.v[0] = a.v[0] + 0x1FFFFFFFFFFFB4ULL - b.v[0]; // Subtract the first limb
+    for (int i = 1; i < 5; i++) { // For loop over the other limbs
+        r.v[i] = a.v[i] + 0x1FFFFFFFFFFFFCULL - b.v[i]; // Subtract the limb
+    }
+    fieldCarry(r); // Keep the limbs small
+    return r; // Return the difference
+}
+
+inline FieldElement fieldNegate(const FieldElement& a) { // Function to negate a field element
+    return fieldSub(FIELD_ZERO, a); // Return 0 - a
+}
+
+inline FieldElement fieldMul(const FieldElement& a, const FieldElement& b) { // Function to multiply two field elements, the products above 2^255 are folded back times 19
+    uint64_t b1 = b.v[1] * 19, b2 = b.v[2] * 19, b3 = b.v[3] * 19, b4 = b.v[4] * 19; // Limbs of b times 19
+    uint128 t0 = (uint128)a.v[0] * b.v[0] + (uint128)a.v[1] * b4 + (uint128)a.v[2] * b3 + (uint128)a.v[3] * b2 + (uint128)a.v[4] * b1; // Products landing on the first limb
+    uint128 t1 = (uint128)a.v[0] * b.v[1] + (uint128)a.v[1] * b.v[0] + (uint128)a.v[2] * b4 + (uint128)a.v[3] * b3 + (uint128)a.v[4] * b2; // Products landing on the second limb
+    uint128 t2 = (uint128)a.v[0] * b.v[2] + (uint128)a.v[1] * b.v[1] + (uint128)a.v[2] * b.v[0] + (uint128)a.v[3] * b4 + (uint128)a.v[4] * b3; // Products landing on the third limb
+    uint128 t3 = (uint128)a.v[0] * b.v[3] + (uint128)a.v[1] * b.v[2] + (uint128)a.v[2] * b.v[1] + (uint128)a.v[3] * b.v[0] + (uint128)a.v[4] * b4; // Products landing on the fourth limb
+    uint128 t4 = (uint128)a.v[0] * b.v[4] + (uint128)a.v[1] * b.v[3] + (uint128)a.v[2] * b.v[2] + (uint128)a.v[3] * b.v[1] + (uint128)a.v[4] * b.v[0]; // Products landing on the top limb
+    FieldElement r; // Declare the product
+    t1 += t0 >> 51; r.v[0] = static_cast<uint64_t>(t0) & FIELD_MASK; // Carry the first limb
+    t2 += t1 >> 51; r.v[1] = static_cast<uint64_t>(t1) & FIELD_MASK; // Carry the second limb
+    t3 += t2 >> 51; r.v[2] = static_cast<uint64_t>(t2) & FIELD_MASK; // Carry the third limb
+    t4 += t3 >> 51; r.v[3] = static_cast<uint64_t>(t3) & FIELD_MASK; // Carry the fourth limb
+    r.v[4] = static_cast<uint64_t>(t4) & FIELD_MASK; // Keep the low bits of the top limb
+    r.v[0] += static_cast<uint64_t>(t4 >> 51) * 19; // Wrap the carry of the top limb
+    r.v[1] += r.v[0] >> 51; r.v[0] &= FIELD_MASK; // Carry the first limb again
+    return r; // Return the product
+}
+
+inline FieldElement fieldSquare(const FieldElement& a) { // Function to square a field element
+    return fieldMul(a, a); // Return a times a
+}
+
+FieldElement fieldSquareTimes(FieldElement a, int times) { // Function to square a field element a number of times in a row
+    for (int i = 0; i < times; i++) { // For loop over the squarings
+        a = fieldSquare(a); // Square
+    }
+    return a; // Return the result
+}
+
+FieldElement fieldFromBytes(const unsigned char* bytes) { // Function to read a field element from 32 little endian bytes, the top bit is left out as it carries the sign of x in a point
+    uint64_t w[4]; // Declare the 64 bit words
+    for (int i = 0; i < 4; i++) { // For loop over the words
+        w[i] = 0; // Reset the word
+        for (int j = 7; j >= 0; j--) { // For loop over the bytes of the word, most significant first
+            w[i] = (w[i] << 8) | bytes[i * 8 + j]; // Shift in the byte
+        }
+    }
+    FieldElement r; // Declare the element
+    r.v[0] = w[0] & FIELD_MASK; // Bits 0 to 50
+    r.v[1] = ((w[0] >> 51) | (w[1] << 13)) & FIELD_MASK; // Bits 51 to 101
+    r.v[2] = ((w[1] >> 38) | (w[2] << 26)) & FIELD_MASK; // Bits 102 to 152
+    r.v[3] = ((w[2] >> 25) | (w[3] << 39)) & FIELD_MASK; // Bits 153 to 203
+    r.v[4] = (w[3] >> 12) & FIELD_MASK; // Bits 204 to 254
+    return r; // Return the element
+}
+
+void fieldToBytes(FieldElement a, unsigned char* bytes) { // Function to write a field element as 32 little endian bytes, fully reduced below p so every element has one encoding
+    fieldCarry(a); // Bring every limb below 2^51, apart from a small first limb
+    fieldCarry(a); // Carry once more so the number is below 2p
+    uint64_t q = (a.v[0] + 19) >> 51; // Work out whether a + 19 reaches 2^255, which is whether a is at least p
+    q = (a.v[1] + q) >> 51; // Carry through the second limb
+    q = (a.v[2] + q) >> 51; // Carry through the third limb
+    q = (a.v[3] + q) >> 51; // Carry through the fourth limb
+    q = (a.v[4] + q) >> 51; // Carry through the top limb
+    a.v[0] += 19 * q; // Subtract p by adding 19 and dropping 2^255
+    a.v[1] += a.v[0] >> 51; a.v[0] &= FIELD_MASK; // Carry the first limb
+    a.v[2] += a.v[1] >> 51; a.v[1] &= FIELD_MASK; // Carry the second limb
+    a.v[3] += a.v[2] >> 51; a.v[2] &= FIELD_MASK; // Carry the third limb
+    a.v[4] += a.v[3] >> 51; a.v[3] &= FIELD_MASK; // Carry the fourth limb
+    a.v[4] &= FIELD_MASK; // Drop 2^255
+    uint64_t w[4] = { a.v[0] | (a.v[1] << 51), (a.v[1] >> 13) | (a.v[2] << 38), (a.v[2] >> 26) | (a.v[3] << 25), (a.v[3] >> 39) | (a.v[4] << 12) }; // Pack the limbs into 64 bit words
+    for (int i = 0; i < 4; i++) { // For loop over the words
+        for (int j = 0; j < 8; j++) { // For loop over the bytes of the word, least significant first
+            bytes[i * 8 + j] = static_cast<unsigned char>(w[i] >> (j * 8)); // Set the byte
+        }
+    }
+}
+
+bool fieldIsZero(const FieldElement& a) { // Function to check whether a field element is 0
+    unsigned char bytes[32]; // Declare the encoding
+    fieldToBytes(a, bytes); // Encode the element
+    unsigned char any = 0; // Bits set in any byte
+    for (int i = 0; i < 32; i++) { // For loop over the bytes
+        any |= bytes[i]; // Collect the bits
+    }
+    return any == 0; // Zero if no bit is set
+}
+
+bool fieldIsNegative(const FieldElement& a) { // Function to check whether a field element is odd, which Ed25519 treats as negative
+    unsigned char bytes[32]; // Declare the encoding
+    fieldToBytes(a, bytes); // Encode the element
+    return (bytes[0] & 1) != 0; // Odd if the lowest bit is set
+}
+
+FieldElement fieldPow22523(const FieldElement& z) { // Function to raise a field element to (p - 5) / 8 = 2^252 - 3, used to take square roots
+    FieldElement z2 = fieldSquare(z); // z^2
+    FieldElement z9 = fieldMul(fieldSquareTimes(z2, 2), z); // z^9
+    FieldElement z11 = fieldMul(z9, z2); // z^11
+    FieldElement z5 = fieldMul(fieldSquare(z11), z9); // z^(2^5 - 1)
+    FieldElement z10 = fieldMul(fieldSquareTimes(z5, 5), z5); // z^(2^10 - 1)
+    FieldElement z20 = fieldMul(fieldSquareTimes(z10, 10), z10); // z^(2^20 - 1)
+    FieldElement z40 = fieldMul(fieldSquareTimes(z20, 20), z20); // z^(2^40 - 1)
+    FieldElement z50 = fieldMul(fieldSquareTimes(z40, 10), z10); // z^(2^50 - 1)
+    FieldElement z100 = fieldMul(fieldSquareTimes(z50, 50), z50); // z^(2^100 - 1)
+    FieldElement z200 = fieldMul(fieldSquareTimes(z100, 100), z100); // z^(2^200 - 1)
+    FieldElement z250 = fieldMul(fieldSquareTimes(z200, 50), z50); // z^(2^250 - 1)
+    return fieldMul(fieldSquareTimes(z250, 2), z); // z^(2^252 - 3)
+}
+
+FieldElement fieldInvert(const FieldElement& z) { // Function to invert a field element by raising it to p - 2 = 2^255 - 21
+    FieldElement z2 = fieldSquare(z); // z^2
+    FieldElement z9 = fieldMul(fieldSquareTimes(z2, 2), z); // z^9
+    FieldElement z11 = fieldMul(z9, z2); // z^11
+    FieldElement z5 = fieldMul(fieldSquare(z11), z9); // z^(2^5 - 1)
+    FieldElement z10 = fieldMul(fieldSquareTimes(z5, 5), z5); // z^(2^10 - 1)
+    FieldElement z20 = fieldMul(fieldSquareTimes(z10, 10), z10); // z^(2^20 - 1)
+    FieldElement z40 = fieldMul(fieldSquareTimes(z20, 20), z20); // z^(2^40 - 1)
+    FieldElement z50 = fieldMul(fieldSquareTimes(z40, 10), z10); // z^(2^50 - 1)
+    FieldElement z100 = fieldMul(fieldSquareTimes(z50, 50), z50); // z^(2^100 - 1)
+    FieldElement z200 = fieldMul(fieldSquareTimes(z100, 100), z100); // z^(2^200 - 1)
+    FieldElement z250 = fieldMul(fieldSquareTimes(z200, 50), z50); // z^(2^250 - 1)
+    return fieldMul(fieldSquareTimes(z250, 5), z11); // z^(2^255 - 21)
+}
+
+struct EdwardsPoint { // Point of the curve in extended coordinates
+    FieldElement X, Y, Z, T; // Coordinates, with x = X/Z, y = Y/Z and xy = T/Z
+};
+
+struct CachedPoint { // Point kept in the form it is added in, so adding the same point many times does the shared work once
+    FieldElement yPlusX, yMinusX, z2, t2d; // Y + X, Y - X, 2Z and 2dT
+};
+
+const EdwardsPoint POINT_IDENTITY = { FIELD_ZERO, FIELD_ONE, FIELD_ONE, FIELD_ZERO }; // The neutral point (0, 1)
+
+CachedPoint toCached(const EdwardsPoint& p) { // Function to bring a point into the form it is added in
+    CachedPoint c; // Declare the cached point
+    c.yPlusX = fieldAdd(p.Y, p.X); // Y + X
+    c.yMinusX = fieldSub(p.Y, p.X); // Y - X
+    c.z2 = fieldAdd(p.Z, p.Z); // 2Z
+    c.t2d = fieldMul(p.T, CURVE_2D); // 2dT
+    return c; // Return the cached point
+}
+
+EdwardsPoint pointAdd(const EdwardsPoint& p, const CachedPoint& q, bool subtract = false) { // Function to add (or subtract) a cached point to a point, the formulas are complete so doubling and the neutral point need no special case
+    FieldElement a = fieldMul(fieldSub(p.Y, p.X), subtract ? q.yPlusX : q.yMinusX); // (Y1 - X1)(Y2 - X2), the halves swap to negate q
+    FieldElement b = fieldMul(fieldAdd(p.Y, p.X), subtract ? q.yMinusX : q.yPlusX); // (Y1 + X1)(Y2 + X2)
+    FieldElement c = fieldMul(p.T, q.t2d); // 2d T1 T2, its sign flips to negate q
+    FieldElement d = fieldMul(p.Z, q.z2); // 2 Z1 Z2
+    FieldElement e = fieldSub(b, a), f = subtract ? fieldAdd(d, c) : fieldSub(d, c), g = subtract ? fieldSub(d, c) : fieldAdd(d, c), h = fieldAdd(b, a); // Terms of the sum
+    EdwardsPoint r; // Declare the sum
+    r.X = fieldMul(e, f); // X3 = EF
+    r.Y = fieldMul(g, h); // Y3 = GH
+    r.T = fieldMul(e, h); // T3 = EH
+    r.Z = fieldMul(f, g); // Z3 = FG
+    return r; // Return the sum
+}
+
+EdwardsPoint pointDouble(const EdwardsPoint& p) { // Function to double a point
+    FieldElement a = fieldSquare(p.X); // X1^2
+    FieldElement b = fieldSquare(p.Y); // Y1^2
+    FieldElement z = fieldSquare(p.Z); // Z1^2
+    FieldElement c = fieldAdd(z, z); // 2 Z1^2
+    FieldElement h = fieldAdd(a, b); // X1^2 + Y1^2
+    FieldElement e = fieldSub(h, fieldSquare(fieldAdd(p.X, p.Y))); // -2 X1 Y1, every term of the usual formulas is negated, which leaves their products the same
+    FieldElement g = fieldSub(a, b); // X1^2 - Y1^2
+    FieldElement f = fieldAdd(g, c); // G + 2 Z1^2
+    EdwardsPoint r; // Declare the double
+    r.X = fieldMul(e, f); // X3 = EF
+    r.Y = fieldMul(g, h); // Y3 = GH
+    r.T = fieldMul(e, h); // T3 = EH
+    r.Z = fieldMul(f, g); // Z3 = FG
+    return r; // Return the double
+}
+
+EdwardsPoint pointNegate(const EdwardsPoint& p) { // Function to negate a point, (x, y) becomes (-x, y)
+    EdwardsPoint r = p; // Copy the point
+    r.X = fieldNegate(p.X); // Negate X
+    r.T = fieldNegate(p.T); // Negate T
+    return r; // Return the negated point
+}
+
+bool pointIsIdentity(const EdwardsPoint& p) { // Function to check whether a point is the neutral point, X = 0 and Y = Z
+    return fieldIsZero(p.X) && fieldIsZero(fieldSub(p.Y, p.Z)); // Compare the coordinates
+}
+
+void pointEncode(const EdwardsPoint& p, unsigned char* bytes) { // Function to write a point as 32 bytes, y with the sign of x in the top bit
+    FieldElement zInverse = fieldInvert(p.Z); // 1/Z
+    FieldElement x = fieldMul(p.X, zInverse), y = fieldMul(p.Y, zInverse); // Affine coordinates
+    fieldToBytes(y, bytes); // Write y
+    bytes[31] |= fieldIsNegative(x) ? 0x80 : 0; // Write the sign of x
+}
+
+bool pointDecode(const unsigned char* bytes, EdwardsPoint& p) { // Function to read a point written by pointEncode, returns false if the bytes are not the one encoding of a curve point
+    FieldElement y = fieldFromBytes(bytes); // Read y
+    unsigned char canonical[32]; // Declare the encoding of y
+    fieldToBytes(y, canonical); // Encode y again
+    canonical[31] |= bytes[31] & 0x80; // With the sign bit given
+    if (memcmp(canonical, bytes, 32) != 0) { // If y was not below p
+        return false;
+    }
+    FieldElement y2 = fieldSquare(y); // y^2
+    FieldElement u = fieldSub(y2, FIELD_ONE); // u = y^2 - 1
+    FieldElement v = fieldAdd(fieldMul(y2, CURVE_D), FIELD_ONE); // v = d y^2 + 1
+    FieldElement v3 = fieldMul(fieldSquare(v), v); // v^3
+    FieldElement x = fieldMul(fieldMul(u, v3), fieldPow22523(fieldMul(u, fieldMul(fieldSquare(v3), v)))); // Candidate root x = u v^3 (u v^7)^((p - 5) / 8)
+    FieldElement check = fieldMul(v, fieldSquare(x)); // v x^2
+    if (!fieldIsZero(fieldSub(check, u))) { // If v x^2 is not u
+        if (!fieldIsZero(fieldAdd(check, u))) { // If it is not -u either, there is no square root
+            return false;
+        }
+        x = fieldMul(x, SQRT_MINUS_ONE); // Fix the root
+    }
+    bool negative = (bytes[31] & 0x80) != 0; // Sign asked for
+    if (negative && fieldIsZero(x)) { // -0 is not a valid encoding
+        return false;
+    }
+    if (fieldIsNegative(x) != negative) { // If the root has the wrong sign
+        x = fieldNegate(x); // Take the other root
+    }
+    p.X = x; // Set X
+    p.Y = y; // Set Y
+    p.Z = FIELD_ONE; // Set Z
+    p.T = fieldMul(x, y); // Set T
+    return true;
+}
+
+void scalarFromBytes(const unsigned char* bytes, uint64_t scalar[4]) { // Function to read a scalar from 32 little endian bytes
+    for (int i = 0; i < 4; i++) { // For loop over the limbs
+        scalar[i] = 0; // Reset the limb
+        for (int j = 7; j >= 0; j--) { // For loop over the bytes of the limb, most significant first
+            scalar[i] = (scalar[i] << 8) | bytes[i * 8 + j]; // Shift in the byte
+        }
+    }
+}
+
+void scalarToBytes(const uint64_t scalar[4], unsigned char* bytes) { // Function to write a scalar as 32 little endian bytes
+    for (int i = 0; i < 32; i++) { // For loop over the bytes
+        bytes[i] = static_cast<unsigned char>(scalar[i / 8] >> ((i % 8) * 8)); // Set the byte
+    }
+}
+
+bool scalarIsCanonical(const uint64_t scalar[4]) { // Function to check that a scalar is below L, a signature whose S is not would have a second valid form
+    for (int i = 3; i >= 0; i--) { // For loop over the limbs, most significant first
+        if (scalar[i] != GROUP_ORDER[i]) { // The first limb that differs decides
+            return scalar[i] < GROUP_ORDER[i]; // Below L if the limb is lower
+        }
+    }
+    return false; // Equal to L
+}
+
+void scalarReduce(const uint64_t wide[8], uint64_t scalar[4]) { // Function to reduce a 512 bit number modulo L, one bit at a time with no branch on the bits so a secret nonce takes the same time as any other
+    uint64_t r[4] = { (wide[4] >> 4) | (wide[5] << 60), (wide[5] >> 4) | (wide[6] << 60), (wide[6] >> 4) | (wide[7] << 60), wide[7] >> 4 }; // Start from the top 252 bits, which are already below L
+    for (int bit = 259; bit >= 0; bit--) { // For loop over the remaining bits, most significant first
+        r[3] = (r[3] << 1) | (r[2] >> 63); // Double the remainder
+        r[2] = (r[2] << 1) | (r[1] >> 63);
+        r[1] = (r[1] << 1) | (r[0] >> 63);
+        r[0] = (r[0] << 1) | ((wide[bit / 64] >> (bit % 64)) & 1); // And shift in the bit
+        uint64_t t[4], borrow = 0; // Declare the remainder minus L and the borrow
+        for (int i = 0; i < 4; i++) { // For loop to subtract L
+            uint128 difference = (uint128)r[i] - GROUP_ORDER[i] - borrow; // Subtract the limb
+            t[i] = static_cast<uint64_t>(difference); // Keep the low bits
+            borrow = static_cast<uint64_t>(difference >> 64) & 1; // Borrow from the next limb
+        }
+        uint64_t keep = borrow - 1; // All ones when the remainder reached L
+        for (int i = 0; i < 4; i++) { // For loop to pick the remainder
+            r[i] = (t[i] & keep) | (r[i] & ~keep); // Take the remainder minus L if it did not go below zero
+        }
+    }
+    memcpy(scalar, r, sizeof(r)); // Return the remainder
+}
+
+void scalarMulAccumulate(uint64_t wide[8], const uint64_t a[4], const uint64_t b[4]) { // Function to add the full 512 bit product of two scalars into a wide sum, reduced once at the end
+    for (int i = 0; i < 4; i++) { // For loop over the limbs of a
+        uint64_t carry = 0; // Carry into the next limb
+        for (int j = 0; j < 4; j++) { // For loop over the limbs of b
+            uint128 t = (uint128)a[i] * b[j] + wide[i + j] + carry; // Add the product of the limbs
+            wide[i + j] = static_cast<uint64_t>(t); // Keep the low bits
+            carry = static_cast<uint64_t>(t >> 64); // Carry the high bits
+        }
+        for (int k = i + 4; k < 8 && carry != 0; k++) { // For loop to carry into the higher limbs
+            uint128 t = (uint128)wide[k] + carry; // Add the carry
+            wide[k] = static_cast<uint64_t>(t); // Keep the low bits
+            carry = static_cast<uint64_t>(t >> 64); // Carry the high bit
+        }
+    }
+}
+
+void scalarFromHash(const string& digest, uint64_t scalar[4]) { // Function to turn a 64 byte SHA-512 hash into a scalar modulo L
+    uint64_t wide[8]; // Declare the hash as a 512 bit number
+    for (int i = 0; i < 8; i++) { // For loop over the limbs
+        wide[i] = 0; // Reset the limb
+        for (int j = 7; j >= 0; j--) { // For loop over the bytes of the limb, most significant first
+            wide[i] = (wide[i] << 8) | static_cast<unsigned char>(digest[i * 8 + j]); // Shift in the byte
+        }
+    }
+    scalarReduce(wide, scalar); // Reduce it
+}
+
+const CachedPoint (&basePointTable())[64][16] { // Function to get the multiples of the base point used by every fixed base multiplication, entry [i][j] is j * 16^i * B, built once on first use
+    static CachedPoint table[64][16]; // Declare the table
+    static once_flag built; // Flag to build the table once
+    call_once(built, [] { // Build the table on first use
+        unsigned char encoded[32]; // Encoding of the base point, y = 4/5 with x positive
+        encoded[0] = 0x58; // First byte
+        memset(encoded + 1, 0x66, 31); // Remaining bytes
+        EdwardsPoint base; // Declare 16^i * B
+        pointDecode(encoded, base); // Read the base point
+        for (int i = 0; i < 64; i++) { // For loop over the digit positions
+            EdwardsPoint multiple = POINT_IDENTITY; // j * 16^i * B
+            CachedPoint cachedBase = toCached(base); // 16^i * B in added form
+            for (int j = 0; j < 16; j++) { // For loop over the digits
+                table[i][j] = toCached(multiple); // Keep the multiple
+                multiple = pointAdd(multiple, cachedBase); // Move to the next multiple
+            }
+            for (int k = 0; k < 4; k++) { // For loop to move to the next digit position
+                base = pointDouble(base); // Double the base
+            }
+        }
+    });
+    return table; // Return the table
+}
+
+EdwardsPoint baseMultiply(const uint64_t scalar[4]) { // Function to multiply the base point by a scalar below 2^256, every table entry of a digit is read so secret scalars take the same time and touch the same memory
+    const CachedPoint (&table)[64][16] = basePointTable(); // Get the table
+    EdwardsPoint r = POINT_IDENTITY; // Declare the product
+    for (int i = 0; i < 64; i++) { // For loop over the four bit digits
+        uint64_t digit = (scalar[i / 16] >> ((i % 16) * 4)) & 15; // The digit
+        CachedPoint chosen = table[i][0]; // Declare the entry of the digit
+        for (uint64_t j = 1; j < 16; j++) { // For loop over the entries
+            uint64_t take = 0 - static_cast<uint64_t>(j == digit); // All ones for the entry of the digit
+            for (int k = 0; k < 5; k++) { // For loop over the limbs
+                chosen.yPlusX.v[k] ^= (chosen.yPlusX.v[k] ^ table[i][j].yPlusX.v[k]) & take; // Take Y + X
+                chosen.yMinusX.v[k] ^= (chosen.yMinusX.v[k] ^ table[i][j].yMinusX.v[k]) & take; // Take Y - X
+                chosen.z2.v[k] ^= (chosen.z2.v[k] ^ table[i][j].z2.v[k]) & take; // Take 2Z
+                chosen.t2d.v[k] ^= (chosen.t2d.v[k] ^ table[i][j].t2d.v[k]) & take; // Take 2dT
+            }
+        }
+        r = pointAdd(r, chosen); // Add the entry
+    }
+    return r; // Return the product
+}
+
+EdwardsPoint pointMultiply(const EdwardsPoint& p, const uint64_t scalar[4]) { // Function to multiply a public point by a public scalar, four bits at a time
+    CachedPoint multiples[16]; // Declare the multiples 0 to 15 of the point
+    EdwardsPoint multiple = POINT_IDENTITY; // Current multiple
+    CachedPoint cachedP = toCached(p); // The point in added form
+    for (int j = 0; j < 16; j++) { // For loop over the multiples
+        multiples[j] = toCached(multiple); // Keep the multiple
+        multiple = pointAdd(multiple, cachedP); // Move to the next multiple
+    }
+    EdwardsPoint r = POINT_IDENTITY; // Declare the product
+    for (int i = 63; i >= 0; i--) { // For loop over the four bit digits, most significant first
+        for (int k = 0; k < 4; k++) { // For loop to make room for the digit
+            r = pointDouble(r); // Double
+        }
+        uint64_t digit = (scalar[i / 16] >> ((i % 16) * 4)) & 15; // The digit
+        if (digit != 0) { // If the digit adds anything
+            r = pointAdd(r, multiples[digit]); // Add the multiple
+        }
+    }
+    return r; // Return the product
+}
+
+struct OperatorKey { // Signing key of an operator
+    string name; // Username of the operator
+    string seed; // 32 byte secret seed the key is derived from
+    uint64_t secretScalar[4]; // Secret scalar a, clamped from the first half of the hash of the seed
+    string prefix; // Second half of the hash of the seed, mixed into every nonce
+    string publicKey; // 32 byte public key A = aB
+};
+
+OperatorKey deriveOperatorKey(const string& seed) { // Function to expand a 32 byte seed into a signing key
+    OperatorKey key; // Declare the key
+    key.seed = seed; // Keep the seed
+    string digest = sha512(seed); // Hash the seed
+    unsigned char clamped[32]; // Declare the secret scalar bytes
+    memcpy(clamped, digest.data(), 32); // The first half of the hash
+    clamped[0] &= 248; // Clear the low three bits so the scalar is a multiple of the cofactor
+    clamped[31] &= 127; // Clear the top bit
+    clamped[31] |= 64; // And set the bit below it
+    scalarFromBytes(clamped, key.secretScalar); // Keep the scalar
+    key.prefix = digest.substr(32); // Keep the prefix
+    unsigned char publicBytes[32]; // Declare the public key
+    pointEncode(baseMultiply(key.secretScalar), publicBytes); // A = aB
+    key.publicKey.assign(reinterpret_cast<const char*>(publicBytes), 32); // Keep it
+    return key; // Return the key
+}
+
+string signMessage(const OperatorKey& key, const string& message) { // Function to sign a message, the signature is R followed by S
+    uint64_t r[4], k[4], wide[8] = { 0 }, s[4]; // Declare the nonce, the challenge, the wide sum and S
+    scalarFromHash(sha512(key.prefix + message), r); // The nonce r is derived from the key and message, so no random number is needed
+    unsigned char encodedR[32], encodedS[32]; // Declare the encodings of R and S
+    pointEncode(baseMultiply(r), encodedR); // R = rB
+    string rBytes(reinterpret_cast<const char*>(encodedR), 32); // R as a string
+    scalarFromHash(sha512(rBytes + key.publicKey + message), k); // Challenge k = H(R || A || M)
+    memcpy(wide, r, sizeof(r)); // Start the sum from r
+    scalarMulAccumulate(wide, k, key.secretScalar); // Add k a
+    scalarReduce(wide, s); // S = r + k a modulo L
+    scalarToBytes(s, encodedS); // Encode S
+    return rBytes + string(reinterpret_cast<const char*>(encodedS), 32); // Return R || S
+}
+
+struct SignatureCheck { // One signature to check
+    const string* publicKey; // 32 byte public key A
+    const string* message; // Message signed
+    const string* signature; // 64 byte signature R || S
+};
+
+struct DecodedSignature { // A signature read into the form its equation is checked in
+    EdwardsPoint a, r; // Public key A and commitment R
+    uint64_t s[4], k[4]; // S and the challenge k = H(R || A || M)
+};
+
+bool decodeSignature(const SignatureCheck& check, DecodedSignature& decoded, bool withKey = true) { // Function to read a signature and work out its challenge, returns false if any part is malformed, the public key is left out when the caller has read it already
+    if (check.publicKey->size() != SIGNATURE_KEY_BYTES || check.signature->size() != SIGNATURE_BYTES) { // If a part has the wrong length
+        return false;
+    }
+    const unsigned char* signature = reinterpret_cast<const unsigned char*>(check.signature->data()); // Bytes of the signature
+    scalarFromBytes(signature + 32, decoded.s); // Read S
+    if (!scalarIsCanonical(decoded.s) || (withKey && !pointDecode(reinterpret_cast<const unsigned char*>(check.publicKey->data()), decoded.a)) || !pointDecode(signature, decoded.r)) { // If S is not below L or A or R is not a point
+        return false;
+    }
+    scalarFromHash(sha512(check.signature->substr(0, 32) + *check.publicKey + *check.message), decoded.k); // k = H(R || A || M)
+    return true;
+}
+
+bool isSmallOrderMultiple(EdwardsPoint p) { // Function to check that eight times a point is the neutral point, the checks are multiplied by the cofactor 8 so one by one and batch checks always agree
+    for (int i = 0; i < 3; i++) { // For loop over the three doublings
+        p = pointDouble(p); // Double
+    }
+    return pointIsIdentity(p); // Check the result
+}
+
+bool verifySignature(const SignatureCheck& check) { // Function to check one signature on its own, 8(SB - kA - R) must be the neutral point
+    DecodedSignature decoded; // Declare the decoded signature
+    if (!decodeSignature(check, decoded)) { // If it is malformed
+        return false;
+    }
+    EdwardsPoint sum = pointAdd(baseMultiply(decoded.s), toCached(pointMultiply(decoded.a, decoded.k)), true); // SB - kA
+    sum = pointAdd(sum, toCached(decoded.r), true); // Minus R
+    return isSmallOrderMultiple(sum); // Check it vanishes
+}
+
+EdwardsPoint multiScalarMultiply(const vector<CachedPoint>& points, const vector<array<uint64_t, 4> >& scalars) { // Function to work out the sum of scalar times point over many points with the bucket method: every round takes a few bits of every scalar, drops each point into the bucket of its digit, and adds the buckets up weighted by digit, so each point costs one addition per round instead of a full multiplication
+    const int bucketCount = (1 << MSM_WINDOW_BITS) - 1; // Buckets for the digits 1 and up
+    vector<EdwardsPoint> buckets(bucketCount); // Declare the buckets
+    vector<char> used(bucketCount); // Flag for every bucket that holds a point
+    EdwardsPoint result = POINT_IDENTITY; // Declare the sum
+    int rounds = (253 + MSM_WINDOW_BITS - 1) / MSM_WINDOW_BITS; // Rounds to cover every bit of a scalar below L
+    for (int round = rounds - 1; round >= 0; round--) { // For loop over the rounds, most significant bits first
+        for (int k = 0; k < MSM_WINDOW_BITS; k++) { // For loop to make room for the digits of the round
+            result = pointDouble(result); // Double the sum
+        }
+        fill(used.begin(), used.end(), 0); // Empty the buckets
+        int shift = round * MSM_WINDOW_BITS; // Position of the digits
+        for (size_t i = 0; i < points.size(); ++i) { // For loop to sort the points into the buckets
+            uint64_t digit = scalars[i][shift / 64] >> (shift % 64); // Low bits of the digit
+            if (shift % 64 + MSM_WINDOW_BITS > 64 && shift / 64 < 3) { // If the digit runs into the next limb
+                digit |= scalars[i][shift / 64 + 1] << (64 - shift % 64); // Take the high bits from it
+            }
+            digit &= bucketCount; // Keep the bits of the digit
+            if (digit == 0) { // If the point adds nothing this round
+                continue;
+            }
+            if (used[digit - 1]) { // If the bucket holds points already
+                buckets[digit - 1] = pointAdd(buckets[digit - 1], points[i]); // Add the point
+            } else { // If the bucket is empty
+                buckets[digit - 1] = pointAdd(POINT_IDENTITY, points[i]); // Start it with the point
+                used[digit - 1] = 1; // Mark it used
+            }
+        }
+        EdwardsPoint running = POINT_IDENTITY, total = POINT_IDENTITY; // Declare the sum of the buckets from the top down and the weighted total
+        bool anyUsed = false; // Flag to indicate that a bucket above has points
+        for (int b = bucketCount - 1; b >= 0; b--) { // For loop over the buckets, highest digit first, bucket b ends up added b + 1 times
+            if (used[b]) { // If the bucket holds points
+                running = anyUsed ? pointAdd(running, toCached(buckets[b])) : buckets[b]; // Add it to the running sum
+                anyUsed = true; // Mark the running sum used
+            }
+            if (anyUsed) { // If the running sum holds points
+                total = pointAdd(total, toCached(running)); // Add the running sum to the total
+            }
+        }
+        result = pointAdd(result, toCached(total)); // Add the round into the sum
+    }
+    return result; // Return the sum
+}
+
+bool verifySignatureBatch(const vector<DecodedSignature>& batch, const vector<size_t>& keyOf, const vector<EdwardsPoint>& keyPoints) { // Function to check many decoded signatures with one equation: each is weighted by a random 128 bit z, and 8(sum(z S) B - sum(z k A) - sum(z R)) must vanish, which a bad signature only passes by chance of about 2^-125, signatures sharing a public key (keyOf into keyPoints) add their weights so the key is multiplied once
+    static thread_local mt19937_64 generator = [] { // Random weights, each thread seeded from the operating system
+        random_device device; // Source of the seed
+        seed_seq seeds{ device(), device(), device(), device(), device(), device(), device(), device() }; // Seed from 256 random bits
+        return mt19937_64(seeds); // Return the generator
+    }();
+    uint64_t sumS[8] = { 0 }; // Wide sum of z S
+    vector<array<uint64_t, 8> > keySums(keyPoints.size(), array<uint64_t, 8>()); // Wide sum of z k for every public key
+    vector<CachedPoint> points; // Declare the points of the sum
+    vector<array<uint64_t, 4> > scalars; // Declare their scalars
+    for (size_t i = 0; i < batch.size(); ++i) { // For loop over the signatures
+        uint64_t z[4] = { generator() | 1, generator(), 0, 0 }; // Random weight, odd so it is never 0
+        scalarMulAccumulate(sumS, z, batch[i].s); // Add z S
+        scalarMulAccumulate(keySums[keyOf[i]].data(), z, batch[i].k); // Add z k to its key
+        points.push_back(toCached(pointNegate(batch[i].r))); // -R
+        scalars.push_back(array<uint64_t, 4>{ { z[0], z[1], 0, 0 } }); // Weighted by z
+    }
+    for (size_t j = 0; j < keyPoints.size(); ++j) { // For loop to add every key once
+        array<uint64_t, 4> weight; // Declare the key's weight
+        scalarReduce(keySums[j].data(), weight.data()); // Reduce the sum of z k
+        points.push_back(toCached(pointNegate(keyPoints[j]))); // -A
+        scalars.push_back(weight); // Weighted by sum(z k)
+    }
+    uint64_t s[4]; // Declare sum(z S) modulo L
+    scalarReduce(sumS, s); // Reduce it
+    EdwardsPoint sum = pointAdd(baseMultiply(s), toCached(multiScalarMultiply(points, scalars))); // sum(z S) B - sum(z k A) - sum(z R)
+    return isSmallOrderMultiple(sum); // Check it vanishes
+}
+
+vector<char> verifySignatures(const vector<SignatureCheck>& checks) { // Function to check many signatures at once, batches of SIGNATURE_BATCH are checked together on every core and a batch that fails is checked one signature at a time to find the bad ones, returns 1 for every valid signature
+    vector<char> valid(checks.size(), 0); // Declare the results
+    size_t batchCount = (checks.size() + SIGNATURE_BATCH - 1) / SIGNATURE_BATCH; // Number of batches
+    forEachInParallel(batchCount, [&](size_t b) { // Check the batches on every core
+        size_t first = b * SIGNATURE_BATCH, last = min(checks.size(), first + SIGNATURE_BATCH); // Signatures of the batch
+        vector<DecodedSignature> batch; // Declare the well formed signatures
+        vector<size_t> members, keyOf; // Declare their positions and their keys
+        unordered_map<string, size_t> keys; // Index of every public key of the batch, a key is read once however many blocks its operator signed
+        vector<EdwardsPoint> keyPoints; // Declare the public keys read
+        vector<char> keyValid; // Flag for every public key that is a curve point
+        for (size_t i = first; i < last; ++i) { // For loop to decode the signatures
+            pair<unordered_map<string, size_t>::iterator, bool> key = keys.insert(make_pair(*checks[i].publicKey, keyPoints.size())); // Find or add the key
+            if (key.second) { // If the key is new to the batch
+                keyPoints.push_back(POINT_IDENTITY); // Make room for it
+                keyValid.push_back(checks[i].publicKey->size() == SIGNATURE_KEY_BYTES && pointDecode(reinterpret_cast<const unsigned char*>(checks[i].publicKey->data()), keyPoints.back()) ? 1 : 0); // Read it
+            }
+            DecodedSignature decoded; // Declare the decoded signature
+            if (!keyValid[key.first->second] || !decodeSignature(checks[i], decoded, false)) { // A malformed signature is invalid without any check
+                continue;
+            }
+            decoded.a = keyPoints[key.first->second]; // Set the key
+            batch.push_back(decoded); // Keep it
+            members.push_back(i); // Remember its position
+            keyOf.push_back(key.first->second); // Remember its key
+        }
+        if (!batch.empty() && verifySignatureBatch(batch, keyOf, keyPoints)) { // If every signature of the batch holds
+            for (size_t j = 0; j < members.size(); ++j) { // For loop over the members
+                valid[members[j]] = 1; // Mark it valid
+            }
+            return;
+        }
+        for (size_t j = 0; j < members.size(); ++j) { // For loop to find the bad signatures one by one
+            valid[members[j]] = verifySignature(checks[members[j]]) ? 1 : 0; // Check the signature
+        }
+    }, 1);
+    return valid; // Return the results
+}
+
+bool reportSelfCheck(const string& name, bool passed) { // Function to print the result of one self-check, returns whether it passed
+    cout << (passed ? "ok      " : "FAILED  ") << name << endl; // Print the result
+    return passed;
+}
+
+bool runCryptoSelfTest() { // Function to check the hashing and signature code against published test vectors, and the batch verifier against checking one by one, returns true if every check passed
+    bool passed = reportSelfCheck("SHA-512 of \"abc\"", toHex(sha512("abc")) == "ddaf35a193617abacc417349ae20413112e6fa4e89a97ea20a9eeee64b55d39a2192992a274fc1a836ba3c23a3feebbd454d4423643ce80e2a9ac94fa54ca49f"); // FIPS 180-2 example
+
+    const char* const vectors[3][4] = { // RFC 8032 section 7.1 tests 1 to 3: secret key, public key, message and signature
+        { "9d61b19deffd5a60ba844af492ec2cc44449c5697b326919703bac031cae7f60", "d75a980182b10ab7d54bfed3c964073a0ee172f3daa62325af021a68f707511a", "",
+          "e5564300c360ac729086e2cc806e828a84877f1eb8e5d974d873e065224901555fb8821590a33bacc61e39701cf9b46bd25bf5f0595bbe24655141438e7a100b" },
+        { "4ccd089b28ff96da9db6c346ec114e0f5b8a319f35aba624da8cf6ed4fb8a6fb", "3d4017c3e843895a92b70aa74d1b7ebc9c982ccf2ec4968cc0cd55f12af4660c", "72",
+          "92a009a9f0d4cab8720e820b5f642540a2b27b5416503f8fb3762223ebdb69da085ac1e43e15996e458f3613d0f11d8c387b2eaeb4302aeeb00d291612bb0c00" },
+        { "c5aa8df43f9f837bedb7442f31dcb7b166d38535076f094b85ce3a2e0b4458f7", "fc51cd8e6218a1a38da47ed00230f0580816ed13ba3303ac5deb911548908025", "af82",
+          "6291d657deec24024827e69c3abe01a30ce548a284743a445e3680d7db5ac3ac18ff9b538d16f290ae67f760984dc6594a7c15e9716ed28dc027beceea1ec40a" }
+    };
+    string firstKey, firstMessage, firstSignature; // Test 1, reused for the non-canonical S check
+    for (int i = 0; i < 3; i++) { // For loop over the test vectors
+        string seed, message, signature; // Declare the secret key, the message and the signature
+        fromHex(vectors[i][0], seed); // Read the secret key
+        fromHex(vectors[i][2], message); // Read the message
+        fromHex(vectors[i][3], signature); // Read the signature
+        OperatorKey key = deriveOperatorKey(seed); // Expand the secret key
+        string name = "RFC 8032 test " + to_string(i + 1); // Name of the test
+        passed &= reportSelfCheck(name + " public key", toHex(key.publicKey) == vectors[i][1]); // The public key must match
+        passed &= reportSelfCheck(name + " signature", signMessage(key, message) == signature); // Signing is deterministic, so the signature must match
+        passed &= reportSelfCheck(name + " verifies", verifySignature(SignatureCheck{ &key.publicKey, &message, &signature })); // And it must verify
+        if (i == 0) { // Keep test 1
+            firstKey = key.publicKey;
+            firstMessage = message;
+            firstSignature = signature;
+        }
+    }
+
+    string nonCanonical = firstSignature; // Test 1 with S + L in place of S, the same point equation holds but the encoding is not the one allowed
+    uint64_t s[4]; // Declare S
+    scalarFromBytes(reinterpret_cast<const unsigned char*>(nonCanonical.data()) + 32, s); // Read S
+    unsigned __int128 carry = 0; // Carry of the addition
+    for (int i = 0; i < 4; i++) { // For loop to add L
+        carry += static_cast<unsigned __int128>(s[i]) + GROUP_ORDER[i]; // Add the limbs
+        s[i] = static_cast<uint64_t>(carry); // Keep the low limb
+        carry >>= 64; // Carry the rest
+    }
+    unsigned char encodedS[32]; // Declare the new S
+    scalarToBytes(s, encodedS); // Encode it, S + L still fits in 32 bytes
+    nonCanonical.replace(32, 32, reinterpret_cast<const char*>(encodedS), 32); // Put it in the signature
+    passed &= reportSelfCheck("non-canonical S rejected one by one", !verifySignature(SignatureCheck{ &firstKey, &firstMessage, &nonCanonical })); // Checked on its own
+    passed &= reportSelfCheck("non-canonical S rejected in a batch", verifySignatures(vector<SignatureCheck>(1, SignatureCheck{ &firstKey, &firstMessage, &nonCanonical }))[0] == 0); // Checked by the batch path
+
+    size_t count = 2 * SIGNATURE_BATCH + 37; // Signatures in the batch check, enough for several batches and a partial one
+    vector<OperatorKey> keys; // Declare a few keys, so batches have keys signing more than once
+    for (int i = 0; i < 5; i++) { // For loop to make the keys
+        keys.push_back(deriveOperatorKey(sha512("self-test key " + to_string(i)).substr(0, SIGNATURE_KEY_BYTES))); // Make a key from a fixed seed
+    }
+    vector<string> messages(count), signatures(count); // Declare the messages and the signatures
+    vector<SignatureCheck> checks; // Declare the checks
+    size_t broken = 0; // Signatures broken on purpose
+    for (size_t i = 0; i < count; ++i) { // For loop to sign the messages
+        const string* publicKey = &keys[i % keys.size()].publicKey; // Key of the signature
+        messages[i] = "self-test message " + to_string(i); // The message
+        signatures[i] = signMessage(keys[i % keys.size()], messages[i]); // Sign it
+        if (i % 97 == 5) { // Break a few signatures spread over the batches
+            messages[i] += "!"; // The message no longer matches
+            broken++;
+        } else if (i == SIGNATURE_BATCH + 11) { // And one with the wrong length
+            signatures[i].resize(SIGNATURE_BYTES - 1);
+            broken++;
+        } else if (i == count - 1) { // And the non-canonical S in the last, partial batch
+            publicKey = &firstKey;
+            messages[i] = firstMessage;
+            signatures[i] = nonCanonical;
+            broken++;
+        }
+        checks.push_back(SignatureCheck{ publicKey, &messages[i], &signatures[i] }); // Check it
+    }
+    vector<char> batchResults = verifySignatures(checks); // Check them in batches
+    bool agree = true; // Flag to indicate that the batch results match checking one by one
+    size_t rejected = 0; // Signatures rejected
+    for (size_t i = 0; i < count; ++i) { // For loop to compare every result
+        agree = agree && (batchResults[i] != 0) == verifySignature(checks[i]); // Compare with checking it on its own
+        rejected += batchResults[i] == 0 ? 1 : 0; // Count the rejections
+    }
+    passed &= reportSelfCheck("batch and single checks agree on " + to_string(count) + " signatures", agree); // Every result must match
+    passed &= reportSelfCheck("batch rejects exactly the bad signatures", rejected == broken); // Those broken above
+
+    vector<DecodedSignature> batch; // Declare a batch of valid signatures, checked with the batch equation alone
+    vector<size_t> keyOf; // Declare the key of each
+    vector<EdwardsPoint> keyPoints; // Declare the keys
+    for (size_t i = 0; batch.size() < 64 && i < count; ++i) { // For loop to collect valid signatures
+        DecodedSignature decoded; // Declare the decoded signature
+        if (batchResults[i] && decodeSignature(checks[i], decoded)) { // If it is valid
+            keyOf.push_back(keyPoints.size()); // Its key
+            keyPoints.push_back(decoded.a);
+            batch.push_back(decoded);
+        }
+    }
+    passed &= reportSelfCheck("batch equation accepts valid signatures", verifySignatureBatch(batch, keyOf, keyPoints)); // The whole batch holds
+    batch[batch.size() / 2].s[0] ^= 1; // Change S of one signature
+    passed &= reportSelfCheck("batch equation rejects one bad signature", !verifySignatureBatch(batch, keyOf, keyPoints)); // One bad signature fails the batch
+    return passed; // Return whether every check passed
+}
+
+const string OPERATOR_REGISTRY = "operator_keys.txt"; // File with the public key of every operator, a line per operator with the username and the key in hexadecimal, every process serving the chain needs the same file
+
+class OperatorRegistry { // Public key registered for each operator, a signed block is only accepted if the key it names is the key registered for its signer, so nobody can sign blocks in another operator's name with a key of their own
+private: // Private members
+    unordered_map<string, string> keys; // Keys by username
+    bool loaded; // Flag to indicate that the file has been read
+    time_t loadedTime; // Modification time of the file when it was read
+    off_t loadedSize; // Size of the file when it was read
+    mutex registryMutex; // Protects the members above, blocks are checked on many threads
+
+    void load() { // Read the file again if it has changed since it was last read, such as when another process registered an operator
+        struct stat info; // Declare the file's details
+        bool exists = stat(OPERATOR_REGISTRY.c_str(), &info) == 0; // Get them
+        time_t modified = exists ? info.st_mtime : 0; // Modification time
+        off_t size = exists ? info.st_size : 0; // Size
+        if (loaded && modified == loadedTime && size == loadedSize) { // If the file has not changed
+            return;
+        }
+        keys.clear(); // Forget the keys read before
+        ifstream file(OPERATOR_REGISTRY); // Open the registry, a missing file registers nobody
+        string line; // Declare a string to store each line of the file
+        while (getline(file, line)) { // While loop to read each line of the file
+            stringstream ss(line); // Create a string stream with the line
+            string name, hex, key; // Declare the username, the key as written and the key
+            if (ss >> name >> hex && fromHex(hex, key) && key.size() == SIGNATURE_KEY_BYTES && keys.find(name) == keys.end()) { // If the line holds a username and a whole key, the first key registered for an operator is kept
+                keys[name] = key; // Register the key
+            }
+        }
+        loaded = true; // The file has been read
+        loadedTime = modified; // Remember its modification time
+        loadedSize = size; // Remember its size
+    }
+
+public: // Public members
+    OperatorRegistry() { // Constructor for OperatorRegistry, the file is read when a key is first looked up
+        loaded = false; // Not read yet
+        loadedTime = 0; // No modification time yet
+        loadedSize = 0; // No size yet
+    }
+
+    bool isRegistered(const string& name, const string& key) { // Method to check that the key passed in is the key registered for the operator
+        lock_guard<mutex> lock(registryMutex); // Lock the registry
+        unordered_map<string, string>::const_iterator registered = keys.find(name); // Key registered for the operator
+        if (!loaded || registered == keys.end()) { // If the operator is not known yet, the file may have gained it since it was read
+            load(); // Read the file if it changed
+            registered = keys.find(name); // Look again
+        }
+        return registered != keys.end() && registered->second == key; // Registered if the keys match
+    }
+
+    bool registerKey(const string& name, const string& key) { // Method to register the key of an operator who has none, returns false if another key is already registered for the operator
+        lock_guard<mutex> lock(registryMutex); // Lock the registry
+        load(); // Read the file if it changed
+        unordered_map<string, string>::const_iterator registered = keys.find(name); // Key registered for the operator
+        if (registered != keys.end()) { // If the operator already has a key
+            return registered->second == key; // Registered only if it is this key
+        }
+        ofstream file(OPERATOR_REGISTRY, ios::app); // Open the registry
+        file << name << " " << toHex(key) << endl; // Register the key
+        keys[name] = key; // Remember it
+        return true;
+    }
+};
+
+OperatorRegistry operatorRegistry; // Keys registered for the operators, shared by every chain of the process
+
+string blockSigningMessage(const Block& block) { // Function to get the bytes a block's signature is taken over, its body, which names the signer and their key, followed by its hash, which covers the nonce of a sealed block
+    return blockHeader(block) + block.currentHashNumber; // Return the body and the hash
+}
+
+bool isSignedBlock(const Block& block) { // Function to check whether a block claims to be signed, a block that names a signer, a key or a signature must carry a valid signature
+    return !block.signer.empty() || !block.signerKey.empty() || !block.signature.empty();
+}
+
+vector<char> verifyBlockSignatures(const vector<const Block*>& blocks) { // Function to check the signatures of many blocks at once, returns 1 for every block that is unsigned or validly signed with the key registered for its signer
+    vector<char> valid(blocks.size(), 1); // Declare the results, unsigned blocks pass
+    vector<string> messages; // Declare the bytes signed by every signed block
+    vector<size_t> positions; // Declare the position of every signed block
+    messages.reserve(blocks.size()); // The checks point into the messages, so they must not move
+    for (size_t i = 0; i < blocks.size(); ++i) { // For loop to collect the signed blocks
+        if (isSignedBlock(*blocks[i])) { // If the block claims a signer
+            if (!operatorRegistry.isRegistered(blocks[i]->signer, blocks[i]->signerKey)) { // If the key it names is not the signer's registered key
+                valid[i] = 0; // The block was signed in someone else's name, or by an unknown operator
+                continue;
+            }
+            messages.push_back(blockSigningMessage(*blocks[i])); // Keep the bytes it signed
+            positions.push_back(i); // Remember its position
+        }
+    }
+    vector<SignatureCheck> checks; // Declare the signatures to check
+    for (size_t j = 0; j < positions.size(); ++j) { // For loop over the signed blocks
+        checks.push_back(SignatureCheck{ &blocks[positions[j]]->signerKey, &messages[j], &blocks[positions[j]]->signature }); // Check the block's signature with the key it names
+    }
+    vector<char> checked = verifySignatures(checks); // Check them in batches on every core
+    for (size_t j = 0; j < positions.size(); ++j) { // For loop to copy the results
+        valid[positions[j]] = checked[j]; // Set the result of the block
+    }
+    return valid; // Return the results
+}
+
+const string LOCATION_NEXT_ID = "# Next ID: "; // Start of the line of the valid locations file that holds the first ID never given out
+const size_t LOCATION_SUGGESTIONS = 10; // Most locations listed when an operator asks for the locations starting with a prefix
+
+string normalizeLocation(const string& location) { // Function to bring a location to the form it is matched in, lowercase with single spaces and ", " between its parts, so "Austin,TX" matches "austin, tx"
+    string normalized; // Declare the normalized location
+    bool pendingSpace = false; // Flag to indicate that spaces were skipped since the last character
+    for (size_t i = 0; i < location.size(); ++i) { // For loop over the characters
+        unsigned char character = static_cast<unsigned char>(location[i]); // The character
+        if (isspace(character)) { // Spaces are collapsed
+            pendingSpace = !normalized.empty(); // Spaces at the start are dropped
+        } else if (character == ',') { // Commas always have no space before and one space after
+            normalized += ", ";
+            pendingSpace = false;
+        } else { // Ordinary character
+            if (pendingSpace && normalized[normalized.size() - 1] != ' ') { // If spaces separated it from the last word
+                normalized += ' ';
+            }
+            normalized += static_cast<char>(tolower(character)); // Add the character in lowercase
+            pendingSpace = false;
+        }
+    }
+    while (!normalized.empty() && normalized[normalized.size() - 1] == ' ') { // Drop the space left by a trailing comma
+        normalized.erase(normalized.size() - 1);
+    }
+    return normalized; // Return the normalized location
+}
+
+class LocationDictionary { // Dictionary of valid locations stored as a minimal acyclic automaton (an FST whose outputs are ranks), shared prefixes and suffixes such as ", Johor" are stored once, and each rank is mapped to the location's ID, which is kept in the file so adding or removing a location does not change the IDs stored in blocks
+private: // Private members
+    vector<uint32_t> firstTransition; // Position of each state's first transition
+    vector<uint16_t> transitionCount; // Number of transitions of each state, at most one per byte value
+    vector<uint32_t> wordCount; // Number of locations reachable from each state, used to work out ranks
+    vector<bool> accepting; // Flag for each state that ends a location
+    vector<unsigned char> labels; // Character of each transition, the transitions of a state are sorted by character
+    vector<uint32_t> targets; // State each transition leads to
+    string displayNames; // Location names as written in the file, in rank order, used when a location is shown or stored
+    vector<uint32_t> displayOffsets; // Start of each name in displayNames, with the end of the last one at the back
+    vector<uint32_t> rankIds; // ID of each location, in rank order
+    unordered_map<uint32_t, uint32_t> idRanks; // Rank of each ID, IDs of locations removed from the file are not in it
+
+    struct BuildState { // State of the automaton while it is being built
+        bool accepting; // Flag to indicate that the state ends a location
+        vector<pair<unsigned char, uint32_t> > transitions; // Transitions of the state, in character order
+    };
+
+    static string signature(const BuildState& state) { // Function to describe a state by its transitions, two states with the same signature accept the same endings and are merged
+        string text(1, state.accepting ? '1' : '0'); // Start with the accepting flag
+        for (size_t i = 0; i < state.transitions.size(); ++i) { // For loop over the transitions
+            text += static_cast<char>(state.transitions[i].first); // Add the character
+            appendUint32(text, state.transitions[i].second); // Add the target
+        }
+        return text; // Return the signature
+    }
+
+    static uint32_t registerState(vector<BuildState>& states, unordered_map<string, uint32_t>& registry, uint32_t state) { // Function to merge a finished state and everything below it with an equal state already registered, returns the state to link to
+        BuildState& current = states[state]; // The state
+        if (!current.transitions.empty()) { // If the state has children, the last child is the only one that can still be unregistered
+            current.transitions.back().second = registerState(states, registry, current.transitions.back().second); // Register the last child first
+        }
+        string key = signature(states[state]); // Describe the state
+        unordered_map<string, uint32_t>::iterator found = registry.find(key); // Look for an equal state
+        if (found != registry.end()) { // If one exists
+            return found->second; // Use it, this state is left unused
+        }
+        registry[key] = state; // Register the state
+        return state;
+    }
+
+public: // Public members
+    LocationDictionary() { // Constructor for LocationDictionary, starts empty
+    }
+
+    struct Entry { // Location read from the file
+        string normalized; // Form the location is matched in
+        string name; // Name as written in the file
+        uint32_t id; // ID of the location
+    };
+
+    bool loadFromFile(const string& filename) { // Load and compile the locations listed one per line in a file, each followed by a tab and its ID, locations added without an ID are given the next unused one and the file is saved with it, returns false if the file could not be opened
+        ifstream file(filename); // Open the file
+        if (!file.is_open()) { // If the file could not be opened
+            return false;
+        }
+        vector<Entry> entries; // Locations of the file, in line order
+        vector<string> lines; // Lines of the file, rewritten when IDs are given out
+        vector<pair<size_t, size_t> > unnumbered; // Entries that have no ID yet and their lines
+        uint32_t nextId = 0; // First ID never given out, kept in the file so the ID of a removed location is not reused
+        string line; // Declare the line
+        while (getline(file, line)) { // While loop to read the file line by line
+            if (!line.empty() && line[line.size() - 1] == '\r') { // Ignore Windows line endings
+                line.erase(line.size() - 1);
+            }
+            lines.push_back(line); // Keep the line
+            if (line.compare(0, LOCATION_NEXT_ID.size(), LOCATION_NEXT_ID) == 0) { // If this is the line with the next ID
+                nextId = max(nextId, static_cast<uint32_t>(strtoul(line.c_str() + LOCATION_NEXT_ID.size(), nullptr, 10)));
+                lines.pop_back(); // It is written again at the top
+                continue;
+            }
+            Entry entry; // Declare the location
+            entry.id = UINT32_MAX; // No ID yet
+            size_t tab = line.rfind('\t'); // The ID follows the last tab
+            if (tab != string::npos && tab + 1 < line.size() && line.find_first_not_of("0123456789", tab + 1) == string::npos && line.size() - tab - 1 < 10) { // If the line has an ID
+                entry.id = static_cast<uint32_t>(stoul(line.substr(tab + 1))); // Read the ID
+                nextId = max(nextId, entry.id + 1); // IDs below it are taken
+                entry.name = line.substr(0, tab); // The name comes before it
+            } else { // A location added without an ID
+                entry.name = line;
+            }
+            entry.normalized = normalizeLocation(entry.name); // Normalize the location
+            if (entry.normalized.empty()) { // Skip blank lines
+                continue;
+            }
+            if (entry.id == UINT32_MAX) { // If the location needs an ID
+                unnumbered.push_back(make_pair(entries.size(), lines.size() - 1));
+            }
+            entries.push_back(entry); // Add the location
+        }
+        file.close(); // Close the file before it is rewritten
+        if (!unnumbered.empty()) { // If locations were added without an ID
+            for (size_t i = 0; i < unnumbered.size(); ++i) { // For loop to number them in line order
+                Entry& entry = entries[unnumbered[i].first]; // The location
+                entry.id = nextId++; // Give it the next ID
+                lines[unnumbered[i].second] += "\t" + to_string(entry.id); // Write the ID after the name
+            }
+            string temporary = filename + ".tmp"; // Write a new file and rename it over the old one, so a crash leaves one of them whole
+            ofstream output(temporary); // Open the new file
+            output << LOCATION_NEXT_ID << nextId << "\n"; // Write the next ID
+            for (size_t i = 0; i < lines.size(); ++i) { // For loop over the lines
+                output << lines[i] << "\n"; // Write the line
+            }
+            output.close(); // Close the file
+            if (!output || rename(temporary.c_str(), filename.c_str()) != 0) { // If the new file could not be written
+                cout << "Warning: The IDs given to new locations could not be saved to " << filename << ", they may change the next time it is loaded." << endl; // Tell the user, blocks stored with them could then name another location
+            }
+        }
+        build(entries); // Compile the locations
+        return true;
+    }
+
+    void build(vector<Entry>& entries) { // Compile normalized locations, their names and IDs into the automaton, entries is sorted and duplicates keep the first name and ID
+        stable_sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.normalized < b.normalized; }); // Sort by normalized form, byte order matches the transition order
+        vector<BuildState> states(1); // States being built, state 0 is the start
+        states[0].accepting = false; // The empty location is not valid
+        unordered_map<string, uint32_t> registry; // Finished states by signature
+        displayNames.clear(); // Forget earlier names
+        displayOffsets.clear();
+        rankIds.clear(); // Forget earlier IDs
+        idRanks.clear();
+        string previous; // Previous location added
+        for (size_t i = 0; i < entries.size(); ++i) { // For loop over the sorted locations
+            const string& word = entries[i].normalized; // The normalized location
+            if (i > 0 && word == previous) { // Skip duplicates
+                continue;
+            }
+            size_t common = 0; // Length of the prefix shared with the previous location
+            uint32_t state = 0; // State at the end of the shared prefix
+            while (common < word.size() && common < previous.size() && word[common] == previous[common]) { // Follow the shared prefix, it always uses the last transition of each state
+                state = states[state].transitions.back().second; // Follow it
+                common++;
+            }
+            if (!states[state].transitions.empty()) { // The branch of the previous location below the prefix is finished
+                states[state].transitions.back().second = registerState(states, registry, states[state].transitions.back().second); // Merge it with equal branches
+            }
+            for (size_t j = common; j < word.size(); ++j) { // For loop to add the rest of the location
+                BuildState next; // Declare the new state
+                next.accepting = false; // It ends no location yet
+                states.push_back(next); // Add it
+                states[state].transitions.push_back(make_pair(static_cast<unsigned char>(word[j]), static_cast<uint32_t>(states.size() - 1))); // Link it
+                state = static_cast<uint32_t>(states.size() - 1); // Move to it
+            }
+            states[state].accepting = true; // The location ends here
+            displayOffsets.push_back(static_cast<uint32_t>(displayNames.size())); // Remember where its name starts
+            displayNames += entries[i].name; // Keep the name as written in the file
+            if (idRanks.count(entries[i].id) == 0) { // An ID given to two locations stays with the first one
+                idRanks[entries[i].id] = static_cast<uint32_t>(rankIds.size()); // Map the ID to the rank
+            }
+            rankIds.push_back(entries[i].id); // Map the rank to the ID
+            previous = word; // Remember the location
+        }
+        if (!states[0].transitions.empty()) { // Finish the last branch
+            states[0].transitions.back().second = registerState(states, registry, states[0].transitions.back().second);
+        }
+        displayOffsets.push_back(static_cast<uint32_t>(displayNames.size())); // End of the last name
+
+        vector<uint32_t> compact(states.size(), UINT32_MAX); // New number of each state that is still used
+        vector<uint32_t> order; // Used states, numbered in the order they are reached
+        compact[0] = 0; // The start state keeps number 0
+        order.push_back(0);
+        for (size_t i = 0; i < order.size(); ++i) { // For loop to number every reachable state, merged away states are never reached
+            const BuildState& state = states[order[i]]; // The state
+            for (size_t j = 0; j < state.transitions.size(); ++j) { // For loop over its transitions
+                if (compact[state.transitions[j].second] == UINT32_MAX) { // If the target has no number yet
+                    compact[state.transitions[j].second] = static_cast<uint32_t>(order.size()); // Number it
+                    order.push_back(state.transitions[j].second);
+                }
+            }
+        }
+        firstTransition.assign(order.size(), 0); // Lay the states out in flat arrays
+        transitionCount.assign(order.size(), 0);
+        accepting.assign(order.size(), false);
+        labels.clear();
+        targets.clear();
+        for (size_t i = 0; i < order.size(); ++i) { // For loop over the used states
+            const BuildState& state = states[order[i]]; // The state
+            firstTransition[i] = static_cast<uint32_t>(labels.size()); // Its transitions start here
+            transitionCount[i] = static_cast<uint16_t>(state.transitions.size()); // Copy the number of transitions
+            accepting[i] = state.accepting; // Copy the accepting flag
+            for (size_t j = 0; j < state.transitions.size(); ++j) { // For loop over its transitions
+                labels.push_back(state.transitions[j].first); // Copy the character
+                targets.push_back(compact[state.transitions[j].second]); // Copy the new number of the target
+            }
+        }
+        wordCount.assign(order.size(), 0); // Count the locations below each state, merged states can be reached from several parents so the counts are filled children first
+        vector<uint32_t> postOrder; // States with every child before its parent
+        vector<pair<uint32_t, uint32_t> > stack(1, make_pair(0u, 0u)); // Depth first stack of state and next transition
+        vector<bool> visited(order.size(), false); // Flag for each state already placed
+        visited[0] = true;
+        while (!stack.empty()) { // Depth first walk
+            uint32_t state = stack.back().first; // State on top
+            if (stack.back().second < transitionCount[state]) { // If it has a child left
+                uint32_t child = targets[firstTransition[state] + stack.back().second++]; // Take the child
+                if (!visited[child]) { // If the child was not placed yet
+                    visited[child] = true;
+                    stack.push_back(make_pair(child, 0u)); // Visit it
+                }
+            } else { // Every child was placed
+                postOrder.push_back(state); // Place the state
+                stack.pop_back();
+            }
+        }
+        for (size_t i = 0; i < postOrder.size(); ++i) { // For loop over the states, children first
+            uint32_t state = postOrder[i]; // The state
+            uint32_t count = accepting[state] ? 1 : 0; // The state itself may end a location
+            for (uint32_t j = 0; j < transitionCount[state]; j++) { // For loop over its transitions
+                count += wordCount[targets[firstTransition[state] + j]]; // Add the locations below the child
+            }
+            wordCount[state] = count; // Save the count
+        }
+    }
+
+    size_t size() const { // Method to get the number of locations
+        return displayOffsets.empty() ? 0 : displayOffsets.size() - 1;
+    }
+
+    size_t stateCount() const { // Method to get the number of states of the automaton, shown to tell how compact it is
+        return firstTransition.size();
+    }
+
+    int findId(const string& location) const { // Function to find the ID of a location after normalizing it, returns -1 if the location is not valid
+        if (firstTransition.empty()) { // If the dictionary is empty
+            return -1;
+        }
+        string normalized = normalizeLocation(location); // Normalize the location
+        uint32_t state = 0; // Start at the first state
+        uint32_t rank = 0; // Locations that sort before the path so far
+        for (size_t i = 0; i < normalized.size(); ++i) { // For loop over the characters
+            if (accepting[state]) { // A location ending here sorts before every longer one
+                rank++;
+            }
+            unsigned char label = static_cast<unsigned char>(normalized[i]); // The character
+            uint32_t first = firstTransition[state]; // First transition of the state
+            uint32_t next = UINT32_MAX; // State the character leads to
+            for (uint32_t j = 0; j < transitionCount[state] && labels[first + j] <= label; j++) { // For loop over the transitions up to the character
+                if (labels[first + j] == label) { // If this is the character
+                    next = targets[first + j];
+                } else { // A smaller character
+                    rank += wordCount[targets[first + j]]; // Its locations sort before this one
+                }
+            }
+            if (next == UINT32_MAX) { // If no location continues with the character
+                return -1;
+            }
+            state = next; // Move on
+        }
+        return accepting[state] ? static_cast<int>(rankIds[rank]) : -1; // Return the ID of the location ending here
+    }
+
+    string name(int id) const { // Function to get the name of a location by its ID, as written in the file, empty if no location has the ID
+        unordered_map<uint32_t, uint32_t>::const_iterator found = idRanks.find(static_cast<uint32_t>(id)); // Find the rank of the ID
+        if (found == idRanks.end()) { // If the location was removed from the file
+            return "";
+        }
+        uint32_t rank = found->second; // The rank
+        return displayNames.substr(displayOffsets[rank], displayOffsets[rank + 1] - displayOffsets[rank]); // Return the name
+    }
+
+    vector<int> complete(const string& prefix, size_t limit) const { // Function to find the IDs of up to limit locations starting with a prefix, in sorted order
+        vector<int> ids; // Declare the IDs
+        if (firstTransition.empty()) { // If the dictionary is empty
+            return ids;
+        }
+        string normalized = normalizeLocation(prefix); // Normalize the prefix
+        if (!prefix.empty() && isspace(static_cast<unsigned char>(prefix[prefix.size() - 1])) && !normalized.empty() && normalized[normalized.size() - 1] != ' ') { // A trailing space is part of the prefix, so "Kuala " does not complete to "Kualalumpur"
+            normalized += ' ';
+        }
+        uint32_t state = 0; // Start at the first state
+        uint32_t rank = 0; // Locations that sort before the prefix
+        for (size_t i = 0; i < normalized.size(); ++i) { // For loop to follow the prefix
+            if (accepting[state]) { // A location ending here sorts first
+                rank++;
+            }
+            unsigned char label = static_cast<unsigned char>(normalized[i]); // The character
+            uint32_t first = firstTransition[state]; // First transition of the state
+            uint32_t next = UINT32_MAX; // State the character leads to
+            for (uint32_t j = 0; j < transitionCount[state] && labels[first + j] <= label; j++) { // For loop over the transitions up to the character
+                if (labels[first + j] == label) { // If this is the character
+                    next = targets[first + j];
+                } else { // A smaller character
+                    rank += wordCount[targets[first + j]];
+                }
+            }
+            if (next == UINT32_MAX) { // If no location starts with the prefix
+                return ids;
+            }
+            state = next; // Move on
+        }
+        for (uint32_t i = 0; i < wordCount[state] && ids.size() < limit; i++) { // The locations starting with the prefix have consecutive ranks
+            ids.push_back(static_cast<int>(rankIds[rank + i])); // Add the ID
+        }
+        return ids; // Return the IDs
+    }
+};
+
+class Blockchain { // Blockchain class
+private: // Private members
+    BlockNode* head; // Pointer to the head of the blockchain
+    int currentBlockNumber; // Current block number
+    string hashNumber; // Hash number
+
+    bool procurementAdded; // Procurement information added flag
+    bool inventoryAdded; // Inventory information added flag
+    bool orderFulfillmentAdded; // Order fulfillment information added flag
+    bool transportationAdded; // Transportation information added flag
+    bool customerDeliverySatisfactionAdded; // Customer delivery satisfaction information added flag
+    bool qualityControlAdded; // Quality control information added flag
+    bool productReturn; // Product return information added flag
+    bool productWorthiness; // Product worthiness information added flag
+
+    PersistenceWriter* persistence; // Writer that persists every appended block, nullptr when blocks are not persisted
+    vector<BloomFilter> segmentFilters; // Filter over the IDs of each segment of SEGMENT_BLOCKS blocks, used to skip segments that cannot hold an ID
+    unordered_map<string, ShipmentLifecycle> lifecycleView; // Latest block of each stage for every shipment, kept up to date as blocks are appended
+    bool lifecycleViewValid; // Flag to indicate that the lifecycle view matches the chain, it is rebuilt on the next lookup when false
+    int proofOfWorkDifficulty; // Leading zero bits new blocks are sealed with, 0 when proof of work is off
+    int requiredDifficulty; // Leading zero bits every block after the first must be sealed with, set from the difficulty of the first block, which is signed with it, so a block claiming a lower difficulty cannot skip the proof of work
+    uint64_t walTicket; // Ticket of the last record handed to the write-ahead log
+    size_t recordsSinceCheckpoint; // Records logged since the last checkpoint was started
+    string checkpointFile; // File the checkpoints are written to, empty when checkpoints are off
+    int logLock; // Descriptor holding an exclusive lock on the log from recovery on, so a second process using the same files is refused, -1 until the chain is recovered
+    thread checkpointThread; // Thread writing the latest checkpoint
+    ChangeFeed* changeFeed; // Feed every appended block is published to, nullptr when there are no subscribers
+    shared_ptr<const LocationDictionary> locations; // Valid locations, loaded from valid_locations.txt the first time a location is entered
+    shared_ptr<const ConsistencyRules> consistencyRules; // Rules checked across the stages of every shipment, nullptr until rules are loaded
+    unordered_map<string, vector<int> > ruleViolations; // Rules broken by each shipment, shipments that break none are left out
+    bool ruleViolationsValid; // Flag to indicate that the broken rules match the lifecycle view, every shipment is checked again on the next lookup when false
+    shared_ptr<unordered_map<int, BlockNode*> > changedNodes; // Changed copy of every block replaced after a newer block was linked, by block number, read through current() instead of copying every newer node, shared with snapshots and copied only while one shares it
+    vector<pair<int, bool> > deletionLog; // Every deletion made since the chain was built or recovered, its block number and whether it was hard, in order, so a server can send followers the deletions of blocks they already have
+    deque<BlockNode*> hotNodes; // Nodes linked by this chain whose whole block may still be in memory, oldest first, only kept when the cold store has a limit
+    shared_ptr<const OperatorKey> signingKey; // Key of the operator every block appended here is signed with, nullptr when blocks are not signed
+
+public: // Public members
+    Blockchain() {  // Constructor for Blockchain
+        head = nullptr; // Set head to nullptr, which is the start of the blockchain
+        changedNodes = make_shared<unordered_map<int, BlockNode*> >(); // No block has been changed
+        currentBlockNumber = 0; // Set current block number to 1
+        hashNumber = generateRandomHash(); // Generate a random hash number
+        Block firstBlock(currentBlockNumber, hashNumber, hashNumber, blockClock.now()); // Create the first block, stamped by the clock shared with every other chain
+        head = new BlockNode(firstBlock); // Set the head of the blockchain to the first block
+
+        procurementAdded = false; // Set procurement information added flag to false
+        inventoryAdded = false; // Set inventory information added flag to false
+        orderFulfillmentAdded = false; // Set order fulfillment information added flag to false
+        transportationAdded = false; // Set transportation information added flag to false
+        customerDeliverySatisfactionAdded = false; // Set customer delivery satisfaction information added flag to false
+        qualityControlAdded = false; // Set quality control information added flag to false
+        productReturn = false; // Set product return information added flag to false
+        productWorthiness = false; // Set product worthiness information added flag to false
+
+        persistence = nullptr; // Blocks are not persisted until a writer is attached
+        segmentFilters.resize(1); // The first block starts the first segment
+        lifecycleViewValid = true; // The empty view matches the empty chain
+        proofOfWorkDifficulty = 0; // Blocks are not sealed by proof of work unless asked
+        requiredDifficulty = 0; // No proof of work required until the first block says so
+        walTicket = 0; // Nothing logged yet
+        recordsSinceCheckpoint = 0; // No records since the last checkpoint
+        logLock = -1; // No log is locked until the chain is recovered
+        changeFeed = nullptr; // No change feed until one is attached
+        ruleViolationsValid = true; // The empty chain breaks no rule
+    }
+
+    Blockchain(const Blockchain& other) { // Copy constructor for Blockchain, the copy shares every existing block with the original and only the blocks appended afterwards diverge
+        head = other.head; // Share the blocks of the original
+        changedNodes = other.changedNodes; // Share the changed blocks, the first change on either chain copies them
+        currentBlockNumber = other.currentBlockNumber; // Copy the current block number
+        hashNumber = other.hashNumber; // Copy the hash number
+        procurementAdded = other.procurementAdded; // Copy the procurement information added flag
+        inventoryAdded = other.inventoryAdded; // Copy the inventory information added flag
+        orderFulfillmentAdded = other.orderFulfillmentAdded; // Copy the order fulfillment information added flag
+        transportationAdded = other.transportationAdded; // Copy the transportation information added flag
+        customerDeliverySatisfactionAdded = other.customerDeliverySatisfactionAdded; // Copy the customer delivery satisfaction information added flag
+        qualityControlAdded = other.qualityControlAdded; // Copy the quality control information added flag
+        productReturn = other.productReturn; // Copy the product return information added flag
+        productWorthiness = other.productWorthiness; // Copy the product worthiness information added flag
+        expectedProductWorthiness = other.expectedProductWorthiness; // Copy the expected product worthiness
+        persistence = nullptr; // A copy never writes into the log of the original
+        segmentFilters = other.segmentFilters; // Copy the ID filters
+        lifecycleViewValid = false; // The copy builds its own lifecycle view when it is first needed
+        proofOfWorkDifficulty = other.proofOfWorkDifficulty; // Copy the proof of work difficulty
+        requiredDifficulty = other.requiredDifficulty; // Copy the required difficulty
+        signingKey = other.signingKey; // Share the signing key
+        walTicket = 0; // The copy has no log
+        recordsSinceCheckpoint = 0; // The copy writes no checkpoints
+        logLock = -1; // The lock stays with the original
+        changeFeed = nullptr; // A copy never publishes to the feed of the original
+        locations = other.locations; // Share the valid locations, they never change once loaded
+        consistencyRules = other.consistencyRules; // Share the consistency rules, a rule set never changes once compiled
+        ruleViolationsValid = false; // The copy checks its shipments when it is first asked
+    }
+
+    ~Blockchain() { // Destructor for Blockchain, waits for a checkpoint still being written
+        if (checkpointThread.joinable()) { // If a checkpoint was started
+            checkpointThread.join(); // Wait for it
+        }
+        if (logLock != -1) { // If the log was locked
+            close(logLock); // Release the lock
+        }
+    }
+
+    Blockchain snapshot() { // Take a point in time view of the blockchain for audits, replays or exports, no block is copied and later appends or deletions on either chain do not affect the other
+        return Blockchain(*this); // Return a copy sharing every block
+    }
+
+    void enableProofOfWork(int difficulty) { // Method to seal every block appended from now on with a proof of work of the given number of leading zero bits, 0 turns sealing off
+        proofOfWorkDifficulty = max(0, min(difficulty, MAX_PROOF_OF_WORK_DIFFICULTY)); // Keep the difficulty to one a search can finish
+    }
+
+    void enableSigning(shared_ptr<const OperatorKey> key) { // Method to sign every block appended from now on with the key of the operator running the program
+        signingKey = key; // Set the signing key
+    }
+
+    void attachPersistence(PersistenceWriter* writer, const string& checkpointFilename) { // Attach the write-ahead log that records every append and deletion from now on, with a checkpoint of the whole chain written to the file passed in every WAL_CHECKPOINT_RECORDS records
+        persistence = writer; // Set the persistence writer
+        checkpointFile = checkpointFilename; // Set the checkpoint file
+    }
+
+    void attachChangeFeed(ChangeFeed* feed) { // Attach a change feed that every block appended from now on is published to, subscribers can still start from older blocks
+        changeFeed = feed; // Set the change feed
+        changeFeed->start(head, currentBlockNumber); // Start it after the existing blocks
+    }
+
+    void logRecord(const string& payload) { // Hand a record to the write-ahead log, the caller acknowledges the change only after waitForLog
+        if (persistence == nullptr) { // If nothing is logged
+            return;
+        }
+        walTicket = persistence->submit(walRecord(payload)); // Queue the record for the background writer
+        if (++recordsSinceCheckpoint >= WAL_CHECKPOINT_RECORDS && !checkpointFile.empty() && persistence->isOpen()) { // If enough records have been logged since the last checkpoint and the log is still written
+            startCheckpoint(); // Write a new one in the background
+        }
+    }
+
+    bool waitForLog() { // Block until every record logged so far is on disk, so changes are acknowledged only once they survive a crash, returns false if a record was lost and the change must not be acknowledged
+        if (persistence != nullptr && walTicket != 0) { // If anything was logged
+            return persistence->waitDurable(walTicket); // Wait for the background writer
+        }
+        return true;
+    }
+
+    bool logHealthy() { // Method to check that changes can still be logged, a chain whose log has failed refuses changes rather than make ones that would be lost
+        return persistence == nullptr || persistence->isOpen(); // Healthy if nothing is logged or the log has not failed
+    }
+
+    void startCheckpoint() { // Write a checkpoint of the chain as it is now on a background thread, recovery then only replays the log records after it
+        if (checkpointThread.joinable()) { // If the previous checkpoint is still being written
+            checkpointThread.join(); // Wait for it, checkpoints are written one at a time
+        }
+        recordsSinceCheckpoint = 0; // Start counting again
+        Blockchain view = snapshot(); // Point in time view of the chain, later changes do not affect it
+        uint64_t logOffset = persistence->endOffset(); // The checkpoint covers the log up to here
+        uint64_t ticket = walTicket; // Last record covered by the checkpoint
+        PersistenceWriter* writer = persistence; // Log the checkpoint waits on
+        string filename = checkpointFile; // File the checkpoint is written to
+        checkpointThread = thread([view, logOffset, ticket, writer, filename]() mutable { // Write the checkpoint without holding up appends
+            if (writer->waitDurable(ticket)) { // The log must reach the covered offset first, so new records always land after it, a log that failed first is not covered
+                view.writeCheckpoint(filename, logOffset); // Write the checkpoint
+            }
+        });
+    }
+
+    bool writeCheckpoint(const string& filename, uint64_t logOffset) { // Write every block to a checkpoint file, with the log offset it covers, returns false if the file could not be written
+        string temporary = filename + ".tmp"; // The checkpoint is written beside the old one and renamed over it, so a crash leaves one whole checkpoint
+        int fd = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644); // Open the temporary file
+        bool ok = fd != -1; // Flag to indicate that the checkpoint was written
+        string data; // Bytes not written yet, the checkpoint is written a piece at a time so evicted blocks are never all in memory at once
+        function<void()> flush = [&]() { // Write the bytes collected so far
+            for (size_t written = 0; ok && written < data.size(); ) { // For loop until every byte is written
+                ssize_t result = write(fd, data.data() + written, data.size() - written); // Write the rest
+                if (result < 0 && errno != EINTR) { // If the write failed
+                    ok = false;
+                } else if (result > 0) { // If bytes were written
+                    written += static_cast<size_t>(result); // Count them
+                }
+            }
+            data.clear(); // Start the next piece
+        };
+
+        vector<const BlockNode*> nodes = nodesFrom(0); // Every appended block, oldest first
+        data = "BCCKP1"; // Format name
+        appendUint32(data, static_cast<uint32_t>(logOffset >> 32)); // Append the high half of the log offset
+        appendUint32(data, static_cast<uint32_t>(logOffset)); // Append the low half of the log offset
+        appendUint32(data, static_cast<uint32_t>(nodes.size())); // Append the number of blocks
+        for (size_t i = 0; i < nodes.size() && ok; ++i) { // For loop over the blocks
+            shared_ptr<const Block> block = blockOf(nodes[i]); // Whole block, read back in order if it was evicted so the cold store is read ahead
+            appendUint32(data, static_cast<uint32_t>(block->encoded.size())); // Append its length, so recovery can find every block before decoding them in parallel
+            data += block->encoded; // Append the canonical encoding made when the block was linked, it keeps any soft deleted information
+            if (data.size() >= CHECKPOINT_WRITE_BYTES) { // If a piece is ready
+                flush(); // Write it
+            }
+        }
+        flush(); // Write the rest
+        ok = ok && fsync(fd) == 0; // Make the checkpoint durable before it replaces the old one
+        if (fd != -1) { // If the file was opened
+            close(fd); // Close it
+        }
+        ok = ok && rename(temporary.c_str(), filename.c_str()) == 0; // Replace the old checkpoint
+        if (!ok) { // If the checkpoint could not be written
+            cout << "Error: Unable to write checkpoint " << filename << "." << endl; // Tell the user, the log still holds every change
+        }
+        return ok;
+    }
+
+    bool markDeleted(int blockNumber, bool hard) { // Set a deletion flag without prompting, used when replaying the log and when applying a deletion sent by the leader, which is logged once a log is attached, returns false if the block does not exist
+        shared_ptr<const Block> block = findBlock(blockNumber); // Find the block
+        if (block == nullptr) { // If the block does not exist
+            return false;
+        }
+        if (hard ? block->isHardDeleted : block->isSoftDeleted) { // If the block already carries the flag, such as a deletion a follower received with the block
+            return true;
+        }
+        Block deletedBlock = *block; // Copy the block, it may be shared with a snapshot
+        (hard ? deletedBlock.isHardDeleted : deletedBlock.isSoftDeleted) = true; // Set the flag
+        replaceBlock(deletedBlock); // Link the deleted copy in place of the block
+        lifecycleViewValid = false; // The lifecycle view still points at the block before the deletion
+        logDeletion(blockNumber, hard); // Log the deletion
+        return true;
+    }
+
+    void logDeletion(int blockNumber, bool hard) { // Hand a deletion to the write-ahead log and add it to the deletions sent to followers
+        string payload(1, static_cast<char>(hard ? WAL_HARD_DELETE : WAL_SOFT_DELETE)); // Declare the log record
+        appendUint32(payload, static_cast<uint32_t>(blockNumber)); // Append the block number
+        logRecord(payload); // Log the deletion
+        deletionLog.push_back(make_pair(blockNumber, hard)); // Remember it for the followers
+    }
+
+    size_t deletionCount() const { // Method to get the number of deletions made since the chain was built or recovered
+        return deletionLog.size();
+    }
+
+    vector<pair<int, bool> > deletionsFrom(size_t first) const { // Method to get the deletions made from the one passed in on, oldest first
+        return vector<pair<int, bool> >(deletionLog.begin() + static_cast<ptrdiff_t>(min(first, deletionLog.size())), deletionLog.end());
+    }
+
+    vector<pair<int, bool> > deletedBlocksBelow(int blockNumber) const { // Method to get every deletion flag set on the blocks below the block number passed in, oldest first, read from the headers so no evicted block is read back
+        vector<pair<int, bool> > deleted; // Declare the deletions
+        for (const BlockNode* temp = head; temp != nullptr; temp = temp->next) { // For loop over the blocks, newest first
+            const BlockNode* node = current(temp); // The block as it is now
+            if (node->data.blockNumber >= blockNumber) { // Blocks the follower does not have carry their flags when they are sent
+                continue;
+            }
+            if (node->data.isHardDeleted) { // If the block was hard deleted
+                deleted.push_back(make_pair(node->data.blockNumber, true));
+            }
+            if (node->data.isSoftDeleted) { // If the block was soft deleted
+                deleted.push_back(make_pair(node->data.blockNumber, false));
+            }
+        }
+        reverse(deleted.begin(), deleted.end()); // Oldest first
+        return deleted;
+    }
+
+    bool recover(const string& checkpointFilename, const string& logFilename) { // Rebuild the chain after a restart from the latest checkpoint and the log records written after it, a torn record at the end of the log is cut off, the log is locked first and stays locked while the chain lives, returns false without touching the files if another process holds the lock or a whole record is rejected
+        logLock = open(logFilename.c_str(), O_RDWR | O_CREAT, 0644); // Open the log to lock it, creating it if this is the first run
+        if (logLock == -1 || flock(logLock, LOCK_EX | LOCK_NB) != 0) { // If it could not be opened or another process holds it, two writers would append at offsets they track separately
+            cout << "Error: " << logFilename << (logLock == -1 ? " could not be opened." : " is used by another process, give every process its own --data-dir.") << endl; // Tell the user
+            if (logLock != -1) { // If it was opened
+                close(logLock);
+                logLock = -1;
+            }
+            return false;
+        }
+        uint64_t logOffset = 0; // Log offset covered by the checkpoint
+        size_t checkpointBlocks = 0; // Blocks restored from the checkpoint
+        ifstream checkpoint(checkpointFilename, ios::binary); // Open the checkpoint, it is read a batch at a time so a long chain is never whole in memory
+        checkpoint.seekg(0, ios::end); // Find the size of the file
+        size_t checkpointSize = checkpoint ? static_cast<size_t>(checkpoint.tellg()) : 0; // Bytes of the checkpoint, 0 if there is none
+        checkpoint.seekg(0); // Go back to the start
+        char format[6]; // Declare the format name
+        size_t pos = 18; // Position after the format name, the log offset and the number of blocks
+        uint32_t offsetHigh, offsetLow, blockCount; // Declare the two halves of the log offset and the number of blocks
+        if (checkpointSize >= pos && checkpoint.read(format, 6) && string(format, 6) == "BCCKP1" && readStreamUint32(checkpoint, offsetHigh) && readStreamUint32(checkpoint, offsetLow) && readStreamUint32(checkpoint, blockCount)) { // If there is a checkpoint
+            vector<pair<size_t, size_t> > spans; // Position and length of each block
+            uint32_t length; // Length of the next block
+            while (spans.size() < blockCount && readStreamUint32(checkpoint, length) && length <= checkpointSize - pos - 4) { // Find every block, only the lengths are read here
+                pos += 4; // Move past the length
+                spans.push_back(make_pair(pos, static_cast<size_t>(length))); // Remember the block
+                pos += length; // Move past it
+                checkpoint.seekg(static_cast<streamoff>(pos)); // Skip its bytes
+            }
+            vector<size_t> batchStarts; // First block of every batch, then the number of blocks, with a cold store limit only one batch is held in memory and the checkpoint is decoded twice, once to check it and once to link it
+            size_t bytesInBatch = 0; // Bytes of the blocks in the batch so far
+            for (size_t i = 0; i < spans.size(); ++i) { // For loop to split the blocks into batches
+                if (i == 0 || (coldStore.hotLimit() != 0 && bytesInBatch + spans[i].second > RECOVERY_BATCH_BYTES)) { // If the block starts a batch, without a limit every block stays in memory anyway so there is one batch
+                    batchStarts.push_back(i);
+                    bytesInBatch = 0;
+                }
+                bytesInBatch += spans[i].second; // Count the block
+            }
+            batchStarts.push_back(spans.size()); // End of the last batch
+            vector<Block> blocks; // Declare the decoded blocks of the batch
+            vector<char> decoded; // Flag for each block that decoded cleanly
+            string batchBytes; // Bytes of the batch, from its first block to the end of its last
+            function<void(size_t)> decodeBatch = [&](size_t batch) { // Read and decode the batch passed in
+                size_t first = batchStarts[batch]; // First block of the batch
+                size_t count = batchStarts[batch + 1] - first; // Blocks in the batch
+                size_t start = spans[first].first; // Position of the batch in the file
+                batchBytes.assign(spans[first + count - 1].first + spans[first + count - 1].second - start, '\0'); // Make room for the batch
+                checkpoint.clear(); // The scan for the lengths may have left the stream at its end
+                checkpoint.seekg(static_cast<streamoff>(start)); // Go to the batch
+                bool read = static_cast<bool>(checkpoint.read(&batchBytes[0], static_cast<streamsize>(batchBytes.size()))); // Read it in one go
+                blocks.assign(count, Block(0, "", "", 0));
+                decoded.assign(count, 0);
+                forEachInParallel(count, [&](size_t i) { // Decode the blocks on every core
+                    size_t blockPos = 0; // Position in the block
+                    decoded[i] = read && decodeBlock(batchBytes.substr(spans[first + i].first - start, spans[first + i].second), blockPos, blocks[i]); // Decode the block
+                });
+            };
+            bool intact = spans.size() == blockCount; // Flag to indicate that every block was found and decoded
+            string previousHash; // Hash of the block before the one checked
+            uint64_t previousTimeStamp = 0; // Time stamp of the block before the one checked
+            int required = 0; // Difficulty required by the first block of the checkpoint
+            for (size_t batch = 0; batch + 1 < batchStarts.size() && intact; ++batch) { // For loop to check the blocks before any is linked, so a damaged checkpoint leaves the chain empty
+                size_t first = batchStarts[batch]; // First block of the batch
+                decodeBatch(batch); // Decode the batch
+                vector<const Block*> decodedBlocks; // Declare the blocks whose signatures are checked
+                for (size_t i = 0; i < blocks.size() && decoded[i]; ++i) { // For loop over the blocks up to the first damaged one
+                    decodedBlocks.push_back(&blocks[i]); // Check the block
+                }
+                vector<char> signaturesValid = verifyBlockSignatures(decodedBlocks); // Check the signatures of the batch together on every core
+                for (size_t i = 0; i < blocks.size() && intact; ++i) { // For loop over the batch
+                    if (!decoded[i]) { // A block that does not decode is damaged, the log is replayed instead
+                        intact = false;
+                        break;
+                    }
+                    if (!signaturesValid[i] || !blockLinksAfter(blocks[i], static_cast<int>(first + i), previousHash, previousTimeStamp, required)) { // If a whole block is not signed with its signer's registered key or does not link onto the one before it, the same checks appendExistingBlock makes
+                        cout << "Error: Block " << first + i << " in " << checkpointFilename << (signaturesValid[i] ? " does not link onto the block before it" : " is not signed with the key " + OPERATOR_REGISTRY + " registers for its signer") << ", the checkpoint and the log are left as they are." << endl; // Tell the user, replaying the log instead would reach the same block
+                        return false;
+                    }
+                    required = first + i == 0 ? blocks[i].difficulty : required; // The first block sets the difficulty
+                    previousHash = blocks[i].currentHashNumber; // The next block links to it
+                    previousTimeStamp = blocks[i].currentTimeStamp; // And is stamped after it
+                }
+            }
+            if (intact) { // If the whole checkpoint can be restored
+                for (size_t batch = 0; batch + 1 < batchStarts.size(); ++batch) { // For loop to link the batches in order
+                    if (batchStarts.size() > 2) { // If the checkpoint did not fit in one batch
+                        decodeBatch(batch); // Decode the batch again
+                    }
+                    for (size_t i = 0; i < blocks.size(); ++i) { // For loop to link the blocks in order
+                        if (!appendExistingBlock(blocks[i], true)) { // Link the block, its signature was checked above, older blocks are evicted as it goes
+                            cout << "Error: Block " << blocks[i].blockNumber << " in " << checkpointFilename << " could not be linked, the checkpoint and the log are left as they are." << endl; // Tell the user, the log only follows a checkpoint that was linked whole
+                            return false;
+                        }
+                    }
+                }
+                checkpointBlocks = spans.size(); // Count the blocks restored
+                logOffset = (static_cast<uint64_t>(offsetHigh) << 32) | offsetLow; // The log is replayed from the offset it covers
+            } else { // If the checkpoint is damaged
+                cout << "Error: Checkpoint " << checkpointFilename << " is damaged, replaying the whole log." << endl; // Tell the user
+            }
+        }
+
+        ifstream logFile(logFilename, ios::binary); // Open the log
+        logFile.seekg(static_cast<streamoff>(logOffset)); // Skip the records covered by the checkpoint
+        string tail((istreambuf_iterator<char>(logFile)), istreambuf_iterator<char>()); // Read the rest of the log
+        vector<pair<size_t, size_t> > spans; // Position and length of each record's payload
+        pos = 0; // Start of the tail
+        uint32_t length, checksum; // Declare the length and the checksum of the next record
+        while (readUint32(tail, pos, length) && readUint32(tail, pos, checksum) && length > 0 && length <= tail.size() - pos) { // Find every whole record, a torn record at the end is left out
+            spans.push_back(make_pair(pos, static_cast<size_t>(length))); // Remember the payload
+            pos += length; // Move past it
+        }
+        vector<Block> blocks(spans.size(), Block(0, "", "", 0)); // Declare the blocks of the append records
+        vector<char> valid(spans.size(), 0); // Flag for each record whose checksum matches and whose payload decoded cleanly
+        forEachInParallel(spans.size(), [&](size_t i) { // Check and decode the records on every core
+            string payload = tail.substr(spans[i].first, spans[i].second); // The payload of the record
+            size_t payloadPos = 1; // Position after the record type
+            size_t checksumPos = spans[i].first - 4; // Position of the checksum, just before the payload
+            uint32_t savedChecksum, blockNumber; // Declare the saved checksum and the block number of a deletion
+            if (!readUint32(tail, checksumPos, savedChecksum) || recordChecksum(payload) != savedChecksum) { // If the checksum does not match, the record was torn
+                return;
+            }
+            if (payload[0] == static_cast<char>(WAL_APPEND)) { // If the record is an append
+                valid[i] = decodeBlock(payload, payloadPos, blocks[i]); // Decode the block
+            } else if (payload[0] == static_cast<char>(WAL_SOFT_DELETE) || payload[0] == static_cast<char>(WAL_HARD_DELETE)) { // If the record is a deletion
+                valid[i] = readUint32(payload, payloadPos, blockNumber); // Read the block number
+                blocks[i].blockNumber = static_cast<int>(blockNumber); // Keep the block number with the record
+            }
+        });
+
+        vector<const Block*> appendedBlocks; // Declare the blocks of the append records
+        vector<size_t> appendRecords; // Declare the record of each of them
+        for (size_t i = 0; i < spans.size() && valid[i]; ++i) { // For loop over the records up to the first torn one
+            if (tail[spans[i].first] == static_cast<char>(WAL_APPEND)) { // If the record carries a block
+                appendedBlocks.push_back(&blocks[i]); // Check the block
+                appendRecords.push_back(i); // Remember its record
+            }
+        }
+        vector<char> checked = verifyBlockSignatures(appendedBlocks); // Check the signatures of every block appended together on every core
+        vector<char> signaturesValid(spans.size(), 0); // Flag for each record whose block's signature was checked and holds
+        for (size_t j = 0; j < appendRecords.size(); ++j) { // For loop to copy the results
+            signaturesValid[appendRecords[j]] = checked[j]; // Set the result of the record
+        }
+        size_t replayed = 0; // Records applied
+        size_t goodBytes = 0; // Bytes of the tail up to the end of the last record applied
+        for (; replayed < spans.size() && valid[replayed]; ++replayed) { // Apply the records in order, stopping at the first torn one, only a record whose checksum or encoding is broken is cut off
+            char type = tail[spans[replayed].first]; // Record type
+            if (type == static_cast<char>(WAL_APPEND) && !signaturesValid[replayed]) { // If the block is not signed with its signer's registered key, which a missing or changed registry causes as well as a forgery, the record is whole so it is not cut off
+                cout << "Error: Block " << blocks[replayed].blockNumber << " in " << logFilename << " is not signed with the key " << OPERATOR_REGISTRY << " registers for " << (blocks[replayed].signer.empty() ? string("its signer") : blocks[replayed].signer) << ", check the registry and restart." << endl; // Tell the user, the log is left as it is
+                return false;
+            }
+            bool applied = type == static_cast<char>(WAL_APPEND) ? appendExistingBlock(blocks[replayed], true) : markDeleted(blocks[replayed].blockNumber, type == static_cast<char>(WAL_HARD_DELETE)); // Apply the record, its signature was checked above
+            if (!applied) { // If a whole record does not fit the chain, the log and the checkpoint disagree and cutting the log would lose what it holds
+                cout << "Error: " << (type == static_cast<char>(WAL_APPEND) ? "Block " : "Deletion of block ") << blocks[replayed].blockNumber << " in " << logFilename << " does not fit the chain recovered so far, the log is left as it is." << endl; // Tell the user
+                return false;
+            }
+            goodBytes = spans[replayed].first + spans[replayed].second; // The record is kept
+        }
+        if (goodBytes < tail.size()) { // If anything after the last good record is left
+            if (truncate(logFilename.c_str(), static_cast<off_t>(logOffset + goodBytes)) != 0) { // Cut it off so new records follow the last good one
+                cout << "Error: Unable to cut the torn end off " << logFilename << "." << endl; // Tell the user that the log could not be repaired
+            }
+        }
+        recordsSinceCheckpoint = replayed; // The replayed records count towards the next checkpoint
+        if (blockClock.isTooFarAhead(head->data.currentTimeStamp)) { // If the wall clock stepped back since the latest block was stamped, linking it moved the clock forward to it so new blocks still order after it
+            cout << "Warning: The latest block of " << logFilename << " is stamped more than " << MAX_CLOCK_DRIFT_MILLIS / 1000 << " seconds ahead of this machine's clock, new blocks are stamped after it until the clock catches up." << endl; // Tell the user
+        }
+        lifecycleViewValid = false; // Build the lifecycle view when it is first needed
+        if (checkpointBlocks > 0 || replayed > 0) { // If anything was recovered
+            cout << "\nRecovered " << currentBlockNumber << " block(s): " << checkpointBlocks << " from the checkpoint and " << replayed << " log record(s) replayed" << (goodBytes < tail.size() ? ", torn record discarded." : ".") << endl; // Tell the user what was recovered
+        }
+        return true;
+    }
+
+    void addBlock(const vector<pair<string, string> >& info) { // Add a block to the blockchain with the information passed in, information is a vector pair of strings
+        int chosenBlockNumber; // Chosen block number by the user to add to the blockchain
+
+        Block newBlock(currentBlockNumber, "", head->data.currentHashNumber, 0); // Create a scratch block to collect the information entered by the user, the hash and time stamp are set when it is appended
+        newBlock.information = info; // Set the information of the new block to the information passed in as a parameter
+
+        do { // Loop until the user chooses to add all the blocks they want to add, only one of each block can be added
+            cout << "\nWhich block do you want to add? (1-8):" << endl; // Ask the user which block they want to add
+            cout << "\n1. Procurement Stage" << endl; // Add Procurement Stage
+            cout << "\n2. Inventory Storage Stage" << endl; // Add Inventory Storage Stage
+            cout << "\n3. Order Fulfillment Stage" << endl; // Add Order Fulfillment Stage
+            cout << "\n4. Transportation Stage" << endl; // Add Transportation Stage
+            cout << "\n5. Customer Delivery Satisfaction Stage" << endl; // Add Customer Delivery Satisfaction Stage
+            cout << "\n6. Quality Control Stage" << endl; // Add Quality Control Stage
+            cout << "\n7. Product Return Stage" << endl; // Add Product Return Stage
+            cout << "\n8. Product Worthiness Stage" << endl; // Add Product Worthiness Stage
+            cout << "\nEnter your choice: "; // Ask the user to enter their choice
+            cin >> chosenBlockNumber; // Get the user's choice
+            cin.ignore(); // Ignore the newline character
+
+            if (cin.fail()) { // If the user enters an invalid input
+                cin.clear(); // Clear the input buffer
+                cin.ignore(numeric_limits<streamsize>::max(), '\n'); // Ignore the rest of the input
+                cout << "\nInvalid input. Please enter a number." << endl; // Tell the user that they entered an invalid input
+                continue; // Continue to the next iteration of the loop
+            }
+
+            switch (chosenBlockNumber) { // Switch statement based on the user's choice
+                case 1: // If the user chooses 1
+                    if(procurementAdded) { // If procurement information has already been added
+                        cout << "Procurement Information has already been added." << endl; // Tell the user that procurement information has already been added
+                        chosenBlockNumber = 0; // Set chosen block number to 0 because the user has already added procurement information so the switch statement will break
+                        break; // Break out of the switch statement
+                    }
+                    addProcurementInformation(newBlock); // Add procurement information to the new block
+                    procurementAdded = true; // Set procurement information added flag to true
+                    break; // Break out of the switch statement
+                case 2:  // If the user chooses 2
+                    if(inventoryAdded) { // If inventory information has already been added
+                        cout << "Inventory Information has already been added." << endl; // Tell the user that inventory information has already been added
+                        chosenBlockNumber = 0; // Set chosen block number to 0 because the user has already added inventory information so the switch statement will break
+                        break; // Break out of the switch statement
+                    }
+                    addInventoryInformation(newBlock); // Add inventory information to the new block
+                    inventoryAdded = true; // Set inventory information added flag to true
+                    break; // Break out of the switch statement
+                case 3: // If the user chooses 3
+                    if(orderFulfillmentAdded) { // If order fulfillment information has already been added
+                        cout << "Order Fulfillment Information has already been added." << endl; // Tell the user that order fulfillment information has already been added
+                        chosenBlockNumber = 0; // Set chosen block number to 0 because the user has already added order fulfillment information so the switch statement will break
+                        break; // Break out of the switch statement
+                    }
+                    addOrderFulfillmentInformation(newBlock); // Add order fulfillment information to the new block
+                    orderFulfillmentAdded = true; // Set order fulfillment information added flag to true
+                    break; // Break out of the switch statement
+                case 4: // If the user chooses 4
+                    if(transportationAdded) { // If transportation information has already been added
+                        cout << "Transportation Information has already been added." << endl; // Tell the user that transportation information has already been added
+                        chosenBlockNumber = 0; // Set chosen block number to 0 because the user has already added transportation information so the switch statement will break
+                        break; // Break out of the switch statement
+                    }
+                    addTransportationInformation(newBlock); // Add transportation information to the new block
+                    transportationAdded = true; // Set transportation information added flag to true
+                    break; // Break out of the switch statement
+                case 5: // If the user chooses 5
+                    if(customerDeliverySatisfactionAdded) { // If customer delivery satisfaction information has already been added
+                        cout << "Customer Delivery Satisfaction Information has already been added." << endl; // Tell the user that customer delivery satisfaction information has already been added
+                        chosenBlockNumber = 0; // Set chosen block number to 0 because the user has already added customer delivery satisfaction information so the switch statement will break
+                        break; // Break out of the switch statement
+                    }
+                    addCustomerDeliverySatisfactionInformation(newBlock); // Add customer delivery satisfaction information to the new block
+                    customerDeliverySatisfactionAdded = true; // Set customer delivery satisfaction information added flag to true
+                    break; // Break out of the switch statement
+                case 6: // If the user chooses 6
+                    if(qualityControlAdded) { // If quality control information has already been added
+                        cout << "Quality Control Information has already been added." << endl; // Tell the user that quality control information has already been added
+                        chosenBlockNumber = 0; // Set chosen block number to 0 because the user has already added quality control information so the switch statement will break
+                        break; // Break out of the switch statement
+                    }
+                    addQualityInspectionControlInformation(newBlock); // Add quality control information to the new block
+                    qualityControlAdded = true; // Set quality control information added flag to true
+                    break; // Break out of the switch statement
+                case 7: // If the user chooses 7
+                    if(productReturn) { // If product return information has already been added
+                        cout << "Product Return Information has already been added." << endl; // Tell the user that product return information has already been added
+                        chosenBlockNumber = 0; // Set chosen block number to 0 because the user has already added product return information so the switch statement will break
+                        break; // Break out of the switch statement
+                    } // Add product return information to the new block 
+                    addProductReturnInformation(newBlock); // Add product return information to the new block
+                    productReturn = true; // Set product return information added flag to true
+                    break; // Break out of the switch statement
+                case 8: // If the user chooses 8
+                    if(productWorthiness) { // If product worthiness information has already been added
+                        cout << "Product Worthiness Information has already been added." << endl; // Tell the user that product worthiness information has already been added
+                        chosenBlockNumber = 0; // Set chosen block number to 0 because the user has already added product worthiness information so the switch statement will break
+                        break; // Break out of the switch statement
+                    }
+                    addProductWorthinessInformation(newBlock); // Add product worthiness information to the new block
+                    productWorthiness = true; // Set product worthiness information added flag to true
+                    break; // Break out of the switch statement
+                default:
+                    cout << "Invalid choice. Please enter a number between 1-8." << endl; // Tell the user that their choice is invalid
+                    break; // Break out of the switch statement
+            }
+        } while (chosenBlockNumber < 1 || chosenBlockNumber > 8); // Keep asking the user to enter a number between 1-8 until they do so
+        
+        if (!logHealthy()) { // If an earlier record could not be written
+            cout << "Error: The log on disk has failed, the block was not added." << endl; // Tell the user
+            return;
+        }
+        appendBlock(newBlock.information); // Append the block with the information the user entered to the blockchain
+        if (!waitForLog()) { // If the block could not be written to the log
+            cout << "Error: The block could not be written to the log and is lost when the program exits." << endl; // Tell the user
+            return;
+        }
+        warnBrokenRules(LOCAL_SHIPMENT); // Tell the user if the block leaves the shipment inconsistent
+    }
+
+    int appendBlock(const vector<pair<string, string> >& info) { // Append a block holding the information passed in, used by the menu and by the server, returns the block number given to the block
+        hashNumber = generateRandomHash(); // Generate a random hash number for the new block to be added
+        Block newBlock(currentBlockNumber, hashNumber, head->data.currentHashNumber, blockClock.now()); // Create a new block with the current block number, the hash number, the previous hash number, and a time stamp later than every block before it
+        newBlock.information = info; // Set the information of the new block to the information passed in as a parameter
+        nameSigner(newBlock); // Name the signer before the body is sealed
+        int difficulty = max(proofOfWorkDifficulty, requiredDifficulty); // Difficulty of the block, never below what the chain requires
+        bool sealed = difficulty > 0 && currentBlockNumber > 0; // Flag to indicate that the block is sealed by proof of work, the first block keeps its random hash because it links to itself
+        if (sealed) { // If blocks are sealed by proof of work
+            newBlock.difficulty = difficulty; // Record the difficulty in the block, it is part of the header
+            string header = blockHeader(newBlock); // Header the nonce is searched for, the body of the block's encoding
+            newBlock.nonce = findNonce(header, difficulty); // Search for a nonce on every core
+            newBlock.currentHashNumber = sha256Hex(header + nonceHex(newBlock.nonce)); // The block's hash is the hash of its header and nonce
+            hashNumber = newBlock.currentHashNumber; // The sealed hash is the latest hash
+            signBlock(newBlock, header); // Sign the sealed block
+            newBlock.encoded = header; // The header is the start of the block's encoding
+            encodeBlockTrailer(newBlock, newBlock.encoded); // Finish the encoding with the hash, the nonce, the signature and the flags
+        } else if (currentBlockNumber > 0) { // If the block keeps its random hash
+            signBlock(newBlock, blockHeader(newBlock)); // Sign it
+        }
+
+        if (currentBlockNumber == 0) { // If the current block number is 1
+            Block firstBlock = *blockOf(head); // Copy the first block, it may be shared with a snapshot
+            firstBlock.information = newBlock.information;  // Set the first block's information to the new block's information
+            firstBlock.encoded.clear(); // The copy's encoding no longer matches its body
+            firstBlock.difficulty = proofOfWorkDifficulty; // Record the difficulty the chain requires, the first block is not sealed itself but its signature covers it
+            requiredDifficulty = proofOfWorkDifficulty; // Every later block must meet it
+            nameSigner(firstBlock); // Name the signer
+            signBlock(firstBlock, blockHeader(firstBlock)); // Sign the filled in first block
+            replaceBlock(firstBlock); // Link the filled in first block in place of the empty one
+        } else { // If the current block number is not 1
+            BlockNode* newNode = new BlockNode(newBlock, sealed); // Create a new block node with the new block's information, a sealed block is already encoded
+            newNode->next = head; // Set the new node's next to the head
+            head = newNode; // Set the head to the new node
+        }
+
+        int appendedBlockNumber = currentBlockNumber++; // Remember the block number given to the block and increment the current block number, before the log may take a checkpoint of the chain
+        indexAppendedBlock(); // Update the filters, the lifecycle view and the log with the new block
+        return appendedBlockNumber; // Return the block number given to the block
+    }
+
+    void nameSigner(Block& block) { // Method to name the operator signing a block, the name and key are part of the body so they are set before it is sealed
+        if (signingKey) { // If blocks are signed
+            block.signer = signingKey->name; // Set the signer
+            block.signerKey = signingKey->publicKey; // Set the signer's key
+        }
+    }
+
+    void signBlock(Block& block, const string& body) { // Method to sign a block whose body and hash are final, given the body's encoding
+        if (signingKey) { // If blocks are signed
+            block.signature = signMessage(*signingKey, body + block.currentHashNumber); // Sign the body and the hash
+        }
+    }
+
+    bool appendExistingBlock(const Block& block, bool signatureChecked = false) { // Append a block that already has its hash and time stamp, such as a block received from the leader, returns false if it does not link onto the chain, a caller that checked the block's signature in a batch passes signatureChecked so it is not checked again
+        if (!blockLinksAfter(block, currentBlockNumber, head->data.currentHashNumber, head->data.currentTimeStamp, requiredDifficulty)) { // If the block does not link onto the chain, a caller receiving it from another process refuses it first if it is stamped too far ahead
+            return false;
+        }
+        if (!signatureChecked && isSignedBlock(block)) { // If the block claims a signer and its signature was not checked yet
+            string message = blockSigningMessage(block); // Bytes the block signed
+            if (!operatorRegistry.isRegistered(block.signer, block.signerKey) || !verifySignature(SignatureCheck{ &block.signerKey, &message, &block.signature })) { // If the key is not the signer's registered key or the signature does not hold
+                return false;
+            }
+        }
+        if (currentBlockNumber == 0) { // If the block is the first block
+            requiredDifficulty = block.difficulty; // The first block sets the difficulty of the chain
+            head = new BlockNode(block, true); // The block replaces the empty first block, the bytes it was decoded from are its encoding
+        } else { // If the block follows other blocks
+            BlockNode* newNode = new BlockNode(block, true); // Create a new block node for the block, the bytes it was decoded from are its encoding
+            newNode->next = head; // Set the new node's next to the head
+            head = newNode; // Set the head to the new node
+        }
+        hashNumber = block.currentHashNumber; // The block's hash is the latest hash
+        blockClock.observe(block.currentTimeStamp); // Blocks appended here later are stamped after the block
+        currentBlockNumber++; // Increment the current block number, before the log may take a checkpoint of the chain
+        indexAppendedBlock(); // Update the filters, the lifecycle view and the log with the new block
+        return true;
+    }
+
+    void indexAppendedBlock() { // Update the ID filters, the lifecycle view and the log with the block just linked at the head, then evict the oldest hot blocks
+        shared_ptr<const Block> appended = blockOf(head); // The block just appended, a new block is always hot
+        const Block& block = *appended;
+        size_t segment = static_cast<size_t>(block.blockNumber / SEGMENT_BLOCKS); // Segment of the block
+        if (segmentFilters.size() <= segment) { // If the block starts a new segment
+            segmentFilters.resize(segment + 1); // Add a filter for the segment
+        }
+        for (size_t i = 0; i < block.information.size(); ++i) { // For loop over the information of the block
+            if (isIdField(block.information[i].first)) { // If the information is an ID
+                segmentFilters[segment].add(block.information[i].second); // Add the ID to the filter of the segment
+            }
+        }
+
+        if (lifecycleViewValid) { // If the lifecycle view is in use
+            recordLifecycle(head, block); // Update the shipment of the block
+            if (consistencyRules && ruleViolationsValid) { // If rules are checked
+                checkRulesAfter(block); // Check only the rules the block can affect, for its shipment only
+            }
+        }
+
+        if (persistence != nullptr) { // If changes are logged
+            string payload(1, static_cast<char>(WAL_APPEND)); // Declare the record
+            payload += block.encoded; // Append the canonical encoding made when the block was linked
+            logRecord(payload); // Hand the record to the background writer, the caller waits for it before acknowledging
+        }
+
+        if (changeFeed != nullptr) { // If blocks are fed to subscribers
+            changeFeed->publish(head); // Publish the block, subscribers read it straight from the ring
+        }
+        trackHotNode(head); // The new block is the newest hot block
+    }
+
+    void trackHotNode(BlockNode* node) { // Keep a node this chain linked in the hot set, evicting the oldest hot blocks to the cold store once there are more than the limit
+        size_t limit = coldStore.hotLimit(); // Blocks kept in memory
+        if (limit == 0) { // If every block stays in memory
+            return;
+        }
+        hotNodes.push_back(node); // The node is the newest
+        evictOldestBlocks(); // Keep the hot set within the limit
+    }
+
+    void evictOldestBlocks() { // Evict the oldest hot blocks to the cold store until no more than the limit are left
+        size_t limit = coldStore.hotLimit(); // Blocks kept in memory
+        while (limit != 0 && hotNodes.size() > limit) { // While there are too many hot blocks
+            BlockNode* oldest = hotNodes.front(); // Oldest hot node
+            shared_ptr<const Block> block = atomic_load(&oldest->resident); // Its whole block, empty if a copy of the node was already evicted
+            if (block) { // If the block is still in memory
+                uint64_t offset = coldStore.store(*block); // Write it to the cold store
+                if (offset == COLD_NONE) { // If it could not be written
+                    return; // Keep it in memory and try again on the next append
+                }
+                oldest->coldOffset.store(offset, memory_order_release); // Set the offset before the block is emptied, readers that find no block read the offset
+                atomic_store(&oldest->resident, shared_ptr<const Block>()); // Evict the block, a reader still holding it keeps it alive until it is done
+            }
+            hotNodes.pop_front(); // The node is cold
+        }
+    }
+
+    size_t hotBlockCount() const { // Method to get the number of blocks this chain still holds in memory under the cold store limit
+        return hotNodes.size();
+    }
+
+    void storageStatistics() { // Method to show how many blocks are in memory and how well the block cache is working
+        if (coldStore.hotLimit() == 0) { // If nothing is evicted
+            cout << "\nEvery block is kept in memory, start with --hot-blocks <count> to move older blocks to the cold store." << endl;
+            return;
+        }
+        const BlockCache& cache = coldStore.cache; // Cache of the cold store
+        uint64_t hits = cache.hits.load(), misses = cache.misses.load(); // Reads of evicted blocks
+        cout << "\nHot blocks in memory: " << hotNodes.size() << " of " << coldStore.hotLimit() << endl; // Show the hot blocks
+        cout << "Blocks evicted to the cold store: " << coldStore.evicted.load() << " (" << coldStore.bytes() << " bytes)" << endl; // Show the cold blocks
+        cout << "Block cache: " << cache.capacity() << " blocks in " << BLOCK_CACHE_SHARDS << " shards, " << hits << " hit(s), " << misses << " miss(es), hit rate " << (hits + misses == 0 ? 0.0 : 100.0 * hits / (hits + misses)) << "%" << endl; // Show the cache
+        cout << "Read ahead: " << cache.prefetched.load() << " block(s), " << cache.prefetchHits.load() << " used, " << coldStore.coldReads.load() << " read(s) of the cold store, " << cache.evictions.load() << " cache eviction(s)" << endl; // Show the read ahead
+    }
+
+    const BlockNode* current(const BlockNode* node) const { // Method to get the node holding the current version of a linked block, its changed copy if the block was replaced, every read of a block's contents or flags goes through it
+        if (changedNodes->empty()) { // If no block has been changed
+            return node;
+        }
+        unordered_map<int, BlockNode*>::const_iterator changed = changedNodes->find(node->data.blockNumber); // Changed copy of the block
+        return changed == changedNodes->end() ? node : changed->second; // Return the copy or the node
+    }
+
+    vector<const BlockNode*> nodesFrom(int firstBlockNumber) { // Method to get the nodes from the block number passed in up to the newest, oldest first, only the headers kept in memory are read
+        vector<const BlockNode*> nodes; // Declare a vector of the nodes
+        BlockNode* temp = head; // Create a temporary block node and set it to the head of the blockchain
+        while (temp != nullptr && temp->data.blockNumber >= firstBlockNumber && temp->data.blockNumber < currentBlockNumber) { // While loop to traverse the appended blocks down to the first one wanted
+            nodes.push_back(current(temp)); // Add the node, changed if the block was replaced
+            temp = temp->next; // Move to the next block
+        }
+        reverse(nodes.begin(), nodes.end()); // The chain is stored newest first
+        return nodes; // Return the nodes
+    }
+
+    vector<shared_ptr<const Block> > blocksFrom(int firstBlockNumber, size_t maxBlocks = SIZE_MAX) { // Method to get at most maxBlocks blocks from the block number passed in, oldest first, evicted blocks are read back
+        vector<const BlockNode*> nodes = nodesFrom(firstBlockNumber); // Nodes of the blocks
+        vector<shared_ptr<const Block> > blocks; // Declare a vector of the blocks
+        for (size_t i = 0; i < nodes.size() && i < maxBlocks; ++i) { // For loop over the nodes wanted
+            blocks.push_back(blockOf(nodes[i])); // Add the block
+        }
+        return blocks; // Return the blocks
+    }
+
+    void addProcurementInformation(Block& block) { // Add procurement information to the block, called when the user chooses 1
+        string supplierID, supplierName, orderQuantity, orderDate, orderState, shippingDetails; // Declare variables for the supplier ID, supplier name, order quantity, order date, order state, and shipping details
+        bool correctSupplierID = false; // Set the correct supplier ID flag to false
+
+        while (!correctSupplierID) { // While loop to keep asking the user to enter a valid supplier ID
+            cout << "\nEnter Supplier ID (format: SIDxxxxx): "; // Ask the user to enter the supplier ID, the format is string SID followed by 5 digits
+            getline(cin, supplierID); // Get user input for the supplier ID
+
+            if (supplierID.length() == 8 && supplierID.substr(0, 3) == "SID") { // Check if the supplier ID is 8 characters long and starts with "SID"
+                bool validLength = true; // Set the valid flag to true
+                for (int i = 3; i < 8; i++) { // For loop to check if the rest of the characters are digits
+                    if (!isdigit(supplierID[i])) { // If the character is not a digit
+                        validLength = false; // Then set the valid flag to false
+                        break; // Break out of the for loop
+                    }
+                }
+                if (validLength) { // If the valid flag is true
+                    correctSupplierID = true; // Set the correct supplier ID flag to true, this means that the supplier ID is valid
+                }
+            }
+            else { // If the supplier ID is not 8 characters long and does not start with "SID"
+                cout << "Invalid format. Please enter a valid Supplier ID." << endl; // Tell the user that the supplier ID is invalid
+            }
+        }
+
+        cout << "Enter Supplier Name: "; // Ask the user to enter the supplier name
+        getline(cin, supplierName); // Get user input for the supplier name
+
+        bool validOrderQuantity = false; // Set the valid order quantity flag to false
+        while (!validOrderQuantity) { // While loop to keep asking the user to enter a valid order quantity
+            cout << "Enter Order Quantity: "; // Ask the user to enter the order quantity
+            getline(cin, orderQuantity); // Get user input for the order quantity
+ 
+            if (orderQuantity.find_first_not_of("0123456789") == string::npos) { // Check if the order quantity contains only digits, no other characters but digits
+                validOrderQuantity = true; // Set the valid order quantity flag to true, this means that the order quantity is valid
+            } else { // If the order quantity contains characters other than digits
+                cout << "Invalid input. Please enter a valid number for Order Quantity." << endl; // Tell the user that the order quantity is invalid
+            }
+        }
+
+        bool correctOrderDate = false; // Set the correct order date flag to false
+        while (!correctOrderDate) { // While loop to keep asking the user to enter a valid order date
+            cout << "Enter Order Date (format: dd/mm/yy): "; // Ask the user to enter the order date, the format is strictly day/month/year
+            getline(cin, orderDate); // Get user input for the order date
+
+            if (orderDate.length() == 8 && orderDate[2] == '/' && orderDate[5] == '/') { // Check if the order date is 8 characters long and contains "/" at the 3rd and 6th position, no other characters but "/"
+                string dayString = orderDate.substr(0, 2); // Get the day from the order date
+                string monthString = orderDate.substr(3, 2); // Get the month from the order date
+                string yearString = orderDate.substr(6, 2); // Get the year from the order date
+                int day = stoi(dayString); // Convert the day string to an integer
+                int month = stoi(monthString); // Convert the month string to an integer
+                int year = stoi(yearString); // Convert the year string to an integer
+
+                if (day >= 1 && day <= 31 && month >= 1 && month <= 12 && year >= 0 && year >= 24) { // Check that the day is between 1-31, month is between 1-12, and year is after 2024, only valid day month and year
+                    correctOrderDate = true; // Set the correct order date flag to true, this means that the order date is valid
+                }
+            }
+
+            if (!correctOrderDate) { // If the order date is not valid
+                cout << "Invalid format. Please enter a valid Order Date (format: dd/mm/yy) Ensure that year is on or after 2024." << endl; // Tell the user that the order date is invalid, will loop again
+            }
+        }
+
+        bool validOrderState = false; // Set the valid order state flag to false
+
+        while (!validOrderState) { // While loop to keep asking the user to enter a valid order state
+            cout << "Enter Order State (Pending, In Progress, Completed, Cancelled): "; // Ask the user to enter the order state, the options are Pending, In Progress, Completed, Cancelled
+            getline(cin, orderState); // Get user input for the order state
+
+            transform(orderState.begin(), orderState.end(), orderState.begin(), ::tolower); // Convert the order state to lowercase, so that the user can enter the order state in any case, doesnt affect the input
+
+            if (orderState == "pending" || orderState == "in progress" || orderState == "completed" || orderState == "cancelled") { // Check if the order state is one of the valid options, pending, in progress, completed, or cancelled
+                validOrderState = true; // Set the valid order state flag to true, this means that the order state is valid
+            }
+            else { // If the order state is not one of the valid options
+                cout << "Invalid status. Please enter 'Pending', 'In Progress', 'Completed', 'Cancelled'." << endl; // Tell the user that the order state is invalid
+            }
+        }
+
+        cout << "Enter Shipping Details: "; // Ask the user to enter the shipping details
+        getline(cin, shippingDetails); // Get user input for the shipping details
+
+        block.information.push_back(make_pair("Block", "Procurement Information")); // Add the block name and block type to the block information
+        block.information.push_back(make_pair("Supplier ID", supplierID)); // Add the supplier ID to the block information
+        block.information.push_back(make_pair("Supplier Name", supplierName)); // Add the supplier name to the block information
+        block.information.push_back(make_pair("Order Quantity", orderQuantity)); // Add the order quantity to the block information
+        block.information.push_back(make_pair("Order Date", orderDate)); // Add the order date to the block information
+        block.information.push_back(make_pair("Order State", orderState)); // Add the order state to the block information
+        block.information.push_back(make_pair("Shipping Details", shippingDetails)); // Add the shipping details to the block information
+
+        cout << "\n\nProcurement Information Block Successfully Added.\n"; // Tell the user that the procurement information block has been successfully added, and the information has been stored in the block, block now has the information
+    }
+
+    void addInventoryInformation(Block& block) { // Function to add inventory information to the block
+        string warehouseID, storageLocation, inventoryQuantity, inventoryStatus; // Declare the variables for the warehouse ID, storage location, inventory quantity, and inventory status
+        int storageLocationId = -1; // ID of the storage location in the valid locations
+        bool correctWarehouseID = false; // Set the correct warehouse ID flag to false
+
+        while (!correctWarehouseID) { // While loop to keep asking the user to enter a valid warehouse ID
+            cout << "\nEnter Warehouse ID (format: WIDxxxxx): "; // Ask the user to enter the warehouse ID, the format is strictly WID followed by 5 digits
+            getline(cin, warehouseID); // Get user input for the warehouse ID
+
+            if (warehouseID.length() == 8 && warehouseID.substr(0, 3) == "WID") { // Check if the warehouse ID is 8 characters long and starts with WID, no other characters but WID and 5 digits
+                bool validLength = true; // Set the valid flag to true, this means that the warehouse ID is valid
+                for (int i = 3; i < 8; i++) { // For loop to check the 5 digits of the warehouse ID
+                    if (!isdigit(warehouseID[i])) { // If the character is not a digit
+                        validLength = false; // Set the valid flag to false, this means that the warehouse ID is invalid
+                        break; // Break the for loop, no need to check the rest of the digits
+                    }
+                }
+                if (validLength) { // If the warehouse ID is valid
+                    correctWarehouseID = true; // Set the correct warehouse ID flag to true, this means that the warehouse ID is valid
+                }
+            }
+            else { // If the warehouse ID is not valid
+                cout << "Invalid format. Please enter a valid Warehouse ID." << endl; // Tell the user that the warehouse ID is invalid, will loop again
+            }
+        }
+
+        if (!loadLocations()) { // Load the valid locations, the file name is valid_locations.txt
+            cout << "Error: Unable to open valid locations file." << endl; // Tell the user that the file is not open, file is not found
+            return; // Return from the function
+        }
+
+        bool validStorageLocation = false; // Set the valid storage location flag to false
+
+        while (!validStorageLocation) { // While loop to keep asking the user to enter a valid storage location
+            cout << "Enter Storage Location (format: city, state, end with * to list matches): "; // Ask the user to enter the storage location, the format is city, state
+            getline(cin, storageLocation); // Get user input for the storage location
+
+            validStorageLocation = isValidLocation(storageLocation, storageLocationId); // Call the isValidLocation function to check if the storage location is valid and get its ID
+
+            if (!validStorageLocation && !listLocations(storageLocation)) { // If the storage location is not valid
+                cout << "Invalid format. Please enter a valid location in the format 'city, state'." << endl; // Tell the user that the storage location is invalid, will loop again
+            }
+        }
+
+        bool validInventoryQuantity = false; // Set the valid inventory quantity flag to false
+        while (!validInventoryQuantity) { // While loop to keep asking the user to enter a valid inventory quantity
+            cout << "Enter Inventory Quantity: "; // Ask the user to enter the inventory quantity
+            getline(cin, inventoryQuantity); // Get user input for the inventory quantity
+
+            if (inventoryQuantity.find_first_not_of("0123456789") == string::npos) { // Check if the inventory quantity contains only digits, no other characters
+                validInventoryQuantity = true; // Set the valid inventory quantity flag to true, this means that the inventory quantity is valid
+            } else {
+                cout << "Invalid input. Please enter a valid number for Inventory Quantity." << endl; // Tell the user that the inventory quantity is invalid, will loop again
+            }
+        }
+
+        bool validInventoryStatus = false; // Set the valid inventory status flag to false
+        while (!validInventoryStatus) { // While loop to keep asking the user to enter a valid inventory status
+            cout << "Enter Inventory Status (Available, Low Stock, or Not Available): "; // Ask the user to enter the inventory status, the options are available, low stock, or not available
+            getline(cin, inventoryStatus); // Get user input for the inventory status
+
+            transform(inventoryStatus.begin(), inventoryStatus.end(), inventoryStatus.begin(), ::tolower); // Convert the inventory status to lowercase
+
+            if (inventoryStatus == "available" || inventoryStatus == "low stock" || inventoryStatus == "not available") { // Check if the inventory status is available, low stock, or not available
+                validInventoryStatus = true; // Set the valid inventory status flag to true, this means that the inventory status is valid
+            } 
+            else { // If the inventory status is not valid
+                cout << "Invalid status. Please enter 'Available', 'Low Stock', or 'Not Available'." << endl; // Tell the user that the inventory status is invalid, will loop again
+            }
+        }
+
+        block.information.push_back(make_pair("Block", "Inventory Information")); // Add the inventory information block to the block
+        block.information.push_back(make_pair("Warehouse ID", warehouseID)); // Add the warehouse ID to the block
+        block.information.push_back(make_pair("Storage Location", storageLocation)); // Add the storage location to the block
+        block.information.push_back(make_pair("Storage Location ID", to_string(storageLocationId))); // Add the ID of the storage location to the block
+        block.information.push_back(make_pair("Inventory Quantity", inventoryQuantity)); // Add the inventory quantity to the block
+        block.information.push_back(make_pair("Inventory Status", inventoryStatus)); // Add the inventory status to the block
+
+        cout << "\n\nInventory Information Block Successfully Added.\n"; // Tell the user that the inventory information block is successfully added
+    }
+
+    void addOrderFulfillmentInformation(Block& block) { // Function to add order fulfillment information to the block
+        string customerID, orderQuantityF, orderDateF, orderStateF, shippingDetailsF; // Declare strings to store the customer ID, order quantity, order date, order state, and shipping details
+
+        bool correctCustomerID = false; // Set the correct customer ID flag to false
+
+        while (!correctCustomerID) { // While loop to keep asking the user to enter a valid customer ID
+            cout << "\nEnter Customer ID (format: CIDxxxxx): "; // Ask the user to enter the customer ID, the format is CID followed by 5 digits
+            getline(cin, customerID); // Get user input for the customer ID
+
+            if (customerID.length() == 8 && customerID.substr(0, 3) == "CID") { // Check if the customer ID is 8 characters long and starts with CID
+                bool validLength = true; // Set the valid flag to true
+                for (int i = 3; i < 8; i++) { // For loop to check if the rest of the customer ID contains only digits
+                    if (!isdigit(customerID[i])) { // If the character is not a digit
+                        validLength = false; // Set the valid flag to false
+                        break; // Break from the for loop
+                    }
+                }
+                if (validLength) { // If the customer ID is valid
+                    correctCustomerID = true; // Set the correct customer ID flag to true, this means that the customer ID is valid
+                }
+            }
+            else { // If the customer ID is not valid
+                cout << "Invalid format. Please enter a valid Customer ID." << endl; // Tell the user that the customer ID is invalid, will loop again
+            }
+        }
+
+        bool validOrderQuantityF = false; // Set the valid order quantity flag to false
+        while (!validOrderQuantityF) { // While loop to keep asking the user to enter a valid order quantity
+            cout << "Enter Order Quantity: "; // Ask the user to enter the order quantity
+            getline(cin, orderQuantityF); // Get user input for the order quantity
+
+            if (orderQuantityF.find_first_not_of("0123456789") == string::npos) { // Check if the order quantity contains only digits, no other characters, only digits
+                validOrderQuantityF = true; // Set the valid order quantity flag to true, this means that the order quantity is valid
+            } else { // If the order quantity is not valid
+                cout << "Invalid input. Please enter a valid number for Order Quantity." << endl; // Tell the user that the order quantity is invalid, will loop again
+            }
+        }
+
+        bool correctOrderDateF = false; // Set the correct order date flag to false
+        while (!correctOrderDateF) { // While loop to keep asking the user to enter a valid order date
+            cout << "Enter Order Date (format: dd/mm/yy): "; // Ask the user to enter the order date, the format is dd/mm/yy
+            getline(cin, orderDateF); // Get user input for the order date
+ 
+            if (orderDateF.length() == 8 && orderDateF[2] == '/' && orderDateF[5] == '/') { // Check if the order date is 8 characters long and contains / at the 3rd and 6th position, no other characters
+                string dayString = orderDateF.substr(0, 2); // Extract the day, month, and year from the order date
+                string monthString = orderDateF.substr(3, 2); // Extract the day, month, and year from the order date
+                string yearString = orderDateF.substr(6, 2); // Extract the day, month, and year from the order date
+                int day = stoi(dayString); // Convert the day, month, and year to integers 
+                int month = stoi(monthString); // Convert the day, month, and year to integers
+                int year = stoi(yearString); // Convert the day, month, and year to integers
+
+                if (day >= 1 && day <= 31 && month >= 1 && month <= 12 && year >= 0 && year >= 24) { // Check if the day, month, and year are valid and year is after 2024
+                    correctOrderDateF = true; // Set the correct order date flag to true, this means that the order date is valid
+                }
+            }
+ 
+            if (!correctOrderDateF) { // If the order date is not valid
+                cout << "Invalid format. Please enter a valid Order Date (format: dd/mm/yy) Ensure that year is on or after 2024." << endl; // Tell the user that the order date is invalid, will loop again
+            }
+        }
+
+        bool validOrderState = false; // Set the valid order state flag to false
+        while (!validOrderState) { // While loop to keep asking the user to enter a valid order state
+            cout << "Enter Order State (Pending, In Progress, Completed, Cancelled): "; // Ask the user to enter the order state, the options are Pending, In Progress, Completed, Cancelled
+            getline(cin, orderStateF); // Get user input for the order state
+
+            transform(orderStateF.begin(), orderStateF.end(), orderStateF.begin(), ::tolower); // Convert the order state to lowercase
+
+            if (orderStateF == "pending" || orderStateF == "in progress" || orderStateF == "completed" || orderStateF == "cancelled") { // Check if the order state is valid
+                validOrderState = true; // Set the valid order state flag to true, this means that the order state is valid
+            }
+            else { // If the order state is not valid
+                cout << "Invalid status. Please enter 'Pending', 'In Progress', 'Completed', 'Cancelled'." << endl; // Tell the user that the order state is invalid, will loop again
+            }
+        }
+
+        cout << "Enter Shipping Details: "; // Ask the user to enter the shipping details
+        getline(cin, shippingDetailsF); // Get user input for the shipping details
+
+        block.information.push_back(make_pair("Block", "Order Fulfillment Information")); // Add the order fulfillment information block to the block information vector
+        block.information.push_back(make_pair("Customer ID", customerID)); // Add the customer ID to the block information vector
+        block.information.push_back(make_pair("Order Quantity", orderQuantityF)); // Add the order quantity to the block information vector
+        block.information.push_back(make_pair("Order Date", orderDateF)); // Add the order date to the block information vector
+        block.information.push_back(make_pair("Order State", orderStateF)); // Add the order state to the block information vector
+        block.information.push_back(make_pair("Shipping Details", shippingDetailsF)); // Add the shipping details to the block information vector
+
+        cout << "\n\nOrder Fulfillment Information Block Successfully Added.\n"; // Tell the user that the order fulfillment information block has been successfully added
+    }
+
+    void addTransportationInformation(Block& block) { // Function to add transportation information to the block
+        string transportationMode, transportationCompany, transportationRouteFrom, transportationRouteTo, transportationDepartureDateTime, transportationEstimatedArrivalDateTime; // Declare variables for the transportation information, variables declared are transportation mode, transportation company, transportation route from, transportation route to, transportation departure date and time, and transportation estimated arrival date and time
+        bool validTransportationMode = false; // Set the valid transportation mode flag to false
+
+        while (!validTransportationMode) { // While loop to keep asking the user to enter a valid transportation mode
+            cout << "\nEnter Transportation Mode (Road, Rail, Sea, Air): "; // Ask the user to enter the transportation mode, the options are Road, Rail, Sea, Air
+            getline(cin, transportationMode); // Get user input for the transportation mode
+
+            transform(transportationMode.begin(), transportationMode.end(), transportationMode.begin(), ::tolower); // Convert the transportation mode to lowercase
+
+            if (transportationMode == "road" || transportationMode == "rail" || transportationMode == "sea" || transportationMode == "air") { // Check if the transportation mode is valid
+                validTransportationMode = true; // Set the valid transportation mode flag to true, this means that the transportation mode is valid
+            }
+            else { // If the transportation mode is not valid
+                cout << "Invalid status. Please enter 'Road', 'Rail', 'Sea', 'Air" << endl; // Tell the user that the transportation mode is invalid, will loop again
+            }
+        }
+
+        cout << "Enter Transportation Company: "; // Ask the user to enter the transportation company
+        getline(cin, transportationCompany); // Get user input for the transportation company
+
+        if (!loadLocations()) { // Load the valid locations
+            cout << "Error: Unable to open valid locations file." << endl; // Tell the user that the valid locations file cannot be opened
+            return; // Return from the function
+        }
+
+        int transportationRouteFromId = -1; // ID of the location the route starts from
+        int transportationRouteToId = -1; // ID of the location the route ends at
+        cout << "Enter Transportation Route: "; // Ask the user to enter the transportation route
+        bool validTransportationRouteFrom = false; // Set the valid transportation route from flag to false
+        while (!validTransportationRouteFrom) { // While loop to keep asking the user to enter a valid transportation route from
+            cout << "\nFrom (format: city, state, end with * to list matches): "; // Ask the user to enter the transportation route from, the format is: city, state
+            getline(cin, transportationRouteFrom); // Get user input for the transportation route from
+
+            validTransportationRouteFrom = isValidLocation(transportationRouteFrom, transportationRouteFromId); // Check if the transportation route from is valid and get its IFrom
+
+            if (!validTransportationRouteFrom && !listLocations(transportationRouteFrom)) { // If the transportation route from is not valid
+                cout << "Invalid format. Please enter a valid location in the format 'city, state'." << endl; // Tell the user that the transportation route from is invalid, will loop again
+            }
+        }
+        
+        bool validTransportationRouteTo = false; // Set the valid transportation route to flag to false
+        while (!validTransportationRouteTo) { // While loop to keep asking the user to enter a valid transportation route to
+            cout << "To (format: city, state, end with * to list matches): "; // Ask the user to enter the transportation route to, the format is: city, state
+            getline(cin, transportationRouteTo); // Get user input for the transportation route to
+
+            validTransportationRouteTo = isValidLocation(transportationRouteTo, transportationRouteToId); // Check if the transportation route to is valid and get its ITo
+
+            if (!validTransportationRouteTo && !listLocations(transportationRouteTo)) { // If the transportation route to is not valid
+                cout << "Invalid format. Please enter a valid location in the format 'city, state'." << endl; // Tell the user that the transportation route to is invalid, will loop again
+            }
+        }
+
+        bool correctTransportationDepartureDate = false; // Set the correct transportation departure date flag to false
+        while (!correctTransportationDepartureDate) { // While loop to keep asking the user to enter a valid transportation departure date
+            cout << "Enter Transportation Departure Date (format: dd/mm/yy): "; // Ask the user to enter the transportation departure date, the format is: dd/mm/yy
+            getline(cin, transportationDepartureDateTime); // Get user input for the transportation departure date
+
+            if (transportationDepartureDateTime.length() == 8 && transportationDepartureDateTime[2] == '/' && transportationDepartureDateTime[5] == '/') { // Check if the transportation departure date is in the correct format
+                string dayString = transportationDepartureDateTime.substr(0, 2); // Get the day from the transportation departure date
+                string monthString = transportationDepartureDateTime.substr(3, 2); // Get the month from the transportation departure date
+                string yearString = transportationDepartureDateTime.substr(6, 2); // Get the year from the transportation departure date
+                int day = stoi(dayString); // Convert the day string to an integer
+                int month = stoi(monthString); // Convert the month string to an integer
+                int year = stoi(yearString); // Convert the year string to an integer
+
+                if (day >= 1 && day <= 31 && month >= 1 && month <= 12 && year >= 0 && year >= 24) { // Check if the day, month, and year are valid, the day must be between 1 and 31, the month must be between 1 and 12, and the year must be between 0 and 99
+                    correctTransportationDepartureDate = true; // Set the correct transportation departure date flag to true, this means that the transportation departure date is valid
+                }
+            }
+
+            if (!correctTransportationDepartureDate) { // If the transportation departure date is not valid
+                cout << "Invalid format. Please enter a valid Order Date (format: dd/mm/yy) Ensure that year is on or after 2024." << endl; // Tell the user that the transportation departure date is invalid, will loop again
+            }
+        }
+
+        bool correctTransportationArrivalDate = false; // Set the correct transportation arrival date flag to false
+        while (!correctTransportationArrivalDate) { // While loop to keep asking the user to enter a valid transportation arrival date
+            cout << "Enter Transportation Estimated Arrival Date (format: dd/mm/yy): "; // Ask the user to enter the transportation estimated arrival date, the format is: dd/mm/yy
+            getline(cin, transportationEstimatedArrivalDateTime); // Get user input for the transportation estimated arrival date
+
+            if (transportationEstimatedArrivalDateTime.length() == 8 && transportationEstimatedArrivalDateTime[2] == '/' && transportationEstimatedArrivalDateTime[5] == '/') { // Check if the transportation estimated arrival date is in the correct format
+                string dayString = transportationEstimatedArrivalDateTime.substr(0, 2); // Get the day from the transportation estimated arrival date
+                string monthString = transportationEstimatedArrivalDateTime.substr(3, 2); // Get the month from the transportation estimated arrival date
+                string yearString = transportationEstimatedArrivalDateTime.substr(6, 2); // Get the year from the transportation estimated arrival date
+                int day = stoi(dayString); // Convert the day string to an integer
+                int month = stoi(monthString); // Convert the month string to an integer
+                int year = stoi(yearString); // Convert the year string to an integer
+
+                if (day >= 1 && day <= 31 && month >= 1 && month <= 12 && year >= 0 && year >= 24) { // Check if the day, month, and year are valid, the day must be between 1 and 31, the month must be between 1 and 12, and the year must be between 0 and 99
+                    // Check if the arrival date is equal to or after the departure date
+                    if (year > stoi(transportationDepartureDateTime.substr(6, 2)) ||
+                        (year == stoi(transportationDepartureDateTime.substr(6, 2)) && month > stoi(transportationDepartureDateTime.substr(3, 2))) ||
+                        (year == stoi(transportationDepartureDateTime.substr(6, 2)) && month == stoi(transportationDepartureDateTime.substr(3, 2)) && day >= stoi(transportationDepartureDateTime.substr(0, 2)))) {
+                        correctTransportationArrivalDate = true; // Set the correct transportation arrival date flag to true, this means that the transportation arrival date is valid
+                    } else {
+                        cout << "Invalid arrival date. Arrival date must be equal to or after the departure date." << endl; // Tell the user that the transportation arrival date is invalid, will loop again
+                    }
+                }
+            }
+
+            if (!correctTransportationArrivalDate) { // If the transportation arrival date is not valid
+                cout << "Invalid format. Please enter a valid Order Date (format: dd/mm/yy) Ensure that year is on or after 2024." << endl; // Tell the user that the transportation arrival date is invalid, will loop again
+            }
+        }
+        
+        block.information.push_back(make_pair("Block", "Transportation Information")); // Add the transportation information block to the block information
+        block.information.push_back(make_pair("Transportation Mode", transportationMode)); // Add the transportation mode to the block information
+        block.information.push_back(make_pair("Transportation Company", transportationCompany)); // Add the transportation company to the block information
+        block.information.push_back(make_pair("Transportation Route", transportationRouteFrom + " to " + transportationRouteTo)); // Add the transportation route to the block information
+        block.information.push_back(make_pair("Transportation Route From ID", to_string(transportationRouteFromId))); // Add the ID of the location the route starts from
+        block.information.push_back(make_pair("Transportation Route To ID", to_string(transportationRouteToId))); // Add the ID of the location the route ends at
+        block.information.push_back(make_pair("Transportation Departure Date", transportationDepartureDateTime)); // Add the transportation departure date to the block information
+        block.information.push_back(make_pair("Transportation Estimated Arrival Date", transportationEstimatedArrivalDateTime)); // Add the transportation estimated arrival date to the block information
+
+        cout << "\n\nTransportation Information Block Successfully Added.\n"; // Tell the user that the transportation information block has been successfully added
+    }
+
+    string expectedProductWorthiness; // Declare a string to store the expected product worthiness value
+
+    void addCustomerDeliverySatisfactionInformation(Block& block) { // Function to add the customer delivery satisfaction information to the block
+        string deliveryConfirmation, customerFeedbackCollection, satisfactionSurvey; // Declare strings to store the delivery confirmation, customer feedback collection, and satisfaction survey values
+
+        bool validDeliveryConfirmation = false; // Set the valid delivery confirmation flag to false
+ 
+        while (!validDeliveryConfirmation) { // While loop to keep asking the user to enter a valid delivery confirmation
+            cout << "\nEnter Delivery Confirmation (format: Delivered, Unsuccessful, Rescheduled): "; // Ask the user to enter the delivery confirmation, the format is: Delivered, Unsuccessful, Rescheduled
+            getline(cin, deliveryConfirmation); // Get user input for the delivery confirmation
+
+            transform(deliveryConfirmation.begin(), deliveryConfirmation.end(), deliveryConfirmation.begin(), ::tolower); // Convert the delivery confirmation to lowercase
+
+            if (deliveryConfirmation == "delivered" || deliveryConfirmation == "unsuccessful" || deliveryConfirmation == "rescheduled") { // Check if the delivery confirmation is valid, the delivery confirmation must be: Delivered, Unsuccessful, Rescheduled
+                validDeliveryConfirmation = true; // Set the valid delivery confirmation flag to true, this means that the delivery confirmation is valid
+            }
+            else { // If the delivery confirmation is not valid
+                cout << "Invalid status. Please enter 'Delivered', 'Unsuccessful', 'Rescheduled'." << endl; // Tell the user that the delivery confirmation is invalid, will loop again
+            }
+        }
+
+        bool validCustomerFeedbackConfirmation = false; // Set the valid customer feedback confirmation flag to false
+
+        while (!validCustomerFeedbackConfirmation) { // While loop to keep asking the user to enter a valid customer feedback collection
+            cout << "Enter Customer Feedback Collection Result (format: Excellent, Good, Average, Poor): "; // Ask the user to enter the customer feedback collection result, the format is: Excellent, Good, Average, Poor
+            getline(cin, customerFeedbackCollection); // Get user input for the customer feedback collection
+
+            transform(customerFeedbackCollection.begin(), customerFeedbackCollection.end(), customerFeedbackCollection.begin(), ::tolower); // Convert the customer feedback collection to lowercase
+ 
+            if (customerFeedbackCollection == "excellent" || customerFeedbackCollection == "good" || customerFeedbackCollection == "average" || customerFeedbackCollection == "poor") { // Check if the customer feedback collection is valid, the customer feedback collection must be: Excellent, Good, Average, Poor
+                validCustomerFeedbackConfirmation = true; // Set the valid customer feedback confirmation flag to true, this means that the customer feedback collection is valid
+            }
+            else { // If the customer feedback collection is not valid
+                cout << "Invalid status. Please enter 'Excellent', 'Good', 'Average', 'Poor'." << endl; // Tell the user that the customer feedback collection is invalid, will loop again
+            }
+        }
+
+        bool correctSatisfactionSurvey = false; // Set the correct satisfaction survey flag to false
+        while (!correctSatisfactionSurvey) { // While loop to keep asking the user to enter a valid satisfaction survey
+            cout << "Enter Satisfaction Survey Result (format: 1-10): "; // Ask the user to enter the satisfaction survey result, the format is: 1-10
+            getline(cin, satisfactionSurvey); // Get user input for the satisfaction survey
+
+            try { // Try to convert the satisfaction survey to an integer
+                int surveyResult = stoi(satisfactionSurvey); // Convert the satisfaction survey to an integer
+                if (surveyResult >= 1 && surveyResult <= 10) { // Check if the satisfaction survey is valid, the satisfaction survey must be between 1 and 10
+                    correctSatisfactionSurvey = true; // Set the correct satisfaction survey flag to true, this means that the satisfaction survey is valid
+                } else { // If the satisfaction survey is not valid
+                    cout << "Invalid input. Please enter a number between 1 and 10." << endl; // Tell the user that the satisfaction survey is invalid, will loop again
+                }
+            } catch (...) { // Catch any errors
+                cout << "Invalid input. Please enter a number between 1 and 10." << endl; // Tell the user that the satisfaction survey is invalid, will loop again
+            } 
+            expectedProductWorthiness = satisfactionSurvey; // Set the expected product worthiness to the satisfaction survey
+        }
+
+        block.information.push_back(make_pair("Block", "Customer Delivery Satisfactory Information")); // Add the customer delivery satisfactory information block to the block information
+        block.information.push_back(make_pair("Delivery Confirmation", deliveryConfirmation)); // Add the delivery confirmation to the block information
+        block.information.push_back(make_pair("Customer Feedback Collection", customerFeedbackCollection)); // Add the customer feedback collection to the block information
+        block.information.push_back(make_pair("Satisfaction Survey", satisfactionSurvey)); // Add the satisfaction survey to the block information
+
+        cout << "\n\nCustomer Delivery Satisfactory Information Block Successfully Added.\n"; // Tell the user that the customer delivery satisfactory information block has been successfully added
+    }
+
+    void addQualityInspectionControlInformation(Block& block) { // Function to add the quality inspection control information to the block
+        string productInspectionDetails, productQuality; // Declare strings to store the product inspection details and product quality values
+
+        bool validproductInspectionDetails = false; // Set the valid product inspection details flag to false
+
+        while(validproductInspectionDetails == false) { // While loop to keep asking the user to enter a valid product inspection details
+            cout << "\nEnter Product Quality Inspection Result (format: Pass, Fail): "; // Ask the user to enter the product inspection details, the format is: Pass, Fail
+            getline(cin, productInspectionDetails); // Get user input for the product inspection details
+
+            transform(productInspectionDetails.begin(), productInspectionDetails.end(), productInspectionDetails.begin(), ::tolower); // Convert the product inspection details to lowercase
+            if(productInspectionDetails == "pass" || productInspectionDetails == "fail") { // Check if the product inspection details is valid, the product inspection details must be: Pass, Fail
+                validproductInspectionDetails = true; // Set the valid product inspection details flag to true, this means that the product inspection details is valid
+            } else { // If the product inspection details is not valid
+                cout << "Invalid status. Please enter 'Pass', 'Fail'." << endl; // Tell the user that the product inspection details is invalid, will loop again
+            }
+        }
+
+        bool validProductQuality = false; // Set the valid product quality flag to false
+
+        while(validProductQuality == false) { // While loop to keep asking the user to enter a valid product quality
+            cout << "Enter Product Quality (format: Excellent, Good, Average, Poor): "; // Ask the user to enter the product quality, the format is: Excellent, Good, Average, Poor
+            getline(cin, productQuality); // Get user input for the product quality
+
+            transform(productQuality.begin(), productQuality.end(), productQuality.begin(), ::tolower); // Convert the product quality to lowercase
+            if(productQuality == "excellent" || productQuality == "good" || productQuality == "average" || productQuality == "poor") { // Check if the product quality is valid, the product quality must be: Excellent, Good, Average, Poor
+                validProductQuality = true; // Set the valid product quality flag to true, this means that the product quality is valid
+            } else { // If the product quality is not valid
+                cout << "Invalid status. Please enter 'Excellent', 'Good', 'Average', 'Poor'." << endl; // Tell the user that the product quality is invalid, will loop again
+            }
+        }
+
+        block.information.push_back(make_pair("Block", "Quality Inspection Control Information")); // Add the quality inspection control information block to the block information
+        block.information.push_back(make_pair("Quality Inspection Result", productInspectionDetails)); // Add the product inspection details to the block information
+        block.information.push_back(make_pair("Product Quality", productQuality)); // Add the product quality to the block information
+
+        cout << "\n\nQuality Inspection Control Information Block Successfully Added.\n"; // Tell the user that the quality inspection control information block has been successfully added
+    }
+
+    void addProductReturnInformation(Block& block) { // Function to add the product return information to the block
+        string productReturnStatus, productReturnReason, productRefundStatus; // Declare strings to store the product return status, product return reason and product refund status values
+
+        bool validProductReturnStatus = false; // Set the valid product return status flag to false
+
+        while(validProductReturnStatus == false) { // While loop to keep asking the user to enter a valid product return status
+            cout << "\nEnter Product Return Status (format: Returned, Not Returned): "; // Ask the user to enter the product return status, the format is: Returned, Not Returned
+            getline(cin, productReturnStatus); // Get user input for the product return status
+
+            transform(productReturnStatus.begin(), productReturnStatus.end(), productReturnStatus.begin(), ::tolower); // Convert the product return status to lowercase
+            if(productReturnStatus == "returned" || productReturnStatus == "not returned") { // Check if the product return status is valid, the product return status must be: Returned, Not Returned
+                validProductReturnStatus = true; // Set the valid product return status flag to true, this means that the product return status is valid
+            } else { // If the product return status is not valid
+                cout << "Invalid status. Please enter 'Returned', 'Not Returned'." << endl; // Tell the user that the product return status is invalid, will loop again
+            }
+        }
+
+        bool validProductRefundStatus = false; // Set the valid product refund status flag to false
+
+        while(validProductRefundStatus == false) { // While loop to keep asking the user to enter a valid product refund status
+            cout << "Enter Product Refund Status (format: Refunded, Not Refunded): "; // Ask the user to enter the product refund status, the format is: Refunded, Not Refunded
+            getline(cin, productRefundStatus); // Get user input for the product refund status
+
+            transform(productRefundStatus.begin(), productRefundStatus.end(), productRefundStatus.begin(), ::tolower); // Convert the product refund status to lowercase
+            if(productRefundStatus == "refunded" || productRefundStatus == "not refunded") { // Check if the product refund status is valid, the product refund status must be: Refunded, Not Refunded
+                validProductRefundStatus = true; // Set the valid product refund status flag to true, this means that the product refund status is valid
+            } else { // If the product refund status is not valid
+                cout << "Invalid status. Please enter 'Refunded', 'Not Refunded'." << endl; // Tell the user that the product refund status is invalid, will loop again
+            }
+        }
+
+        cout << "Enter Product Return Reason: "; // Ask the user to enter the product return reason
+        getline(cin, productReturnReason); // Get user input for the product return reason
+
+        string productReturnNumber = "R" + to_string(rand() % 90000 + 10000); // Generate a random product return number
+
+        block.information.push_back(make_pair("Block", "Product Returns Information")); // Add the product returns information block to the block information
+        block.information.push_back(make_pair("Product Return Number", productReturnNumber)); // Add the product return number to the block information
+        block.information.push_back(make_pair("Product Return Status", productReturnStatus)); // Add the product return status to the block information
+        block.information.push_back(make_pair("Product Return Reason", productReturnReason)); // Add the product return reason to the block information
+
+        cout << "\n\nProduct Returns Information Block Successfully Added.\n"; // Tell the user that the product returns information block has been successfully added
+    }
+ 
+    void addProductWorthinessInformation(Block& block) { // Function to add the product worthiness information to the block
+        string productWorthinessStatus, productWorthinessReason; // Declare strings to store the product worthiness status and product worthiness reason values
+
+        bool validProductWorthinessStatus = false; // Set the valid product worthiness status flag to false
+ 
+        while (!validProductWorthinessStatus) { // While loop to keep asking the user to enter a valid product worthiness status
+            cout << "\nEnter Product Worthiness Status (format: Continue Product, Discontinue Product): "; // Ask the user to enter the product worthiness status, the format is: Continue Product, Discontinue Product
+            getline(cin, productWorthinessStatus); // Get user input for the product worthiness status
+
+            transform(productWorthinessStatus.begin(), productWorthinessStatus.end(), productWorthinessStatus.begin(), ::tolower); // Convert the product worthiness status to lowercase
+            if (productWorthinessStatus == "continue product" || productWorthinessStatus == "discontinue product") { // Check if the product worthiness status is valid, the product worthiness status must be: Continue Product, Discontinue Product
+                validProductWorthinessStatus = true; // Set the valid product worthiness status flag to true, this means that the product worthiness status is valid
+            } else { // If the product worthiness status is not valid
+                cout << "Invalid status. Please enter 'Continue Product', 'Discontinue Product'." << endl; // Tell the user that the product worthiness status is invalid, will loop again
+            }
+        }
+
+        cout << "Enter Product Worthiness Reason: "; // Ask the user to enter the product worthiness reason
+        getline(cin, productWorthinessReason); // Get user input for the product worthiness reason
+
+        bool correctProductWorthiness = false; // Set the correct product worthiness flag to false
+        while (!correctProductWorthiness) { // While loop to keep asking the user to confirm the product worthiness status
+            string userInput; // Declare a string to store the user input
+            cout << "Based on the customer feedback number, the expected product worthiness is '" << expectedProductWorthiness << "'. Enter 'confirm' to proceed or 'reenter' to re-enter the product worthiness status: "; // Ask the user to confirm the product worthiness status, it uses the productworthiness variable to display the expected product worthiness
+            getline(cin, userInput); // Get user input for the product worthiness status confirmation
+
+            transform(userInput.begin(), userInput.end(), userInput.begin(), ::tolower); // Convert the user input to lowercase
+            if (userInput == "confirm") { // If the user input is confirm
+                correctProductWorthiness = true; // Set the correct product worthiness flag to true, this means that the product worthiness status is correct
+            } else if (userInput == "reenter") { // If the user input is reenter
+                cout << "\nEnter Product Worthiness Status (format: Continue Product, Discontinue Product): "; // Ask the user to re-enter the product worthiness status, the format is: Continue Product, Discontinue Product
+                getline(cin, productWorthinessStatus); // Get user input for the product worthiness status
+
+                transform(productWorthinessStatus.begin(), productWorthinessStatus.end(), productWorthinessStatus.begin(), ::tolower); // Convert the product worthiness status to lowercase
+                if (productWorthinessStatus == "continue product" || productWorthinessStatus == "discontinue product") { // Check if the product worthiness status is valid, the product worthiness status must be: Continue Product, Discontinue Product
+                    validProductWorthinessStatus = true; // Set the valid product worthiness status flag to true, this means that the product worthiness status is valid
+                } else { // If the product worthiness status is not valid
+                    cout << "Invalid status. Please enter 'Continue Product', 'Discontinue Product'." << endl; // Tell the user that the product worthiness status is invalid, will loop again
+                }
+            } else { // If the user input is not confirm or reenter
+                cout << "Invalid input. Please enter 'confirm' or 'reenter'." << endl; // Tell the user that the input is invalid, will loop again
+            }
+        }
+
+        block.information.push_back(make_pair("Block", "Product Worthiness Information")); // Add the product worthiness information block to the block information
+        block.information.push_back(make_pair("Product Worthiness Status", productWorthinessStatus)); // Add the product worthiness status to the block information
+        block.information.push_back(make_pair("Product Worthiness Reason", productWorthinessReason)); // Add the product worthiness reason to the block information
+
+        cout << "\n\nProduct Worthiness Information Block Successfully Added.\n"; // Tell the user that the product worthiness information block has been successfully added
+    }
+
+    string generateRandomHash() { // Function to generate a random hash
+        thread_local mt19937 generator(random_device{}()); // Random number generator of this thread, so shards appending on different threads never share one
+        string chars = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789"; // Declare a string of characters to use for the random hash
+        string randHash = ""; // Declare a string to store the random hash
+        for (int i = 0; i < 20; i++) { // For loop to generate the random hash, loop 20 times
+            int index = static_cast<int>(generator() % chars.size()); // Generate a random index
+            randHash += chars[index]; // Add the character at the random index to the random hash
+        }
+        return randHash; // Return the random hash
     }
+ 
+    void exportBlocksToFile(const string& filename) { // Function to export the blockchain to a file
+        ofstream outfile(filename); // Create an output file stream with the filename
+        if (!outfile.is_open()) { // If the file is not open
+            cout << "Error: Unable to open file for writing." << endl; // Tell the user that there was an error opening the file
+            return; // Return from the function
+        }
 
-    void addProcurementInformation(Block& block) { // Add procurement information to the block, called when the user chooses 1
-        string supplierID, supplierName, orderQuantity, orderDate, orderState, shippingDetails; // Declare variables for the supplier ID, supplier name, order quantity, order date, order state, and shipping details
-        bool correctSupplierID = false; // Set the correct supplier ID flag to false
+        BlockNode* temp = head; // Create a temporary block node and set it to the head of the blockchain, this will be used to traverse the blockchain to export the blocks to the file
+        while (temp != nullptr) { // While loop to traverse the blockchain
+            outfile << formatBlock(*blockOf(current(temp))); // Write the block to the file
+            temp = temp->next; // Move to the next block
+        }
 
-        while (!correctSupplierID) { // While loop to keep asking the user to enter a valid supplier ID
-            cout << "\nEnter Supplier ID (format: SIDxxxxx): "; // Ask the user to enter the supplier ID, the format is string SID followed by 5 digits
-            getline(cin, supplierID); // Get user input for the supplier ID
+        outfile.close(); // Close the file
+        cout << "Blocks exported to " << filename << " successfully." << endl; // Tell the user that the blocks have been successfully exported to the file
+    } 
 
-            if (supplierID.length() == 8 && supplierID.substr(0, 3) == "SID") { // Check if the supplier ID is 8 characters long and starts with "SID"
-                bool validLength = true; // Set the valid flag to true
-                for (int i = 3; i < 8; i++) { // For loop to check if the rest of the characters are digits
-                    if (!isdigit(supplierID[i])) { // If the character is not a digit
-                        validLength = false; // Then set the valid flag to false
-                        break; // Break out of the for loop
-                    }
-                }
-                if (validLength) { // If the valid flag is true
-                    correctSupplierID = true; // Set the correct supplier ID flag to true, this means that the supplier ID is valid
-                }
+    void exportCompressedSegments(const string& prefix) { // Function to export the blockchain as compressed segment files, each segment holds SEGMENT_BLOCKS blocks and has its own trained dictionary
+        vector<const BlockNode*> blocks; // Declare a vector of the nodes, oldest first
+        BlockNode* temp = head; // Create a temporary block node and set it to the head of the blockchain
+        while (temp != nullptr) { // While loop to traverse the blockchain
+            blocks.push_back(current(temp)); // Add the node
+            temp = temp->next; // Move to the next block
+        }
+        reverse(blocks.begin(), blocks.end()); // The chain is stored newest first
+
+        size_t rawBytes = 0, compressedBytes = 0; // Sizes before and after compression
+        for (size_t first = 0; first < blocks.size(); first += SEGMENT_BLOCKS) { // For loop over the segments
+            vector<shared_ptr<const Block> > segment; // Blocks of this segment, only one segment is read back from the cold store at a time
+            for (size_t i = first; i < min(blocks.size(), first + SEGMENT_BLOCKS); ++i) { // For loop over the nodes of the segment
+                segment.push_back(blockOf(blocks[i])); // Add the block
             }
-            else { // If the supplier ID is not 8 characters long and does not start with "SID"
-                cout << "Invalid format. Please enter a valid Supplier ID." << endl; // Tell the user that the supplier ID is invalid
+            string filename = prefix + to_string(segment.front()->blockNumber / SEGMENT_BLOCKS) + ".dat"; // Name of the segment file
+            ofstream outfile(filename, ios::binary); // Create an output file stream for the segment
+            if (!outfile.is_open()) { // If the file is not open
+                cout << "Error: Unable to open " << filename << " for writing." << endl; // Tell the user that there was an error opening the file
+                return;
             }
-        }
 
-        cout << "Enter Supplier Name: "; // Ask the user to enter the supplier name
-        getline(cin, supplierName); // Get user input for the supplier name
+            PayloadDictionary dictionary; // Declare the dictionary of this segment
+            dictionary.train(segment); // Train it on the blocks of the segment
 
-        bool validOrderQuantity = false; // Set the valid order quantity flag to false
-        while (!validOrderQuantity) { // While loop to keep asking the user to enter a valid order quantity
-            cout << "Enter Order Quantity: "; // Ask the user to enter the order quantity
-            getline(cin, orderQuantity); // Get user input for the order quantity
- 
-            if (orderQuantity.find_first_not_of("0123456789") == string::npos) { // Check if the order quantity contains only digits, no other characters but digits
-                validOrderQuantity = true; // Set the valid order quantity flag to true, this means that the order quantity is valid
-            } else { // If the order quantity contains characters other than digits
-                cout << "Invalid input. Please enter a valid number for Order Quantity." << endl; // Tell the user that the order quantity is invalid
+            string header = "BCSEG1"; // Segment header, starting with the format name
+            appendUint32(header, static_cast<uint32_t>(dictionary.size())); // Append the number of dictionary entries
+            for (size_t i = 0; i < dictionary.size(); ++i) { // For loop to append the dictionary
+                appendString(header, dictionary.entry(i)); // Append the entry
             }
+            appendString(header, segmentFilters[static_cast<size_t>(segment.front()->blockNumber / SEGMENT_BLOCKS)].data()); // Append the ID filter of the segment, so a search can skip the segment without reading its blocks
+            appendUint32(header, static_cast<uint32_t>(segment.size())); // Append the number of blocks
+
+            string data; // Compressed blocks
+            string index; // Block number, offset and length of every compressed block, so one block can be read without the others
+            for (size_t i = 0; i < segment.size(); ++i) { // For loop to compress the blocks
+                string compressed = dictionary.compressBlock(*segment[i]); // Compress the block
+                appendUint32(index, static_cast<uint32_t>(segment[i]->blockNumber)); // Append the block number
+                appendUint32(index, static_cast<uint32_t>(data.size())); // Append the offset of the block
+                appendUint32(index, static_cast<uint32_t>(compressed.size())); // Append the length of the block
+                data += compressed; // Add the block to the data
+                rawBytes += formatBlock(*segment[i]).size(); // Count the size of the block as text
+            }
+
+            outfile << header << index << data; // Write the segment
+            compressedBytes += header.size() + index.size() + data.size(); // Count the size of the segment
+            outfile.close(); // Close the file
         }
 
-        bool correctOrderDate = false; // Set the correct order date flag to false
-        while (!correctOrderDate) { // While loop to keep asking the user to enter a valid order date
-            cout << "Enter Order Date (format: dd/mm/yy): "; // Ask the user to enter the order date, the format is strictly day/month/year
-            getline(cin, orderDate); // Get user input for the order date
+        cout << "Blocks exported to " << blocks.size() / SEGMENT_BLOCKS + (blocks.size() % SEGMENT_BLOCKS != 0 ? 1 : 0) << " compressed segment(s) (" << rawBytes << " bytes as text, " << compressedBytes << " bytes compressed)." << endl; // Tell the user how much space was saved
+    }
 
-            if (orderDate.length() == 8 && orderDate[2] == '/' && orderDate[5] == '/') { // Check if the order date is 8 characters long and contains "/" at the 3rd and 6th position, no other characters but "/"
-                string dayString = orderDate.substr(0, 2); // Get the day from the order date
-                string monthString = orderDate.substr(3, 2); // Get the month from the order date
-                string yearString = orderDate.substr(6, 2); // Get the year from the order date
-                int day = stoi(dayString); // Convert the day string to an integer
-                int month = stoi(monthString); // Convert the month string to an integer
-                int year = stoi(yearString); // Convert the year string to an integer
+    bool readCompressedBlock(const string& prefix, int blockNumber, Block& block) { // Function to read one block back from the compressed segments, only the dictionary, the index and the block itself are read
+        string filename = prefix + to_string(blockNumber / SEGMENT_BLOCKS) + ".dat"; // Name of the segment holding the block
+        ifstream infile(filename, ios::binary); // Create an input file stream for the segment
+        char format[6]; // Declare the format name
+        if (!infile.is_open() || !infile.read(format, 6) || string(format, 6) != "BCSEG1") { // If the file is missing or is not a segment
+            return false;
+        }
 
-                if (day >= 1 && day <= 31 && month >= 1 && month <= 12 && year >= 0 && year >= 24) { // Check that the day is between 1-31, month is between 1-12, and year is after 2024, only valid day month and year
-                    correctOrderDate = true; // Set the correct order date flag to true, this means that the order date is valid
-                }
+        PayloadDictionary dictionary; // Declare the dictionary of the segment
+        uint32_t entryCount, blockCount; // Declare the number of dictionary entries and of blocks
+        if (!readStreamUint32(infile, entryCount)) { // If the dictionary size is missing
+            return false;
+        }
+        for (uint32_t i = 0; i < entryCount; i++) { // For loop to read the dictionary
+            string entry; // Declare the entry
+            if (!readStreamString(infile, entry)) { // If the entry is damaged
+                return false;
             }
+            dictionary.add(entry); // Add the entry
+        }
+        string savedFilter; // Declare the saved ID filter, not needed to read a block
+        if (!readStreamString(infile, savedFilter) || !readStreamUint32(infile, blockCount)) { // If the filter or the number of blocks is missing
+            return false;
+        }
 
-            if (!correctOrderDate) { // If the order date is not valid
-                cout << "Invalid format. Please enter a valid Order Date (format: dd/mm/yy) Ensure that year is on or after 2024." << endl; // Tell the user that the order date is invalid, will loop again
+        string index(static_cast<size_t>(blockCount) * 12, '\0'); // Declare the index of the segment
+        if (!infile.read(&index[0], index.size())) { // If the index could not be read
+            return false;
+        }
+        streampos dataStart = infile.tellg(); // The compressed blocks follow the index
+        size_t low = 0, high = blockCount; // Binary search the index, blocks are stored in order
+        while (low < high) { // While loop to narrow down the search
+            size_t middle = (low + high) / 2; // Middle entry
+            size_t pos = middle * 12; // Position of the entry
+            uint32_t middleNumber; // Block number of the entry
+            readUint32(index, pos, middleNumber); // Read the block number
+            if (static_cast<int>(middleNumber) < blockNumber) { // If the block is further on
+                low = middle + 1; // Search the upper half
+            } else { // If the block is here or before
+                high = middle; // Search the lower half
             }
         }
+        size_t pos = low * 12; // Position of the entry found
+        uint32_t foundNumber, offset, length; // Declare the block number, offset and length
+        if (low >= blockCount || !readUint32(index, pos, foundNumber) || static_cast<int>(foundNumber) != blockNumber || !readUint32(index, pos, offset) || !readUint32(index, pos, length)) { // If the block is not in the segment
+            return false;
+        }
 
-        bool validOrderState = false; // Set the valid order state flag to false
+        string compressed(length, '\0'); // Declare the compressed block
+        infile.seekg(dataStart + static_cast<streamoff>(offset)); // Seek straight to the block
+        if (!infile.read(&compressed[0], length)) { // If the block could not be read
+            return false;
+        }
+        return dictionary.decompressBlock(compressed, block); // Decompress the block
+    }
 
-        while (!validOrderState) { // While loop to keep asking the user to enter a valid order state
-            cout << "Enter Order State (Pending, In Progress, Completed, Cancelled): "; // Ask the user to enter the order state, the options are Pending, In Progress, Completed, Cancelled
-            getline(cin, orderState); // Get user input for the order state
+    void searchCompressedSegments(const string& prefix) { // Method to search a block in the compressed segments
+        cout << "\nEnter which block number you want to read from the compressed segments: "; // Ask the user for the block number
+        int blockNumber; // Declare the block number
+        cin >> blockNumber; // Get user input for the block number
+        if (cin.fail()) { // If the user enters an invalid input
+            cin.clear(); // Clear the input buffer
+            cin.ignore(numeric_limits<streamsize>::max(), '\n'); // Ignore the rest of the input
+            cout << "\nInvalid input. Please enter a number." << endl; // Tell the user that they entered an invalid input
+            return;
+        }
 
-            transform(orderState.begin(), orderState.end(), orderState.begin(), ::tolower); // Convert the order state to lowercase, so that the user can enter the order state in any case, doesnt affect the input
+        Block block(blockNumber, "", "", 0); // Declare the block to read into
+        if (!readCompressedBlock(prefix, blockNumber, block)) { // If the block could not be read
+            cout << "\nBlock with number " << blockNumber << " not found in the compressed segments." << endl; // Tell the user that the block was not found
+            return;
+        }
+        cout << "\n" << formatBlock(block); // Display the block
+    }
 
-            if (orderState == "pending" || orderState == "in progress" || orderState == "completed" || orderState == "cancelled") { // Check if the order state is one of the valid options, pending, in progress, completed, or cancelled
-                validOrderState = true; // Set the valid order state flag to true, this means that the order state is valid
-            }
-            else { // If the order state is not one of the valid options
-                cout << "Invalid status. Please enter 'Pending', 'In Progress', 'Completed', 'Cancelled'." << endl; // Tell the user that the order state is invalid
-            }
+    string formatBlock(const Block& block) { // Function to format a block as a line of text, used by the export and the displays
+        stringstream line; // Declare a string stream to build the line
+        line << "Block " << block.blockNumber << " | " << block.currentHashNumber << " | " << block.previousHashNumber << " | " << formatTimeStamp(block.currentTimeStamp) << (block.signer.empty() ? "" : "signed by " + block.signer + " | ") << "information: "; // Write the block number, current hash number, previous hash number, current time stamp and signer
+
+        for (size_t i = 0; i < block.information.size(); ++i) { // For loop to write the block information
+            const pair<string, string>& info = block.information[i]; // Get the block information from the block data
+            line << " " << info.first << ": " << info.second << " | "; // Write the block information
         }
+        line << endl; // End the line
+        return line.str(); // Return the line
+    }
 
-        cout << "Enter Shipping Details: "; // Ask the user to enter the shipping details
-        getline(cin, shippingDetails); // Get user input for the shipping details
+    bool loadLocations() { // Method to load the valid locations the first time they are needed, returns false if the file could not be opened
+        if (locations) { // If they are already loaded
+            return true;
+        }
+        shared_ptr<LocationDictionary> dictionary = make_shared<LocationDictionary>(); // Create the dictionary
+        if (!dictionary->loadFromFile("valid_locations.txt")) { // Load the valid locations file
+            return false;
+        }
+        locations = dictionary; // Keep the dictionary
+        return true;
+    }
 
-        block.information.push_back(make_pair("Block", "Procurement Information")); // Add the block name and block type to the block information
-        block.information.push_back(make_pair("Supplier ID", supplierID)); // Add the supplier ID to the block information
-        block.information.push_back(make_pair("Supplier Name", supplierName)); // Add the supplier name to the block information
-        block.information.push_back(make_pair("Order Quantity", orderQuantity)); // Add the order quantity to the block information
-        block.information.push_back(make_pair("Order Date", orderDate)); // Add the order date to the block information
-        block.information.push_back(make_pair("Order State", orderState)); // Add the order state to the block information
-        block.information.push_back(make_pair("Shipping Details", shippingDetails)); // Add the shipping details to the block information
+    bool isValidLocation(string& location, int& locationId) { // Method to check if a location is valid, case and spacing are ignored and a valid location is replaced by its name as written in the valid locations file
+        locationId = locations->findId(location); // Look the location up
+        if (locationId < 0) { // If the location is not valid
+            return false;
+        }
+        location = locations->name(locationId); // Use the name from the file
+        return true;
+    }
 
-        cout << "\n\nProcurement Information Block Successfully Added.\n"; // Tell the user that the procurement information block has been successfully added, and the information has been stored in the block, block now has the information
+    bool listLocations(const string& input) { // Method to list the valid locations starting with the input when it ends with *, returns false if the input is not a prefix request
+        if (input.empty() || input[input.size() - 1] != '*') { // If the input does not end with *
+            return false;
+        }
+        string prefix = input.substr(0, input.size() - 1); // Remove the *
+        vector<int> matches = locations->complete(prefix, LOCATION_SUGGESTIONS + 1); // Find the matches, one more than shown to tell if there are more
+        if (matches.empty()) { // If no location starts with the prefix
+            cout << "No valid location starts with '" << prefix << "'." << endl;
+            return true;
+        }
+        for (size_t i = 0; i < matches.size() && i < LOCATION_SUGGESTIONS; ++i) { // For loop to show the matches
+            cout << "  " << locations->name(matches[i]) << endl; // Show the location
+        }
+        if (matches.size() > LOCATION_SUGGESTIONS) { // If there are more matches than shown
+            cout << "  ..." << endl;
+        }
+        return true;
     }
 
-    void addInventoryInformation(Block& block) { // Function to add inventory information to the block
-        string warehouseID, storageLocation, inventoryQuantity, inventoryStatus; // Declare the variables for the warehouse ID, storage location, inventory quantity, and inventory status
-        bool correctWarehouseID = false; // Set the correct warehouse ID flag to false
+    int getCurrentBlockNumber() { // Method to get the current block number, this is a getter method used to get the current block number
+        return currentBlockNumber; // Return the current block number
+    }
 
-        while (!correctWarehouseID) { // While loop to keep asking the user to enter a valid warehouse ID
-            cout << "\nEnter Warehouse ID (format: WIDxxxxx): "; // Ask the user to enter the warehouse ID, the format is strictly WID followed by 5 digits
-            getline(cin, warehouseID); // Get user input for the warehouse ID
+    shared_ptr<const Block> findBlock(int blockNumber) { // Method to find a block by block number without prompting the user, returns nullptr if the block does not exist
+        BlockNode* temp = head; // Create a temporary block node and set it to the head of the blockchain
+        while (temp != nullptr) { // While loop to traverse the blockchain
+            if (temp->data.blockNumber == blockNumber) { // If this is the block being looked for
+                return blockOf(current(temp)); // Return the block
+            }
+            temp = temp->next; // Move to the next block
+        }
+        return shared_ptr<const Block>(); // The block was not found
+    }
 
-            if (warehouseID.length() == 8 && warehouseID.substr(0, 3) == "WID") { // Check if the warehouse ID is 8 characters long and starts with WID, no other characters but WID and 5 digits
-                bool validLength = true; // Set the valid flag to true, this means that the warehouse ID is valid
-                for (int i = 3; i < 8; i++) { // For loop to check the 5 digits of the warehouse ID
-                    if (!isdigit(warehouseID[i])) { // If the character is not a digit
-                        validLength = false; // Set the valid flag to false, this means that the warehouse ID is invalid
-                        break; // Break the for loop, no need to check the rest of the digits
-                    }
-                }
-                if (validLength) { // If the warehouse ID is valid
-                    correctWarehouseID = true; // Set the correct warehouse ID flag to true, this means that the warehouse ID is valid
+    vector<shared_ptr<const Block> > queryBlocks(const string& key, const string& value) { // Method to find every block holding the key with the value passed in, hard deleted and soft deleted blocks are skipped
+        vector<shared_ptr<const Block> > matches; // Declare a vector to store the matching blocks
+        vector<bool> candidateSegments(segmentFilters.size(), true); // Segments that may hold the value, every segment unless the key is an ID
+        int oldestCandidate = 0; // Oldest segment that may hold the value
+        if (isIdField(key)) { // If the key is an ID, the segment filters can rule segments out
+            oldestCandidate = -1; // No candidate found yet
+            for (size_t i = 0; i < segmentFilters.size(); ++i) { // For loop over the segment filters
+                candidateSegments[i] = segmentFilters[i].mayContain(value); // Check the filter of the segment
+                if (candidateSegments[i] && oldestCandidate == -1) { // If this is the oldest segment that may hold the ID
+                    oldestCandidate = static_cast<int>(i); // Remember the segment
                 }
             }
-            else { // If the warehouse ID is not valid
-                cout << "Invalid format. Please enter a valid Warehouse ID." << endl; // Tell the user that the warehouse ID is invalid, will loop again
+            if (oldestCandidate == -1) { // If no segment can hold the ID
+                return matches; // The chain does not need to be scanned
             }
         }
 
-        vector<string> validLocations; // Create a vector of strings to store the valid locations, valid locations are cities and states, the format is: city, state
-        ifstream file("valid_locations.txt"); // Open the valid locations file, file name is valid_locations.txt
-        if (file.is_open()) { // If the file is open
-            string line; // Declare a string to store the line of the file
-            while (getline(file, line)) { // While loop to read the file line by line
-                validLocations.push_back(line); // Add the line to the valid locations vector
+        BlockNode* temp = head; // Create a temporary block node and set it to the head of the blockchain
+        while (temp != nullptr && temp->data.blockNumber / SEGMENT_BLOCKS >= oldestCandidate) { // While loop to traverse the blockchain, stopping after the oldest segment that may hold the value
+            const Block& header = current(temp)->data; // Get the header of the block's current version
+            size_t segment = static_cast<size_t>(header.blockNumber / SEGMENT_BLOCKS); // Segment of the block
+            if (!header.isHardDeleted && !header.isSoftDeleted && (segment >= candidateSegments.size() || candidateSegments[segment])) { // Deleted information is never returned, and segments ruled out by their filter are skipped before the block is read
+                shared_ptr<const Block> block = blockOf(current(temp)); // Whole block, read back if it was evicted
+                for (size_t i = 0; i < block->information.size(); ++i) { // For loop to check the block information
+                    if (block->information[i].first == key && block->information[i].second == value) { // If the key and the value match
+                        matches.push_back(block); // Add the block to the matches
+                        break; // No need to check the rest of the information
+                    }
+                }
             }
-            file.close(); // Close the file
-        } else { // If the file is not open
-            cout << "Error: Unable to open valid locations file." << endl; // Tell the user that the file is not open, file is not found
-            return; // Return from the function
+            temp = temp->next; // Move to the next block
         }
+        return matches; // Return the matching blocks
+    }
 
-        bool validStorageLocation = false; // Set the valid storage location flag to false
-
-        while (!validStorageLocation) { // While loop to keep asking the user to enter a valid storage location
-            cout << "Enter Storage Location (format: city, state): "; // Ask the user to enter the storage location, the format is city, state
-            getline(cin, storageLocation); // Get user input for the storage location
-
-            validStorageLocation = isValidLocation(storageLocation, validLocations); // Call the isValidLocation function to check if the storage location is valid, pass the storage location and the valid locations vector as arguments
-
-            if (!validStorageLocation) { // If the storage location is not valid
-                cout << "Invalid format. Please enter a valid location in the format 'city, state'." << endl; // Tell the user that the storage location is invalid, will loop again
+    size_t runQuery(const ChainQuery& query, const function<bool(const Block&)>& onMatch) { // Method to run a parsed query, each matching block is passed to onMatch as soon as it is found, newest first, and the scan stops when onMatch returns false or the limit is reached, returns the number of matches
+        vector<bool> candidateSegments(segmentFilters.size(), true); // Segments that may match, every segment unless an ID rules some out
+        for (size_t i = 0; i < segmentFilters.size(); ++i) { // For loop over the segment filters
+            for (size_t j = 0; j < query.indexedIds.size() && candidateSegments[i]; ++j) { // For loop over the IDs that must be present
+                candidateSegments[i] = segmentFilters[i].mayContain(query.indexedIds[j]); // Check the filter of the segment
             }
         }
 
-        bool validInventoryQuantity = false; // Set the valid inventory quantity flag to false
-        while (!validInventoryQuantity) { // While loop to keep asking the user to enter a valid inventory quantity
-            cout << "Enter Inventory Quantity: "; // Ask the user to enter the inventory quantity
-            getline(cin, inventoryQuantity); // Get user input for the inventory quantity
-
-            if (inventoryQuantity.find_first_not_of("0123456789") == string::npos) { // Check if the inventory quantity contains only digits, no other characters
-                validInventoryQuantity = true; // Set the valid inventory quantity flag to true, this means that the inventory quantity is valid
-            } else {
-                cout << "Invalid input. Please enter a valid number for Inventory Quantity." << endl; // Tell the user that the inventory quantity is invalid, will loop again
-            }
+        size_t matches = 0; // Number of matches so far
+        BlockNode* temp = head; // Create a temporary block node and set it to the head of the blockchain
+        while (temp != nullptr && temp->data.blockNumber > query.highestBlock) { // Seek past the blocks above the range without checking them
+            temp = temp->next;
         }
-
-        bool validInventoryStatus = false; // Set the valid inventory status flag to false
-        while (!validInventoryStatus) { // While loop to keep asking the user to enter a valid inventory status
-            cout << "Enter Inventory Status (Available, Low Stock, or Not Available): "; // Ask the user to enter the inventory status, the options are available, low stock, or not available
-            getline(cin, inventoryStatus); // Get user input for the inventory status
-
-            transform(inventoryStatus.begin(), inventoryStatus.end(), inventoryStatus.begin(), ::tolower); // Convert the inventory status to lowercase
-
-            if (inventoryStatus == "available" || inventoryStatus == "low stock" || inventoryStatus == "not available") { // Check if the inventory status is available, low stock, or not available
-                validInventoryStatus = true; // Set the valid inventory status flag to true, this means that the inventory status is valid
-            } 
-            else { // If the inventory status is not valid
-                cout << "Invalid status. Please enter 'Available', 'Low Stock', or 'Not Available'." << endl; // Tell the user that the inventory status is invalid, will loop again
+        while (temp != nullptr && temp->data.blockNumber >= query.lowestBlock) { // While loop to traverse the range, stopping below the lowest block that can match
+            const BlockNode* node = current(temp); // Current version of the block
+            const Block& header = node->data; // Get its header
+            size_t segment = static_cast<size_t>(header.blockNumber / SEGMENT_BLOCKS); // Segment of the block
+            if (header.isHardDeleted || header.isSoftDeleted || (segment < candidateSegments.size() && !candidateSegments[segment]) || header.blockNumber >= currentBlockNumber) { // Deleted information is never returned, ruled out segments are skipped, and the empty first block is not a match, all without reading the block
+                temp = temp->next; // Move to the next block
+                continue;
+            }
+            shared_ptr<const Block> whole = blockOf(node); // Whole block, read back if it was evicted
+            const Block& block = *whole;
+            temp = temp->next; // Move to the next block
+            bool matched = true; // Flag to indicate that every condition holds
+            for (size_t i = 0; i < query.blockPredicates.size() && matched; ++i) { // For loop over the block conditions, checked before the information is read
+                const QueryPredicate& predicate = query.blockPredicates[i]; // The condition
+                matched = predicate.stage == -1 ? predicate.accepts(compareQueryValues(to_string(block.blockNumber), predicate.value)) : predicate.accepts(stageIndexOf(block) == predicate.stage ? 0 : 1); // Check the block number or the stage
+            }
+            for (size_t i = 0; i < query.informationPredicates.size() && matched; ++i) { // For loop over the information conditions
+                matched = query.informationPredicates[i].matchesInformation(block); // Check the information
+            }
+            if (!matched) { // If a condition failed
+                continue;
+            }
+            matches++; // Count the match
+            if (!onMatch(block) || matches == query.limit) { // Pass the block on, and stop when asked or when the limit is reached
+                break;
             }
         }
+        return matches; // Return the number of matches
+    }
 
-        block.information.push_back(make_pair("Block", "Inventory Information")); // Add the inventory information block to the block
-        block.information.push_back(make_pair("Warehouse ID", warehouseID)); // Add the warehouse ID to the block
-        block.information.push_back(make_pair("Storage Location", storageLocation)); // Add the storage location to the block
-        block.information.push_back(make_pair("Inventory Quantity", inventoryQuantity)); // Add the inventory quantity to the block
-        block.information.push_back(make_pair("Inventory Status", inventoryStatus)); // Add the inventory status to the block
+    void queryChain() { // Method to run a query typed by the user and show the matching blocks as they are found
+        cout << "\nEnter a query (e.g. stage=transportation AND mode=Air AND arrival>=01/04/24 LIMIT 100): "; // Ask the user for the query
+        string text; // Declare the query text
+        getline(cin, text); // Get user input for the query
 
-        cout << "\n\nInventory Information Block Successfully Added.\n"; // Tell the user that the inventory information block is successfully added
+        ChainQuery query; // Declare the parsed query
+        string error; // Declare the error message
+        if (!parseQuery(text, query, error)) { // If the query is not valid
+            cout << "\nInvalid query. " << error << endl; // Tell the user what is wrong
+            return;
+        }
+        cout << "\nPlan: " << query.plan << "." << endl; // Show the plan chosen
+        size_t matches = runQuery(query, [this](const Block& block) { // Run the query
+            cout << formatBlock(block); // Show each match as it is found
+            return true; // Keep going
+        });
+        cout << "\n" << matches << " block(s) matched." << endl; // Tell the user how many blocks matched
     }
 
-    void addOrderFulfillmentInformation(Block& block) { // Function to add order fulfillment information to the block
-        string customerID, orderQuantityF, orderDateF, orderStateF, shippingDetailsF; // Declare strings to store the customer ID, order quantity, order date, order state, and shipping details
-
-        bool correctCustomerID = false; // Set the correct customer ID flag to false
+    int findIdInSegments(const string& prefix, const string& id, int& skippedSegments) { // Search the compressed segments for an ID, segments whose saved filter rules the ID out are not decompressed, returns the block number or -1
+        skippedSegments = 0; // No segment skipped yet
+        for (int segmentNumber = 0; ; segmentNumber++) { // For loop over the segment files until one is missing
+            ifstream infile(prefix + to_string(segmentNumber) + ".dat", ios::binary); // Create an input file stream for the segment
+            char format[6]; // Declare the format name
+            if (!infile.is_open() || !infile.read(format, 6) || string(format, 6) != "BCSEG1") { // If there are no more segments
+                return -1;
+            }
 
-        while (!correctCustomerID) { // While loop to keep asking the user to enter a valid customer ID
-            cout << "\nEnter Customer ID (format: CIDxxxxx): "; // Ask the user to enter the customer ID, the format is CID followed by 5 digits
-            getline(cin, customerID); // Get user input for the customer ID
+            PayloadDictionary dictionary; // Declare the dictionary of the segment
+            BloomFilter filter; // Declare the filter of the segment
+            string savedFilter; // Declare the saved filter bits
+            uint32_t entryCount, blockCount; // Declare the number of dictionary entries and of blocks
+            if (!readStreamUint32(infile, entryCount)) { // If the dictionary size is missing
+                return -1;
+            }
+            for (uint32_t i = 0; i < entryCount; i++) { // For loop to read the dictionary
+                string entry; // Declare the entry
+                if (!readStreamString(infile, entry)) { // If the entry is damaged
+                    return -1;
+                }
+                dictionary.add(entry); // Add the entry
+            }
+            if (!readStreamString(infile, savedFilter) || !filter.load(savedFilter)) { // If the filter is damaged
+                return -1;
+            }
+            if (!filter.mayContain(id)) { // If the segment cannot hold the ID
+                skippedSegments++; // Count the skipped segment
+                continue; // Move on without reading the blocks
+            }
+            if (!readStreamUint32(infile, blockCount)) { // If the number of blocks is missing
+                return -1;
+            }
 
-            if (customerID.length() == 8 && customerID.substr(0, 3) == "CID") { // Check if the customer ID is 8 characters long and starts with CID
-                bool validLength = true; // Set the valid flag to true
-                for (int i = 3; i < 8; i++) { // For loop to check if the rest of the customer ID contains only digits
-                    if (!isdigit(customerID[i])) { // If the character is not a digit
-                        validLength = false; // Set the valid flag to false
-                        break; // Break from the for loop
-                    }
+            string index(static_cast<size_t>(blockCount) * 12, '\0'); // Declare the index of the segment
+            if (!infile.read(&index[0], index.size())) { // If the index could not be read
+                return -1;
+            }
+            string data((istreambuf_iterator<char>(infile)), istreambuf_iterator<char>()); // Read the compressed blocks
+            for (size_t pos = 0; pos < index.size(); ) { // For loop over the index entries
+                uint32_t blockNumber, offset, length; // Declare the block number, offset and length
+                readUint32(index, pos, blockNumber); // Read the block number
+                readUint32(index, pos, offset); // Read the offset
+                readUint32(index, pos, length); // Read the length
+                Block block(static_cast<int>(blockNumber), "", "", 0); // Declare the block to read into
+                if (static_cast<size_t>(offset) + length > data.size() || !dictionary.decompressBlock(data.substr(offset, length), block)) { // If the block is damaged
+                    return -1;
                 }
-                if (validLength) { // If the customer ID is valid
-                    correctCustomerID = true; // Set the correct customer ID flag to true, this means that the customer ID is valid
+                for (size_t i = 0; i < block.information.size(); ++i) { // For loop to check the block information
+                    if (isIdField(block.information[i].first) && block.information[i].second == id) { // If the ID matches
+                        return block.blockNumber; // Return the block number
+                    }
                 }
             }
-            else { // If the customer ID is not valid
-                cout << "Invalid format. Please enter a valid Customer ID." << endl; // Tell the user that the customer ID is invalid, will loop again
-            }
         }
+    }
 
-        bool validOrderQuantityF = false; // Set the valid order quantity flag to false
-        while (!validOrderQuantityF) { // While loop to keep asking the user to enter a valid order quantity
-            cout << "Enter Order Quantity: "; // Ask the user to enter the order quantity
-            getline(cin, orderQuantityF); // Get user input for the order quantity
-
-            if (orderQuantityF.find_first_not_of("0123456789") == string::npos) { // Check if the order quantity contains only digits, no other characters, only digits
-                validOrderQuantityF = true; // Set the valid order quantity flag to true, this means that the order quantity is valid
-            } else { // If the order quantity is not valid
-                cout << "Invalid input. Please enter a valid number for Order Quantity." << endl; // Tell the user that the order quantity is invalid, will loop again
+    void checkIdExists(const string& prefix) { // Method to check if a Supplier ID, Warehouse ID or Customer ID has appeared in the chain or in the exported segments
+        cout << "\nEnter the Supplier ID, Warehouse ID or Customer ID to check: "; // Ask the user for the ID
+        string id; // Declare the ID
+        cin >> id; // Get user input for the ID
+
+        const char* keys[] = { "Supplier ID", "Warehouse ID", "Customer ID" }; // Keys that can hold the ID
+        bool found = false; // Flag to indicate if the ID was found
+        for (int i = 0; i < 3 && !found; i++) { // For loop over the ID keys
+            vector<shared_ptr<const Block> > matches = queryBlocks(keys[i], id); // Find the blocks holding the ID
+            if (!matches.empty()) { // If the ID was found
+                cout << "\n" << keys[i] << " " << id << " appears in block " << matches.back()->blockNumber << " of the chain." << endl; // Tell the user where the ID first appears
+                found = true; // The ID was found
             }
         }
+        if (!found) { // If the ID is not in the chain
+            cout << "\n" << id << " does not appear in the chain." << endl; // Tell the user that the ID was not found
+        }
 
-        bool correctOrderDateF = false; // Set the correct order date flag to false
-        while (!correctOrderDateF) { // While loop to keep asking the user to enter a valid order date
-            cout << "Enter Order Date (format: dd/mm/yy): "; // Ask the user to enter the order date, the format is dd/mm/yy
-            getline(cin, orderDateF); // Get user input for the order date
- 
-            if (orderDateF.length() == 8 && orderDateF[2] == '/' && orderDateF[5] == '/') { // Check if the order date is 8 characters long and contains / at the 3rd and 6th position, no other characters
-                string dayString = orderDateF.substr(0, 2); // Extract the day, month, and year from the order date
-                string monthString = orderDateF.substr(3, 2); // Extract the day, month, and year from the order date
-                string yearString = orderDateF.substr(6, 2); // Extract the day, month, and year from the order date
-                int day = stoi(dayString); // Convert the day, month, and year to integers 
-                int month = stoi(monthString); // Convert the day, month, and year to integers
-                int year = stoi(yearString); // Convert the day, month, and year to integers
-
-                if (day >= 1 && day <= 31 && month >= 1 && month <= 12 && year >= 0 && year >= 24) { // Check if the day, month, and year are valid and year is after 2024
-                    correctOrderDateF = true; // Set the correct order date flag to true, this means that the order date is valid
-                }
-            }
- 
-            if (!correctOrderDateF) { // If the order date is not valid
-                cout << "Invalid format. Please enter a valid Order Date (format: dd/mm/yy) Ensure that year is on or after 2024." << endl; // Tell the user that the order date is invalid, will loop again
-            }
+        int skippedSegments; // Number of segments skipped by their filter
+        int blockNumber = findIdInSegments(prefix, id, skippedSegments); // Search the exported segments
+        if (blockNumber != -1) { // If the ID was found in the segments
+            cout << id << " appears in block " << blockNumber << " of the compressed segments." << endl; // Tell the user where the ID appears
+        } else { // If the ID was not found in the segments
+            cout << id << " does not appear in the compressed segments (" << skippedSegments << " segment(s) skipped by their filter)." << endl; // Tell the user that the ID was not found
         }
+    }
 
-        bool validOrderState = false; // Set the valid order state flag to false
-        while (!validOrderState) { // While loop to keep asking the user to enter a valid order state
-            cout << "Enter Order State (Pending, In Progress, Completed, Cancelled): "; // Ask the user to enter the order state, the options are Pending, In Progress, Completed, Cancelled
-            getline(cin, orderStateF); // Get user input for the order state
+    void recordLifecycle(const BlockNode* node, const Block& block) { // Make a block the latest of its stage in the lifecycle view of its shipment
+        int stage = stageIndexOf(block); // Get the stage of the block
+        if (stage != -1 && !block.isHardDeleted) { // If the block holds a stage and has not been hard deleted
+            lifecycleView[shipmentIdOf(block)].stages[stage] = node; // Record the node of the block
+        }
+    }
 
-            transform(orderStateF.begin(), orderStateF.end(), orderStateF.begin(), ::tolower); // Convert the order state to lowercase
+    void rebuildLifecycleView() { // Rebuild the lifecycle view from the chain
+        lifecycleView.clear(); // Clear the view
+        vector<const BlockNode*> nodes; // Declare a vector of the nodes, oldest first
+        BlockNode* temp = head; // Create a temporary block node and set it to the head of the blockchain
+        while (temp != nullptr) { // While loop to traverse the blockchain
+            nodes.push_back(current(temp)); // Add the node, changed if the block was replaced
+            temp = temp->next; // Move to the next block
+        }
+        for (size_t i = nodes.size(); i > 0; --i) { // For loop over the blocks oldest first, so later blocks replace earlier ones
+            shared_ptr<const Block> block = blockOf(nodes[i - 1]); // Whole block, read back in order if it was evicted
+            recordLifecycle(nodes[i - 1], *block); // Record the block
+        }
+        lifecycleViewValid = true; // The view matches the chain
+        ruleViolationsValid = false; // The broken rules were worked out from the old view
+    }
 
-            if (orderStateF == "pending" || orderStateF == "in progress" || orderStateF == "completed" || orderStateF == "cancelled") { // Check if the order state is valid
-                validOrderState = true; // Set the valid order state flag to true, this means that the order state is valid
+    const ShipmentLifecycle* findShipment(const string& shipmentId) { // Method to get the latest block of each stage of a shipment, returns nullptr if the shipment has no blocks
+        if (!lifecycleViewValid) { // If the view is out of date
+            rebuildLifecycleView(); // Rebuild it once, later appends keep it up to date
+        }
+        unordered_map<string, ShipmentLifecycle>::const_iterator it = lifecycleView.find(shipmentId); // Look the shipment up
+        return it == lifecycleView.end() ? nullptr : &it->second; // Return the lifecycle of the shipment
+    }
+
+    bool loadConsistencyRules(const string& filename) { // Method to compile the consistency rules in a file and check every shipment against them, an unchanged rule set is not checked again, returns false if a rule is not valid
+        shared_ptr<ConsistencyRules> rules = make_shared<ConsistencyRules>(); // Declare the new rules
+        string error; // Declare the error message
+        if (!rules->loadFromFile(filename, error)) { // If a rule is not valid
+            cout << "Error: " << error << endl; // Tell the user which rule is wrong, the old rules stay in use
+            return false;
+        }
+        if (consistencyRules && consistencyRules->sameRules(*rules)) { // If the rules have not changed
+            return true; // The broken rules are still up to date
+        }
+        consistencyRules = rules; // Use the new rules
+        ruleViolationsValid = false; // Every shipment has to be checked again
+        return true;
+    }
+
+    void checkRulesAfter(const Block& block) { // Update the broken rules of the block's shipment after the block became the latest of its stage, only the rules that read its stage are checked
+        int stage = stageIndexOf(block); // Stage of the block
+        if (stage == -1) { // Blocks without a stage change no rule
+            return;
+        }
+        string shipmentId = shipmentIdOf(block); // Shipment of the block
+        const ShipmentLifecycle& lifecycle = lifecycleView[shipmentId]; // Latest blocks of the shipment
+        const vector<int>& affected = consistencyRules->rulesReading(stage); // Rules the block can change
+        vector<int>& broken = ruleViolations[shipmentId]; // Rules the shipment breaks, sorted
+        for (size_t i = 0; i < affected.size(); ++i) { // For loop over the rules the block can change
+            bool holds = consistencyRules->rule(affected[i]).holds(lifecycle); // Check the rule
+            vector<int>::iterator found = lower_bound(broken.begin(), broken.end(), affected[i]); // Where the rule is or would be listed
+            bool listed = found != broken.end() && *found == affected[i]; // Flag to indicate that the rule was broken before
+            if (!holds && !listed) { // If the block breaks the rule
+                broken.insert(found, affected[i]);
+            } else if (holds && listed) { // If the block mends the rule
+                broken.erase(found);
             }
-            else { // If the order state is not valid
-                cout << "Invalid status. Please enter 'Pending', 'In Progress', 'Completed', 'Cancelled'." << endl; // Tell the user that the order state is invalid, will loop again
+        }
+        if (broken.empty()) { // Keep only the shipments that break a rule
+            ruleViolations.erase(shipmentId);
+        }
+    }
+
+    void checkAllRules() { // Check every shipment against every rule, the shipments are spread over the cores, used when the rules change or the lifecycle view was rebuilt
+        if (!lifecycleViewValid) { // If the view is out of date
+            rebuildLifecycleView(); // Rebuild it first
+        }
+        vector<pair<const string*, const ShipmentLifecycle*> > shipments; // Declare the shipments to check
+        for (unordered_map<string, ShipmentLifecycle>::const_iterator it = lifecycleView.begin(); it != lifecycleView.end(); ++it) { // For loop over the shipments
+            shipments.push_back(make_pair(&it->first, &it->second)); // Add the shipment
+        }
+        vector<vector<int> > broken(shipments.size()); // Rules broken by each shipment, each thread writes only its own entries
+        const ConsistencyRules& rules = *consistencyRules; // The rules, shared read only by the threads
+        forEachInParallel(shipments.size(), [&](size_t i) { // Check the shipments in parallel
+            broken[i] = rules.brokenRules(*shipments[i].second); // Check every rule against the shipment
+        });
+        ruleViolations.clear(); // Forget the old results
+        for (size_t i = 0; i < shipments.size(); ++i) { // For loop to keep the shipments that break a rule
+            if (!broken[i].empty()) {
+                ruleViolations[*shipments[i].first].swap(broken[i]);
             }
         }
+        ruleViolationsValid = true; // The broken rules match the view
+    }
 
-        cout << "Enter Shipping Details: "; // Ask the user to enter the shipping details
-        getline(cin, shippingDetailsF); // Get user input for the shipping details
+    const vector<int>* brokenRules(const string& shipmentId) { // Method to get the rules a shipment breaks, returns nullptr if it breaks none or no rules are loaded
+        if (!consistencyRules) { // If no rules are loaded
+            return nullptr;
+        }
+        if (!lifecycleViewValid || !ruleViolationsValid) { // If the results are out of date
+            checkAllRules(); // Check every shipment once, later appends keep the results up to date
+        }
+        unordered_map<string, vector<int> >::const_iterator it = ruleViolations.find(shipmentId); // Look the shipment up
+        return it == ruleViolations.end() ? nullptr : &it->second; // Return the broken rules
+    }
 
-        block.information.push_back(make_pair("Block", "Order Fulfillment Information")); // Add the order fulfillment information block to the block information vector
-        block.information.push_back(make_pair("Customer ID", customerID)); // Add the customer ID to the block information vector
-        block.information.push_back(make_pair("Order Quantity", orderQuantityF)); // Add the order quantity to the block information vector
-        block.information.push_back(make_pair("Order Date", orderDateF)); // Add the order date to the block information vector
-        block.information.push_back(make_pair("Order State", orderStateF)); // Add the order state to the block information vector
-        block.information.push_back(make_pair("Shipping Details", shippingDetailsF)); // Add the shipping details to the block information vector
+    void warnBrokenRules(const string& shipmentId) { // Method to tell the user which consistency rules a shipment breaks
+        const vector<int>* broken = brokenRules(shipmentId); // Rules the shipment breaks
+        for (size_t i = 0; broken != nullptr && i < broken->size(); ++i) { // For loop over the broken rules
+            cout << "Warning: shipment " << shipmentId << " breaks the rule \"" << consistencyRules->rule((*broken)[i]).text << "\"." << endl; // Tell the user about the rule
+        }
+    }
 
-        cout << "\n\nOrder Fulfillment Information Block Successfully Added.\n"; // Tell the user that the order fulfillment information block has been successfully added
+    void checkConsistency(const string& filename) { // Method to reload the consistency rules and list every shipment that breaks one
+        if (!loadConsistencyRules(filename)) { // If the rules could not be loaded
+            return;
+        }
+        chrono::steady_clock::time_point start = chrono::steady_clock::now(); // Time the check
+        brokenRules(LOCAL_SHIPMENT); // Bring the results up to date, checking every shipment only if the rules or the chain changed
+        long long elapsedMicros = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count(); // Time taken
+        vector<string> shipments; // Shipments that break a rule
+        for (unordered_map<string, vector<int> >::const_iterator it = ruleViolations.begin(); it != ruleViolations.end(); ++it) { // For loop over the shipments that break a rule
+            shipments.push_back(it->first);
+        }
+        sort(shipments.begin(), shipments.end()); // Show the shipments in order
+        cout << "\n" << consistencyRules->size() << " rule(s) checked across " << lifecycleView.size() << " shipment(s) in " << elapsedMicros << " us." << endl; // Tell the user what was checked
+        for (size_t i = 0; i < shipments.size(); ++i) { // For loop over the shipments
+            warnBrokenRules(shipments[i]); // Show the rules it breaks
+        }
+        if (shipments.empty()) { // If every shipment keeps every rule
+            cout << "Every shipment is consistent." << endl;
+        }
     }
 
-    void addTransportationInformation(Block& block) { // Function to add transportation information to the block
-        string transportationMode, transportationCompany, transportationRouteFrom, transportationRouteTo, transportationDepartureDateTime, transportationEstimatedArrivalDateTime; // Declare variables for the transportation information, variables declared are transportation mode, transportation company, transportation route from, transportation route to, transportation departure date and time, and transportation estimated arrival date and time
-        bool validTransportationMode = false; // Set the valid transportation mode flag to false
+    void displayShipmentLifecycle() { // Method to display what stage a shipment is in and what has happened so far
+        cout << "\nEnter the Shipment ID (" << LOCAL_SHIPMENT << " for blocks added from this menu): "; // Ask the user for the shipment ID
+        string shipmentId; // Declare the shipment ID
+        cin >> shipmentId; // Get user input for the shipment ID
 
-        while (!validTransportationMode) { // While loop to keep asking the user to enter a valid transportation mode
-            cout << "\nEnter Transportation Mode (Road, Rail, Sea, Air): "; // Ask the user to enter the transportation mode, the options are Road, Rail, Sea, Air
-            getline(cin, transportationMode); // Get user input for the transportation mode
+        const ShipmentLifecycle* lifecycle = findShipment(shipmentId); // Get the lifecycle of the shipment
+        if (lifecycle == nullptr) { // If the shipment has no blocks
+            cout << "\nShipment " << shipmentId << " not found." << endl; // Tell the user that the shipment was not found
+            return;
+        }
 
-            transform(transportationMode.begin(), transportationMode.end(), transportationMode.begin(), ::tolower); // Convert the transportation mode to lowercase
+        int latestStage = -1; // Furthest stage the shipment has reached
+        for (int stage = 0; stage < STAGE_COUNT; stage++) { // For loop over the stages
+            shared_ptr<const Block> block = lifecycle->stages[stage] != nullptr ? blockOf(lifecycle->stages[stage]) : shared_ptr<const Block>(); // Latest block of the stage
+            if (block == nullptr) { // If the stage has not happened yet
+                cout << "\n" << STAGE_NAMES[stage] << ": not yet recorded" << endl; // Tell the user that the stage is missing
+                continue;
+            }
+            latestStage = stage; // The shipment has reached this stage
+            cout << "\n" << STAGE_NAMES[stage] << " (block " << block->blockNumber << "):"; // Show the stage and its block
+            if (block->isSoftDeleted) { // If the information was soft deleted
+                cout << " information deleted"; // The information is hidden
+            } else { // If the information is available
+                for (size_t i = 0; i < block->information.size(); ++i) { // For loop over the information
+                    cout << " " << block->information[i].first << ": " << block->information[i].second << " | "; // Show the information
+                }
+            }
+            cout << endl;
+        }
+        cout << "\nShipment " << shipmentId << " has reached the " << STAGE_NAMES[latestStage] << " stage." << endl; // Tell the user the furthest stage reached
+    }
 
-            if (transportationMode == "road" || transportationMode == "rail" || transportationMode == "sea" || transportationMode == "air") { // Check if the transportation mode is valid
-                validTransportationMode = true; // Set the valid transportation mode flag to true, this means that the transportation mode is valid
+    bool verifyChain() { // Method to check that every block links to the hash of the block before it
+        BlockNode* temp = head; // Create a temporary block node and set it to the head of the blockchain
+        while (temp != nullptr && temp->next != nullptr) { // While loop to traverse the blockchain, each block is compared with the one before it
+            if (temp->data.previousHashNumber != temp->next->data.currentHashNumber) { // If the previous hash number does not match the hash of the block before it
+                return false; // The chain is broken
             }
-            else { // If the transportation mode is not valid
-                cout << "Invalid status. Please enter 'Road', 'Rail', 'Sea', 'Air" << endl; // Tell the user that the transportation mode is invalid, will loop again
+            if (temp->data.difficulty < requiredDifficulty) { // If the block claims less work than the chain requires
+                return false; // The block was changed to skip the proof of work
+            }
+            if (temp->data.difficulty > 0 && !hasValidProofOfWork(*blockOf(current(temp)))) { // If the block is sealed but its hash does not match its header and nonce, the encoding is read back if the block was evicted
+                return false; // The block was changed after it was sealed
+            }
+            if (temp->data.currentTimeStamp <= temp->next->data.currentTimeStamp) { // If the block is not stamped after the block before it
+                return false; // The blocks are out of order
             }
+            temp = temp->next; // Move to the next block
+        }
+        if (temp != nullptr && (temp->data.previousHashNumber != temp->data.currentHashNumber || (currentBlockNumber > 0 && temp->data.difficulty != requiredDifficulty))) { // The first block links to itself and holds the difficulty the chain requires
+            return false;
         }
+        bool signaturesHold = true; // Flag to indicate that every signed block's signature holds
+        checkSignatures([&signaturesHold](const Block&, bool valid) { // Check the signatures after the links, they are checked together
+            signaturesHold = signaturesHold && valid; // A single bad signature fails the chain
+        });
+        return signaturesHold;
+    }
 
-        cout << "Enter Transportation Company: "; // Ask the user to enter the transportation company
-        getline(cin, transportationCompany); // Get user input for the transportation company
+    void checkSignatures(const function<void(const Block&, bool)>& visit) { // Method to check the signature of every signed block, newest first, the blocks are gathered SIGNATURE_CHUNK_BLOCKS at a time and checked together on every core, visit is called for every signed block with its result
+        vector<shared_ptr<const Block> > pending; // Signed blocks waiting to be checked, evicted blocks are read back
+        BlockNode* temp = head; // Create a temporary block node and set it to the head of the blockchain
+        while (true) { // Loop over the blocks and once more at the end of the chain
+            if (temp != nullptr && isSignedBlock(current(temp)->data)) { // If the header names a signer, a key or a signature, a block with only a key or a signature must not slip past the check
+                pending.push_back(blockOf(current(temp))); // Gather the whole block
+            }
+            if (temp == nullptr || pending.size() >= SIGNATURE_CHUNK_BLOCKS) { // If enough blocks were gathered or the chain ended
+                vector<const Block*> blocks; // Declare the blocks to check
+                for (size_t i = 0; i < pending.size(); ++i) { // For loop over the gathered blocks
+                    blocks.push_back(pending[i].get()); // Check the block
+                }
+                vector<char> valid = verifyBlockSignatures(blocks); // Check them together
+                for (size_t i = 0; i < pending.size(); ++i) { // For loop to hand out the results
+                    visit(*pending[i], valid[i] != 0); // Visit the block
+                }
+                pending.clear(); // Start the next chunk
+            }
+            if (temp == nullptr) { // If the chain ended
+                break;
+            }
+            temp = temp->next; // Move to the next block
+        }
+    }
 
-        vector<string> validLocations; // Declare a vector of strings for the valid locations
-        ifstream file("valid_locations.txt"); // Open the valid locations file
-        if (file.is_open()) { // If the valid locations file is open
-            string Locationline; // Declare a string for the line
-            while (getline(file, Locationline)) { // While loop to get each line from the valid locations file
-                validLocations.push_back(Locationline); // Add the line to the valid locations vector
+    void auditSignatures() { // Method to check who wrote every block, every signature is checked in batches and every key is compared with the key registered for its operator
+        struct SignerTally { // Blocks of one operator
+            size_t blocks; // Blocks naming the operator
+            size_t invalid; // Blocks whose signature does not hold
+            size_t unregistered; // Blocks signed with a key that is not the operator's registered key
+        };
+        unordered_map<string, SignerTally> tallies; // Tally of each operator
+        vector<int> invalidBlocks; // Block numbers of the bad signatures
+        size_t signedBlocks = 0; // Blocks naming a signer
+        chrono::steady_clock::time_point start = chrono::steady_clock::now(); // Start of the check
+        checkSignatures([&](const Block& block, bool valid) { // Check every signed block
+            SignerTally& tally = tallies.insert(make_pair(block.signer, SignerTally{ 0, 0, 0 })).first->second; // Tally of the signer
+            tally.blocks++; // Count the block
+            signedBlocks++; // Count the signed block
+            if (!operatorRegistry.isRegistered(block.signer, block.signerKey)) { // If the signer has no key registered or signed with another key
+                tally.unregistered++; // Count it
+                invalidBlocks.push_back(block.blockNumber); // Remember the block
+            } else if (!valid) { // If the signature does not hold
+                tally.invalid++; // Count it
+                invalidBlocks.push_back(block.blockNumber); // Remember the block
             }
-            file.close(); // Close the valid locations file
-        } else { // If the valid locations file is not open
-            cout << "Error: Unable to open valid locations file." << endl; // Tell the user that the valid locations file cannot be opened
-            return; // Return from the function
+        });
+        double elapsed = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count(); // Time taken
+        cout << "\nChecked " << signedBlocks << " signature(s) in " << elapsed << " ms, " << currentBlockNumber - static_cast<int>(signedBlocks) << " unsigned block(s)." << endl; // Show the totals
+        vector<string> signers; // Declare the names of the signers
+        for (unordered_map<string, SignerTally>::const_iterator it = tallies.begin(); it != tallies.end(); ++it) { // For loop over the tallies
+            signers.push_back(it->first); // Add the name
         }
+        sort(signers.begin(), signers.end()); // Show the signers in order
+        for (size_t i = 0; i < signers.size(); ++i) { // For loop over the signers
+            const SignerTally& tally = tallies[signers[i]]; // Tally of the signer
+            cout << "Operator " << signers[i] << ": " << tally.blocks << " block(s), " << tally.invalid << " invalid signature(s), " << (tally.unregistered == 0 ? "key registered" : to_string(tally.unregistered) + " block(s) signed with a key not registered in operator_keys.txt") << endl; // Show the tally
+        }
+        for (size_t i = 0; i < invalidBlocks.size(); ++i) { // For loop over the bad signatures
+            cout << "Error: Block " << invalidBlocks[i] << " has an invalid or unregistered signature." << endl; // Tell the user which block was changed or forged
+        }
+    }
 
-        cout << "Enter Transportation Route: "; // Ask the user to enter the transportation route
-        bool validTransportationRouteFrom = false; // Set the valid transportation route from flag to false
-        while (!validTransportationRouteFrom) { // While loop to keep asking the user to enter a valid transportation route from
-            cout << "\nFrom (format: city, state): "; // Ask the user to enter the transportation route from, the format is: city, state
-            getline(cin, transportationRouteFrom); // Get user input for the transportation route from
+    void displayChain() { //Method to display block, this is strictly for displaying purposes and is strictly "virtual"
+        BlockNode* temp = head; // Create a temporary block node and set it to the head of the blockchain, this will be used to traverse the blockchain to search for the block
+        string blockNumberInput; // Declare a variable to store the block number that the user wants to search
+        cout << "\nEnter the block number you want to view (format: 1, 2, 3, ...) (* to view all): "; //Users can enter the specific block number of enter "*" asterisk to view all
+        cin >> blockNumberInput; // Get user input for the block number they want to search
 
-            validTransportationRouteFrom = isValidLocation(transportationRouteFrom, validLocations); // Check if the transportation route from is valid
+        bool found = false; // Declare a flag to indicate if the block was found
+        while (temp != nullptr) { // While loop to traverse the blockchain
+            if (!current(temp)->data.isHardDeleted && (blockNumberInput == "*" || stoi(blockNumberInput) == temp->data.blockNumber)) { // The header is checked before the block is read
+                shared_ptr<const Block> whole = blockOf(current(temp)); // Whole block, read back if it was evicted
+                const Block& block = *whole;
+                found = true;
+                cout << "\nBlock " << block.blockNumber << " | " << block.currentHashNumber << " | " << block.previousHashNumber << " | " << formatTimeStamp(block.currentTimeStamp) << (block.signer.empty() ? "" : " signed by " + block.signer + " |");
 
-            if (!validTransportationRouteFrom) { // If the transportation route from is not valid
-                cout << "Invalid format. Please enter a valid location in the format 'city, state'." << endl; // Tell the user that the transportation route from is invalid, will loop again
-            }
-        }
-        
-        bool validTransportationRouteTo = false; // Set the valid transportation route to flag to false
-        while (!validTransportationRouteTo) { // While loop to keep asking the user to enter a valid transportation route to
-            cout << "To (format: city, state): "; // Ask the user to enter the transportation route to, the format is: city, state
-            getline(cin, transportationRouteTo); // Get user input for the transportation route to
+                if (!block.isSoftDeleted) { //If the block is soft deleted
+                    cout << " information: ";
+                    for (size_t i = 0; i < block.information.size(); ++i) {
+                        const pair<string, string>& info = block.information[i];
+                        cout << " " << info.first << ": " << info.second << " | ";
+                    }
+                }
 
-            validTransportationRouteTo = isValidLocation(transportationRouteTo, validLocations); // Check if the transportation route to is valid
+                cout << endl;
 
-            if (!validTransportationRouteTo) { // If the transportation route to is not valid
-                cout << "Invalid format. Please enter a valid location in the format 'city, state'." << endl; // Tell the user that the transportation route to is invalid, will loop again
+                if (blockNumberInput != "*") {
+                    return;
+                }
             }
+            temp = temp->next;
         }
 
-        bool correctTransportationDepartureDate = false; // Set the correct transportation departure date flag to false
-        while (!correctTransportationDepartureDate) { // While loop to keep asking the user to enter a valid transportation departure date
-            cout << "Enter Transportation Departure Date (format: dd/mm/yy): "; // Ask the user to enter the transportation departure date, the format is: dd/mm/yy
-            getline(cin, transportationDepartureDateTime); // Get user input for the transportation departure date
+        if (!found) {
+            cout << "\nBlock with number " << blockNumberInput << " not found." << endl;
+        }
+    }
 
-            if (transportationDepartureDateTime.length() == 8 && transportationDepartureDateTime[2] == '/' && transportationDepartureDateTime[5] == '/') { // Check if the transportation departure date is in the correct format
-                string dayString = transportationDepartureDateTime.substr(0, 2); // Get the day from the transportation departure date
-                string monthString = transportationDepartureDateTime.substr(3, 2); // Get the month from the transportation departure date
-                string yearString = transportationDepartureDateTime.substr(6, 2); // Get the year from the transportation departure date
-                int day = stoi(dayString); // Convert the day string to an integer
-                int month = stoi(monthString); // Convert the month string to an integer
-                int year = stoi(yearString); // Convert the year string to an integer
+    void searchBlockByNumber() { // Method to search block, unaffected by any deletions
+        BlockNode* temp = head; // Create a temporary block node and set it to the head of the blockchain, this will be used to traverse the blockchain to search for the block
+        bool found = false;  // Declare flag to indicate if the block was found
+        cout << "\nEnter which block number you want to search (format: 1, 2, 3, ...) (* to view all): "; 
+        string blockNumberInput; // Delcare variable
+        cin >> blockNumberInput;  // Get user input
 
-                if (day >= 1 && day <= 31 && month >= 1 && month <= 12 && year >= 0 && year >= 24) { // Check if the day, month, and year are valid, the day must be between 1 and 31, the month must be between 1 and 12, and the year must be between 0 and 99
-                    correctTransportationDepartureDate = true; // Set the correct transportation departure date flag to true, this means that the transportation departure date is valid
+        if (blockNumberInput == "*") { //If is asterisk then show all
+            while (temp != nullptr) { 
+                shared_ptr<const Block> whole = blockOf(current(temp)); // Whole block, read back if it was evicted
+                const Block& block = *whole; 
+                cout << "\nBlock " << block.blockNumber << " | " << block.currentHashNumber << " | " << block.previousHashNumber << " | " << formatTimeStamp(block.currentTimeStamp) << (block.signer.empty() ? "" : " signed by " + block.signer + " |") << " information: "; 
+
+                for (size_t i = 0; i < block.information.size(); ++i) { 
+                    const pair<string, string>& info = block.information[i]; 
+                    cout << " " << info.first << ": " << info.second << " | "; 
+                }
+                cout << endl; 
+                temp = temp->next; 
+            } 
+            return; 
+        }
+
+        int blockNumber = stoi(blockNumberInput);  //convert the string into int so user can search for speciic block
+        while (temp != nullptr) { 
+            if (temp->data.blockNumber == blockNumber) { 
+                shared_ptr<const Block> whole = blockOf(current(temp)); // Whole block, read back if it was evicted
+                const Block& block = *whole; 
+                found = true; 
+                cout << "\nBlock " << block.blockNumber << " | " << block.currentHashNumber << " | " << block.previousHashNumber << " | " << formatTimeStamp(block.currentTimeStamp) << (block.signer.empty() ? "" : " signed by " + block.signer + " |") << " information: "; 
+
+                for (size_t i = 0; i < block.information.size(); ++i) { 
+                    const pair<string, string>& info = block.information[i]; 
+                    cout << " " << info.first << ": " << info.second << " | "; 
                 }
+                cout << endl; 
+                break; 
             }
+            temp = temp->next; 
+        } 
 
-            if (!correctTransportationDepartureDate) { // If the transportation departure date is not valid
-                cout << "Invalid format. Please enter a valid Order Date (format: dd/mm/yy) Ensure that year is on or after 2024." << endl; // Tell the user that the transportation departure date is invalid, will loop again
+        if (!found) { 
+            cout << "\nBlock with number " << blockNumber << " not found." << endl; 
+        }
+    }
+
+    void replaceBlock(const Block& updated) { // Replace the block with the same block number as the one passed in, snapshots sharing the old nodes keep seeing the old block. The newest block is swapped at the head, an older block gets a changed copy in changedNodes instead of a copy of every newer node, so a deletion costs one new node and a copy of the changed block map while a snapshot shares it, never a copy of the chain
+        BlockNode* copy = new BlockNode(updated); // Copy the block into a new node, it is encoded again
+        if (head->data.blockNumber == updated.blockNumber) { // If the block is the newest
+            copy->next = head->next; // The rest of the chain is shared
+            BlockNode* replaced = head; // Node being replaced
+            head = copy; // Publish the new head
+            replaceHotNode(replaced, copy); // The copy takes the place of the old head in the hot set
+            return;
+        }
+        if (changedNodes.use_count() > 1) { // If a snapshot shares the changed blocks
+            changedNodes = make_shared<unordered_map<int, BlockNode*> >(*changedNodes); // Copy them, the snapshot keeps seeing the blocks as they were
+        }
+        (*changedNodes)[updated.blockNumber] = copy; // Reads of the block find the copy from now on
+        replaceHotNode(nullptr, copy); // Track the copy, the old node stays linked and keeps its own place
+    }
+
+    void replaceHotNode(BlockNode* replaced, BlockNode* copy) { // Put a copy made by replaceBlock in the hot set, in the place of the node it replaces if that node is hot, so the hot set stays oldest first
+        if (coldStore.hotLimit() == 0) { // If nothing is evicted
+            return;
+        }
+        if (replaced != nullptr) { // If the copy replaces a node outright
+            deque<BlockNode*>::iterator hot = find(hotNodes.begin(), hotNodes.end(), replaced); // Place of the replaced node
+            if (hot != hotNodes.end()) { // If the replaced node is hot
+                *hot = copy; // The copy takes its place
+                return;
             }
         }
+        hotNodes.push_front(copy); // Track the copy as the oldest, the block it replaces was already evicted or is older than every hot block
+        evictOldestBlocks(); // Evict it again if the hot set is full
+    }
 
-        bool correctTransportationArrivalDate = false; // Set the correct transportation arrival date flag to false
-        while (!correctTransportationArrivalDate) { // While loop to keep asking the user to enter a valid transportation arrival date
-            cout << "Enter Transportation Estimated Arrival Date (format: dd/mm/yy): "; // Ask the user to enter the transportation estimated arrival date, the format is: dd/mm/yy
-            getline(cin, transportationEstimatedArrivalDateTime); // Get user input for the transportation estimated arrival date
+    void softDeleteBlock(int blockNumber) { // Function to soft delete a block by block number
+        BlockNode* currentNode = head; // Create a temporary block node and set it to the head of the blockchain, this will be used to traverse the blockchain to search for the block
+        while (currentNode != nullptr && currentNode->data.blockNumber != blockNumber) { // While loop to traverse the blockchain to search for the block
+            currentNode = currentNode->next; // Move to the next block
+        }
 
-            if (transportationEstimatedArrivalDateTime.length() == 8 && transportationEstimatedArrivalDateTime[2] == '/' && transportationEstimatedArrivalDateTime[5] == '/') { // Check if the transportation estimated arrival date is in the correct format
-                string dayString = transportationEstimatedArrivalDateTime.substr(0, 2); // Get the day from the transportation estimated arrival date
-                string monthString = transportationEstimatedArrivalDateTime.substr(3, 2); // Get the month from the transportation estimated arrival date
-                string yearString = transportationEstimatedArrivalDateTime.substr(6, 2); // Get the year from the transportation estimated arrival date
-                int day = stoi(dayString); // Convert the day string to an integer
-                int month = stoi(monthString); // Convert the month string to an integer
-                int year = stoi(yearString); // Convert the year string to an integer
+        if (currentNode == nullptr) { // If the block was not found
+            cout << "Block with block number " << blockNumber << " not found." << endl; // Tell the user that the block with the specified block number was not found
+            return;
+        }
 
-                if (day >= 1 && day <= 31 && month >= 1 && month <= 12 && year >= 0 && year >= 24) { // Check if the day, month, and year are valid, the day must be between 1 and 31, the month must be between 1 and 12, and the year must be between 0 and 99
-                    // Check if the arrival date is equal to or after the departure date
-                    if (year > stoi(transportationDepartureDateTime.substr(6, 2)) ||
-                        (year == stoi(transportationDepartureDateTime.substr(6, 2)) && month > stoi(transportationDepartureDateTime.substr(3, 2))) ||
-                        (year == stoi(transportationDepartureDateTime.substr(6, 2)) && month == stoi(transportationDepartureDateTime.substr(3, 2)) && day >= stoi(transportationDepartureDateTime.substr(0, 2)))) {
-                        correctTransportationArrivalDate = true; // Set the correct transportation arrival date flag to true, this means that the transportation arrival date is valid
-                    } else {
-                        cout << "Invalid arrival date. Arrival date must be equal to or after the departure date." << endl; // Tell the user that the transportation arrival date is invalid, will loop again
-                    }
-                }
-            }
+        if (current(currentNode)->data.isSoftDeleted) { // If the block has already been soft deleted
+            cout << "Block with block number " << blockNumber << " has already been soft deleted." << endl; // Tell the user that the block with the specified block number has already been soft deleted
+            return;
+        }
 
-            if (!correctTransportationArrivalDate) { // If the transportation arrival date is not valid
-                cout << "Invalid format. Please enter a valid Order Date (format: dd/mm/yy) Ensure that year is on or after 2024." << endl; // Tell the user that the transportation arrival date is invalid, will loop again
-            }
+        if (current(currentNode)->data.isHardDeleted) { // If the block has already been hard deleted
+            cout << "Block with block number " << blockNumber << " has been hard deleted and cannot be soft deleted." << endl; // Tell the user that the block with the specified block number has already been hard deleted and cannot be soft deleted
+            return;
         }
-        
-        block.information.push_back(make_pair("Block", "Transportation Information")); // Add the transportation information block to the block information
-        block.information.push_back(make_pair("Transportation Mode", transportationMode)); // Add the transportation mode to the block information
-        block.information.push_back(make_pair("Transportation Company", transportationCompany)); // Add the transportation company to the block information
-        block.information.push_back(make_pair("Transportation Route", transportationRouteFrom + " to " + transportationRouteTo)); // Add the transportation route to the block information
-        block.information.push_back(make_pair("Transportation Departure Date", transportationDepartureDateTime)); // Add the transportation departure date to the block information
-        block.information.push_back(make_pair("Transportation Estimated Arrival Date", transportationEstimatedArrivalDateTime)); // Add the transportation estimated arrival date to the block information
 
-        cout << "\n\nTransportation Information Block Successfully Added.\n"; // Tell the user that the transportation information block has been successfully added
+        if (!logHealthy()) { // If an earlier record could not be written
+            cout << "Error: The log on disk has failed, the block was not soft deleted." << endl; // Tell the user
+            return;
+        }
+
+        Block deletedBlock = *blockOf(current(currentNode)); // Copy the block, it may be shared with a snapshot
+        deletedBlock.isSoftDeleted = true; // Set the isSoftDeleted flag to true
+        replaceBlock(deletedBlock); // Link the deleted copy in place of the block
+        lifecycleViewValid = false; // The lifecycle view still points at the block before the deletion
+        logDeletion(blockNumber, false); // Log the deletion
+        if (!waitForLog()) { // If the deletion could not be written to the log
+            cout << "Error: The deletion of block " << blockNumber << " could not be written to the log and is lost when the program exits." << endl; // Tell the user
+            return;
+        }
+        cout << "Information in block with block number " << blockNumber << " has been soft deleted." << endl; // Tell the user that the information in the block with the specified block number has been soft deleted
     }
 
-    string expectedProductWorthiness; // Declare a string to store the expected product worthiness value
+    void hardDeleteBlock(int blockNumber) { // Function to hard delete a block by block number
+        BlockNode* currentNode = head; // Create a temporary block node and set it to the head of the blockchain, this will be used to traverse the blockchain to search for the block
+        while (currentNode != nullptr && currentNode->data.blockNumber != blockNumber) { // While loop to traverse the blockchain to search for the block
+            currentNode = currentNode->next; // Move to the next block
+        }
 
-    void addCustomerDeliverySatisfactionInformation(Block& block) { // Function to add the customer delivery satisfaction information to the block
-        string deliveryConfirmation, customerFeedbackCollection, satisfactionSurvey; // Declare strings to store the delivery confirmation, customer feedback collection, and satisfaction survey values
+        if (currentNode == nullptr) { // If the block was not found
+            cout << "Block with block number " << blockNumber << " not found." << endl; // Tell the user that the block with the specified block number was not found
+            return;
+        }
+
+        if (current(currentNode)->data.isHardDeleted) { // If the block has already been hard deleted
+            cout << "Block with block number " << blockNumber << " has already been hard deleted." << endl; // Tell the user that the block with the specified block number has already been hard deleted
+            return;
+        }
+
+        if (current(currentNode)->data.isSoftDeleted) { // If the block has been soft deleted
+            cout << "Block with block number " << blockNumber << " has been soft deleted and cannot be hard deleted." << endl; // Tell the user that the block with the specified block number has been soft deleted and cannot be hard deleted
+            return;
+        }
 
-        bool validDeliveryConfirmation = false; // Set the valid delivery confirmation flag to false
- 
-        while (!validDeliveryConfirmation) { // While loop to keep asking the user to enter a valid delivery confirmation
-            cout << "\nEnter Delivery Confirmation (format: Delivered, Unsuccessful, Rescheduled): "; // Ask the user to enter the delivery confirmation, the format is: Delivered, Unsuccessful, Rescheduled
-            getline(cin, deliveryConfirmation); // Get user input for the delivery confirmation
+        if (!logHealthy()) { // If an earlier record could not be written
+            cout << "Error: The log on disk has failed, the block was not hard deleted." << endl; // Tell the user
+            return;
+        }
 
-            transform(deliveryConfirmation.begin(), deliveryConfirmation.end(), deliveryConfirmation.begin(), ::tolower); // Convert the delivery confirmation to lowercase
+        Block deletedBlock = *blockOf(current(currentNode)); // Copy the block, it may be shared with a snapshot
+        deletedBlock.isHardDeleted = true; // Set the isHardDeleted flag to true
+        replaceBlock(deletedBlock); // Link the deleted copy in place of the block
+        lifecycleViewValid = false; // The lifecycle view still points at the block before the deletion
+        logDeletion(blockNumber, true); // Log the deletion
+        if (!waitForLog()) { // If the deletion could not be written to the log
+            cout << "Error: The deletion of block " << blockNumber << " could not be written to the log and is lost when the program exits." << endl; // Tell the user
+            return;
+        }
+        cout << "Block with block number " << blockNumber << " has been hard deleted." << endl; // Tell the user that the block with the specified block number has been hard deleted
+    }
+};
 
-            if (deliveryConfirmation == "delivered" || deliveryConfirmation == "unsuccessful" || deliveryConfirmation == "rescheduled") { // Check if the delivery confirmation is valid, the delivery confirmation must be: Delivered, Unsuccessful, Rescheduled
-                validDeliveryConfirmation = true; // Set the valid delivery confirmation flag to true, this means that the delivery confirmation is valid
-            }
-            else { // If the delivery confirmation is not valid
-                cout << "Invalid status. Please enter 'Delivered', 'Unsuccessful', 'Rescheduled'." << endl; // Tell the user that the delivery confirmation is invalid, will loop again
-            }
+class ShardedBlockchain { // Set of independent blockchains that append in parallel, with the tip of every shard anchored into a root chain so global integrity can still be verified
+private: // Private members
+    vector<unique_ptr<PersistenceWriter> > shardLogs; // Write-ahead log of each shard, declared before the chains so they outlive any checkpoint a chain is still writing
+    unique_ptr<PersistenceWriter> rootLog; // Write-ahead log of the root chain
+    vector<unique_ptr<Blockchain> > shards; // The shard chains
+    vector<unique_ptr<mutex> > shardMutexes; // Lock of each shard, appends to different shards never wait for each other
+    Blockchain root; // Chain holding the anchors of the shard tips
+    mutex rootMutex; // Lock of the root chain
+    bool stopping; // Flag to tell the anchoring thread to finish
+    mutex stopMutex; // Protects the stopping flag
+    condition_variable stopRequested; // Wakes the anchoring thread when it should finish
+    thread anchorThread; // Thread anchoring the shard tips at a fixed interval
+    vector<pair<string, string> > lastAnchor; // Information of the newest anchor, a new anchor is only appended when a shard tip has moved since
+
+    void anchorLoop(int intervalMs) { // Anchoring thread, anchors the shard tips until asked to stop
+        unique_lock<mutex> lock(stopMutex); // Lock the stopping flag
+        while (!stopRequested.wait_for(lock, chrono::milliseconds(intervalMs), [this] { return stopping; })) { // Sleep for the interval unless asked to stop
+            lock.unlock(); // Let a stop request through while anchoring
+            anchor(); // Anchor the shard tips
+            lock.lock(); // Lock the stopping flag again
         }
+    }
 
-        bool validCustomerFeedbackConfirmation = false; // Set the valid customer feedback confirmation flag to false
+public: // Public members
+    ShardedBlockchain(int shardCount) { // Constructor for ShardedBlockchain, creates the shards and the root chain
+        for (int i = 0; i < shardCount; i++) { // For loop to create the shards
+            shards.push_back(unique_ptr<Blockchain>(new Blockchain())); // Create the shard
+            shardMutexes.push_back(unique_ptr<mutex>(new mutex())); // Create its lock
+        }
+        stopping = false; // Anchoring is not stopping
+    }
 
-        while (!validCustomerFeedbackConfirmation) { // While loop to keep asking the user to enter a valid customer feedback collection
-            cout << "Enter Customer Feedback Collection Result (format: Excellent, Good, Average, Poor): "; // Ask the user to enter the customer feedback collection result, the format is: Excellent, Good, Average, Poor
-            getline(cin, customerFeedbackCollection); // Get user input for the customer feedback collection
+    ~ShardedBlockchain() { // Destructor for ShardedBlockchain, stops anchoring
+        stopAnchoring(); // Stop the anchoring thread
+    }
 
-            transform(customerFeedbackCollection.begin(), customerFeedbackCollection.end(), customerFeedbackCollection.begin(), ::tolower); // Convert the customer feedback collection to lowercase
- 
-            if (customerFeedbackCollection == "excellent" || customerFeedbackCollection == "good" || customerFeedbackCollection == "average" || customerFeedbackCollection == "poor") { // Check if the customer feedback collection is valid, the customer feedback collection must be: Excellent, Good, Average, Poor
-                validCustomerFeedbackConfirmation = true; // Set the valid customer feedback confirmation flag to true, this means that the customer feedback collection is valid
-            }
-            else { // If the customer feedback collection is not valid
-                cout << "Invalid status. Please enter 'Excellent', 'Good', 'Average', 'Poor'." << endl; // Tell the user that the customer feedback collection is invalid, will loop again
+    bool persist(const string& prefix) { // Recover every shard and the root chain from their own checkpoint and log, named after the prefix passed in, then log every change from now on, call before serving, returns false if a chain could not be recovered
+        for (size_t i = 0; i < shards.size(); ++i) { // For loop over the shards
+            string name = prefix + "_shard" + to_string(i); // Name of the shard's files
+            lock_guard<mutex> lock(*shardMutexes[i]); // Lock the shard
+            if (!shards[i]->recover(name + "_checkpoint.dat", name + "_wal.dat")) { // Rebuild the shard left by the last run
+                return false;
             }
+            shardLogs.push_back(unique_ptr<PersistenceWriter>(new PersistenceWriter(name + "_wal.dat"))); // Open its log after recovery has cut off any torn record
+            shards[i]->attachPersistence(shardLogs.back().get(), name + "_checkpoint.dat"); // Log every append and deletion of the shard
         }
+        lock_guard<mutex> lock(rootMutex); // Lock the root chain
+        if (!root.recover(prefix + "_root_checkpoint.dat", prefix + "_root_wal.dat")) { // Rebuild the anchors left by the last run
+            return false;
+        }
+        rootLog.reset(new PersistenceWriter(prefix + "_root_wal.dat")); // Open its log
+        root.attachPersistence(rootLog.get(), prefix + "_root_checkpoint.dat"); // Log every anchor
+        return true;
+    }
 
-        bool correctSatisfactionSurvey = false; // Set the correct satisfaction survey flag to false
-        while (!correctSatisfactionSurvey) { // While loop to keep asking the user to enter a valid satisfaction survey
-            cout << "Enter Satisfaction Survey Result (format: 1-10): "; // Ask the user to enter the satisfaction survey result, the format is: 1-10
-            getline(cin, satisfactionSurvey); // Get user input for the satisfaction survey
+    void enableProofOfWork(int difficulty) { // Method to seal the blocks appended to every shard with a proof of work, the anchors in the root chain are not sealed
+        for (size_t i = 0; i < shards.size(); ++i) { // For loop over the shards
+            lock_guard<mutex> lock(*shardMutexes[i]); // Lock the shard
+            shards[i]->enableProofOfWork(difficulty); // Set its difficulty
+        }
+    }
 
-            try { // Try to convert the satisfaction survey to an integer
-                int surveyResult = stoi(satisfactionSurvey); // Convert the satisfaction survey to an integer
-                if (surveyResult >= 1 && surveyResult <= 10) { // Check if the satisfaction survey is valid, the satisfaction survey must be between 1 and 10
-                    correctSatisfactionSurvey = true; // Set the correct satisfaction survey flag to true, this means that the satisfaction survey is valid
-                } else { // If the satisfaction survey is not valid
-                    cout << "Invalid input. Please enter a number between 1 and 10." << endl; // Tell the user that the satisfaction survey is invalid, will loop again
-                }
-            } catch (...) { // Catch any errors
-                cout << "Invalid input. Please enter a number between 1 and 10." << endl; // Tell the user that the satisfaction survey is invalid, will loop again
-            } 
-            expectedProductWorthiness = satisfactionSurvey; // Set the expected product worthiness to the satisfaction survey
+    void enableSigning(shared_ptr<const OperatorKey> key) { // Method to sign the blocks appended to every shard and the anchors in the root chain with the operator's key
+        for (size_t i = 0; i < shards.size(); ++i) { // For loop over the shards
+            lock_guard<mutex> lock(*shardMutexes[i]); // Lock the shard
+            shards[i]->enableSigning(key); // Set its key
         }
+        lock_guard<mutex> lock(rootMutex); // Lock the root chain
+        root.enableSigning(key); // Sign the anchors too
+    }
 
-        block.information.push_back(make_pair("Block", "Customer Delivery Satisfactory Information")); // Add the customer delivery satisfactory information block to the block information
-        block.information.push_back(make_pair("Delivery Confirmation", deliveryConfirmation)); // Add the delivery confirmation to the block information
-        block.information.push_back(make_pair("Customer Feedback Collection", customerFeedbackCollection)); // Add the customer feedback collection to the block information
-        block.information.push_back(make_pair("Satisfaction Survey", satisfactionSurvey)); // Add the satisfaction survey to the block information
+    int shardCount() { // Method to get the number of shards
+        return static_cast<int>(shards.size()); // Return the number of shards
+    }
 
-        cout << "\n\nCustomer Delivery Satisfactory Information Block Successfully Added.\n"; // Tell the user that the customer delivery satisfactory information block has been successfully added
+    Blockchain& shard(int index) { // Method to get a shard, hold its mutex while using it
+        return *shards[index]; // Return the shard
     }
 
-    void addQualityInspectionControlInformation(Block& block) { // Function to add the quality inspection control information to the block
-        string productInspectionDetails, productQuality; // Declare strings to store the product inspection details and product quality values
+    mutex& shardMutex(int index) { // Method to get the lock of a shard
+        return *shardMutexes[index]; // Return the lock
+    }
 
-        bool validproductInspectionDetails = false; // Set the valid product inspection details flag to false
+    Blockchain& rootChain() { // Method to get the root chain, hold the root mutex while using it
+        return root; // Return the root chain
+    }
 
-        while(validproductInspectionDetails == false) { // While loop to keep asking the user to enter a valid product inspection details
-            cout << "\nEnter Product Quality Inspection Result (format: Pass, Fail): "; // Ask the user to enter the product inspection details, the format is: Pass, Fail
-            getline(cin, productInspectionDetails); // Get user input for the product inspection details
+    mutex& rootChainMutex() { // Method to get the lock of the root chain
+        return rootMutex; // Return the lock
+    }
 
-            transform(productInspectionDetails.begin(), productInspectionDetails.end(), productInspectionDetails.begin(), ::tolower); // Convert the product inspection details to lowercase
-            if(productInspectionDetails == "pass" || productInspectionDetails == "fail") { // Check if the product inspection details is valid, the product inspection details must be: Pass, Fail
-                validproductInspectionDetails = true; // Set the valid product inspection details flag to true, this means that the product inspection details is valid
-            } else { // If the product inspection details is not valid
-                cout << "Invalid status. Please enter 'Pass', 'Fail'." << endl; // Tell the user that the product inspection details is invalid, will loop again
-            }
+    int shardOf(const string& shipmentId) { // Method to get the shard a shipment belongs to, every block of a shipment goes to the same shard
+        uint64_t hash = 14695981039346656037ULL; // FNV-1a offset basis
+        for (size_t i = 0; i < shipmentId.size(); ++i) { // For loop over the characters of the shipment ID
+            hash = (hash ^ static_cast<unsigned char>(shipmentId[i])) * 1099511628211ULL; // Mix in the character
         }
+        return static_cast<int>(hash % shards.size()); // Return the shard
+    }
 
-        bool validProductQuality = false; // Set the valid product quality flag to false
-
-        while(validProductQuality == false) { // While loop to keep asking the user to enter a valid product quality
-            cout << "Enter Product Quality (format: Excellent, Good, Average, Poor): "; // Ask the user to enter the product quality, the format is: Excellent, Good, Average, Poor
-            getline(cin, productQuality); // Get user input for the product quality
+    int appendBlock(const vector<pair<string, string> >& info, int& shardIndex) { // Append a block to the shard of its shipment, safe to call from many threads, returns the block number within the shard
+        Block probe(0, "", "", 0); // Declare a block to read the shipment ID from
+        probe.information = info; // Set its information
+        shardIndex = shardOf(shipmentIdOf(probe)); // Get the shard of the shipment
+        lock_guard<mutex> lock(*shardMutexes[shardIndex]); // Lock only that shard
+        return shards[shardIndex]->appendBlock(info); // Append the block
+    }
 
-            transform(productQuality.begin(), productQuality.end(), productQuality.begin(), ::tolower); // Convert the product quality to lowercase
-            if(productQuality == "excellent" || productQuality == "good" || productQuality == "average" || productQuality == "poor") { // Check if the product quality is valid, the product quality must be: Excellent, Good, Average, Poor
-                validProductQuality = true; // Set the valid product quality flag to true, this means that the product quality is valid
-            } else { // If the product quality is not valid
-                cout << "Invalid status. Please enter 'Excellent', 'Good', 'Average', 'Poor'." << endl; // Tell the user that the product quality is invalid, will loop again
-            }
+    void anchor() { // Append a block to the root chain holding the block count and tip hash of every shard
+        vector<pair<string, string> > anchorInfo; // Information of the anchor block
+        anchorInfo.push_back(make_pair("Block", "Shard Anchor")); // Name the block
+        for (size_t i = 0; i < shards.size(); ++i) { // For loop over the shards
+            lock_guard<mutex> lock(*shardMutexes[i]); // Lock the shard while reading its tip
+            int count = shards[i]->getCurrentBlockNumber(); // Number of blocks in the shard
+            shared_ptr<const Block> tip = shards[i]->findBlock(count - 1); // Newest block of the shard
+            anchorInfo.push_back(make_pair("Shard " + to_string(i), to_string(count) + ":" + (tip == nullptr ? "" : tip->currentHashNumber))); // Record the block count and tip hash
         }
+        lock_guard<mutex> lock(rootMutex); // Lock the root chain
+        if (lastAnchor.empty() && root.getCurrentBlockNumber() > 0) { // If no anchor was appended by this run, the newest one may come from the last run
+            lastAnchor = root.findBlock(root.getCurrentBlockNumber() - 1)->information; // Start from the newest anchor recovered
+        }
+        if (anchorInfo == lastAnchor) { // If no shard tip has moved since the newest anchor
+            return; // An idle system does not grow the root chain
+        }
+        root.appendBlock(anchorInfo); // Append the anchor
+        lastAnchor = anchorInfo; // Remember it
+        if (!root.waitForLog()) { // If the anchor could not be written to the log
+            cout << "Error: The shard anchor could not be written to the log." << endl; // Tell the user
+        }
+    }
 
-        block.information.push_back(make_pair("Block", "Quality Inspection Control Information")); // Add the quality inspection control information block to the block information
-        block.information.push_back(make_pair("Quality Inspection Result", productInspectionDetails)); // Add the product inspection details to the block information
-        block.information.push_back(make_pair("Product Quality", productQuality)); // Add the product quality to the block information
-
-        cout << "\n\nQuality Inspection Control Information Block Successfully Added.\n"; // Tell the user that the quality inspection control information block has been successfully added
+    void startAnchoring(int intervalMs) { // Start anchoring the shard tips every interval
+        stopping = false; // Anchoring is running
+        anchorThread = thread(&ShardedBlockchain::anchorLoop, this, intervalMs); // Start the anchoring thread
     }
 
-    void addProductReturnInformation(Block& block) { // Function to add the product return information to the block
-        string productReturnStatus, productReturnReason, productRefundStatus; // Declare strings to store the product return status, product return reason and product refund status values
+    void stopAnchoring() { // Stop anchoring, the thread finishes its current anchor first
+        {
+            lock_guard<mutex> lock(stopMutex); // Lock the stopping flag
+            stopping = true; // Ask the thread to finish
+        }
+        stopRequested.notify_all(); // Wake the thread
+        if (anchorThread.joinable()) { // If the thread was started
+            anchorThread.join(); // Wait for it to finish
+        }
+    }
 
-        bool validProductReturnStatus = false; // Set the valid product return status flag to false
+    bool verify() { // Check every shard, the root chain, and that every anchored tip hash is still the hash of that block in its shard
+        for (size_t i = 0; i < shards.size(); ++i) { // For loop over the shards
+            lock_guard<mutex> lock(*shardMutexes[i]); // Lock the shard
+            if (!shards[i]->verifyChain()) { // If the shard's links are broken
+                return false;
+            }
+        }
+        lock_guard<mutex> rootLock(rootMutex); // Lock the root chain
+        if (!root.verifyChain()) { // If the root chain's links are broken
+            return false;
+        }
+        for (int anchorNumber = 0; anchorNumber < root.getCurrentBlockNumber(); anchorNumber++) { // For loop over the anchors
+            shared_ptr<const Block> anchorBlock = root.findBlock(anchorNumber); // Get the anchor
+            for (size_t i = 1; i < anchorBlock->information.size(); ++i) { // For loop over the anchored shards, after the block name
+                int shardIndex = stoi(anchorBlock->information[i].first.substr(6)); // Shard of the entry
+                const string& value = anchorBlock->information[i].second; // Block count and tip hash
+                size_t colon = value.find(':'); // End of the block count
+                int count = stoi(value.substr(0, colon)); // Block count when anchored
+                if (count == 0 || shardIndex < 0 || shardIndex >= shardCount()) { // If the shard was empty or is unknown
+                    continue;
+                }
+                lock_guard<mutex> lock(*shardMutexes[shardIndex]); // Lock the shard
+                shared_ptr<const Block> tip = shards[shardIndex]->findBlock(count - 1); // Block that was the tip
+                if (tip == nullptr || tip->currentHashNumber != value.substr(colon + 1)) { // If the tip has changed since it was anchored
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+};
 
-        while(validProductReturnStatus == false) { // While loop to keep asking the user to enter a valid product return status
-            cout << "\nEnter Product Return Status (format: Returned, Not Returned): "; // Ask the user to enter the product return status, the format is: Returned, Not Returned
-            getline(cin, productReturnStatus); // Get user input for the product return status
+bool authenticate(const string& username, const string& password) { // Function to authenticate the user, this function takes a username and password as parameters
+    ifstream file("username_password.txt"); // Create an input file stream with the filename
+    if (!file.is_open()) { // If the file is not open
+        cout << "Error opening file." << endl; // Tell the user that there was an error opening the file
+        return false; // Return false
+    }
 
-            transform(productReturnStatus.begin(), productReturnStatus.end(), productReturnStatus.begin(), ::tolower); // Convert the product return status to lowercase
-            if(productReturnStatus == "returned" || productReturnStatus == "not returned") { // Check if the product return status is valid, the product return status must be: Returned, Not Returned
-                validProductReturnStatus = true; // Set the valid product return status flag to true, this means that the product return status is valid
-            } else { // If the product return status is not valid
-                cout << "Invalid status. Please enter 'Returned', 'Not Returned'." << endl; // Tell the user that the product return status is invalid, will loop again
+    string lineUsernamePassword; // Declare a string to store each line of the file
+    while (getline(file, lineUsernamePassword)) { // While loop to read each line of the file
+        stringstream ss(lineUsernamePassword); // Create a string stream with the line
+        string storedUsername, storedPassword; // Declare strings to store the username and password from the file
+        if (getline(ss, storedUsername, ',') && getline(ss, storedPassword)) { // If the username and password are successfully read from the file
+            storedUsername.erase(remove_if(storedUsername.begin(), storedUsername.end(), ::isspace), storedUsername.end()); // Remove any whitespace from the stored username
+            storedPassword.erase(remove_if(storedPassword.begin(), storedPassword.end(), ::isspace), storedPassword.end()); // Remove any whitespace from the stored password
+            if (username == storedUsername && password == storedPassword) { // If the username and password match the stored username and password
+                file.close(); // Close the file
+                return true; // Return true
             }
         }
+    }
 
-        bool validProductRefundStatus = false; // Set the valid product refund status flag to false
-
-        while(validProductRefundStatus == false) { // While loop to keep asking the user to enter a valid product refund status
-            cout << "Enter Product Refund Status (format: Refunded, Not Refunded): "; // Ask the user to enter the product refund status, the format is: Refunded, Not Refunded
-            getline(cin, productRefundStatus); // Get user input for the product refund status
+    file.close(); // Close the file
+    return false; // Return false
+}
 
-            transform(productRefundStatus.begin(), productRefundStatus.end(), productRefundStatus.begin(), ::tolower); // Convert the product refund status to lowercase
-            if(productRefundStatus == "refunded" || productRefundStatus == "not refunded") { // Check if the product refund status is valid, the product refund status must be: Refunded, Not Refunded
-                validProductRefundStatus = true; // Set the valid product refund status flag to true, this means that the product refund status is valid
-            } else { // If the product refund status is not valid
-                cout << "Invalid status. Please enter 'Refunded', 'Not Refunded'." << endl; // Tell the user that the product refund status is invalid, will loop again
-            }
+shared_ptr<const OperatorKey> loadOperatorKey(const string& username) { // Function to load the signing key of an operator from operator_<username>.key, the first time an operator logs in a new key is made from the system's random source, readable only by its owner, and its public key is registered
+    string filename = "operator_" + username + ".key"; // File of the key
+    string seed, hex; // Declare the seed and the seed as written
+    ifstream keyFile(filename); // Open the key
+    if (keyFile >> hex) { // If the operator has a key
+        if (!fromHex(hex, seed) || seed.size() != SIGNATURE_KEY_BYTES) { // If the key is damaged
+            cout << "Error: Signing key " << filename << " is damaged, blocks will not be signed." << endl; // Tell the user
+            return nullptr;
+        }
+    } else { // If the operator has no key yet
+        seed.assign(SIGNATURE_KEY_BYTES, '\0'); // Make room for the seed
+        int randomFd = open("/dev/urandom", O_RDONLY); // Open the system's random source
+        bool seeded = randomFd != -1 && read(randomFd, &seed[0], seed.size()) == static_cast<ssize_t>(seed.size()); // Read the seed
+        if (randomFd != -1) { // If the source was opened
+            close(randomFd); // Close it
         }
+        string line = toHex(seed) + "\n"; // The seed as written
+        int keyFd = seeded ? open(filename.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0600) : -1; // Create the key file, never replacing an existing key
+        bool written = keyFd != -1 && write(keyFd, line.data(), line.size()) == static_cast<ssize_t>(line.size()) && fsync(keyFd) == 0; // Write the seed
+        if (keyFd != -1) { // If the file was created
+            close(keyFd); // Close it
+        }
+        if (!written) { // If the key could not be made
+            cout << "Error: Unable to create signing key " << filename << ", blocks will not be signed." << endl; // Tell the user
+            return nullptr;
+        }
+        cout << "\nCreated signing key " << filename << " for " << username << "." << endl; // Tell the user where the key is kept
+    }
+    shared_ptr<OperatorKey> key = make_shared<OperatorKey>(deriveOperatorKey(seed)); // Expand the seed
+    key->name = username; // Set the operator
+    if (!operatorRegistry.registerKey(username, key->publicKey)) { // If another key is registered for the operator
+        cout << "Error: " << filename << " is not the key registered for " << username << " in " << OPERATOR_REGISTRY << ", blocks will not be signed." << endl; // Tell the user, blocks signed with it would be rejected
+        return nullptr;
+    }
+    return key; // Return the key
+}
 
-        cout << "Enter Product Return Reason: "; // Ask the user to enter the product return reason
-        getline(cin, productReturnReason); // Get user input for the product return reason
+// Server protocol, every request and response is a frame of one byte followed by a 32 bit payload length and the payload.
+// Requests carry an operation code, responses carry a status code.
+const unsigned char SERVER_APPEND = 1; // Payload: pair count then key and value strings. Response: block number
+const unsigned char SERVER_GET = 2; // Payload: block number. Response: encoded block
+const unsigned char SERVER_QUERY = 3; // Payload: key and value strings. Response: block count then encoded blocks
+const unsigned char SERVER_VERIFY = 4; // Payload: empty. Response: one byte, 1 if the chain links are intact
+const unsigned char SERVER_LIFECYCLE = 5; // Payload: shipment ID string. Response: for each of the eight stages a presence byte followed by the encoded block when present
+const unsigned char SERVER_STATS = 6; // Payload: empty. Response: role byte (0 leader, 1 follower), number of blocks, replication lag in blocks, hot blocks in memory, blocks evicted to the cold store, block cache hits and misses
+const unsigned char SERVER_QUERY_TEXT = 7; // Payload: query string, such as "stage=transportation AND mode=Air LIMIT 100". Response: block count then encoded blocks, newest first
+const unsigned char STATUS_OK = 0; // The request succeeded
+const unsigned char STATUS_NOT_FOUND = 1; // The block does not exist or has been hard deleted
+const unsigned char STATUS_BAD_REQUEST = 2; // The request could not be decoded
+const unsigned char STATUS_READ_ONLY = 3; // Appends are refused while the server follows a leader
+const unsigned char STATUS_NOT_DURABLE = 4; // The log on disk has failed, the append was refused or could not be written and is not kept across a restart
+const unsigned char STATUS_WRONG_SHARD = 5; // The shipment of the append belongs to another shard. Response: index of the shard to send it to
+
+// Replication protocol between a leader and its followers, using the same framing as the server protocol.
+const unsigned char REPLICATION_HELLO = 1; // Follower to leader. Payload: number of blocks the follower already has
+const unsigned char REPLICATION_BATCH = 2; // Leader to follower. Payload: number of blocks on the leader, block count, then the blocks encoded with their information, then deletion count and for each deletion of a block the follower already has its block number and a byte, 1 if it was hard
+const size_t REPLICATION_BATCH_BLOCKS = 256; // Largest number of blocks sent in one batch
+const int LEADER_LINK_OPEN = 0; // The leader is alive and its batches were applied
+const int LEADER_LINK_LOST = 1; // The leader closed the link, the socket failed or the heartbeats stopped, a follower takes over
+const int LEADER_LINK_REJECTED = 2; // The leader is alive but sent damaged, forged or diverging blocks, a follower stops replicating and stays read only
+const uint32_t MAX_FRAME_LENGTH = 1 << 20; // Largest payload accepted from a client, larger frames close the connection
+const size_t REPLICATION_BATCH_BYTES = MAX_FRAME_LENGTH; // Largest batch payload, a batch stops before the block that would pass it so large blocks never make a frame the follower rejects
+const uint32_t MAX_REPLICATION_FRAME_LENGTH = 2 * MAX_FRAME_LENGTH; // Largest batch accepted from a leader, room for a batch of one block whose information filled a whole client frame, plus its hashes and signature
+
+volatile sig_atomic_t serverStopRequested = 0; // Flag set by the signal handler to stop the server
+
+void requestServerStop(int) { // Signal handler to stop the server loop
+    serverStopRequested = 1; // Set the stop flag
+}
 
-        string productReturnNumber = "R" + to_string(rand() % 90000 + 10000); // Generate a random product return number
+class ChainServer { // Server that shares one blockchain between many client sessions over a Unix domain socket, and can stream its blocks to follower processes or follow a leader
+private: // Private members
+    struct ClientSession { // Connection state of one client
+        int fd; // Socket of the client
+        string input; // Bytes received and not yet handled
+        string output; // Bytes waiting to be sent
+        vector<size_t> appendResponses; // Offsets in output of the append responses waiting for the log
+    };
+
+    struct FollowerLink { // Connection state of one follower of this server
+        int fd; // Socket of the follower
+        string input; // Bytes received and not yet handled
+        string output; // Bytes waiting to be sent
+        int nextBlockNumber; // Next block to send to the follower, -1 until the follower has said how many blocks it has
+        size_t nextDeletion; // Next deletion of the chain to pass on to the follower
+        deque<pair<int, bool> > pendingDeletions; // Deletions of blocks the follower already has, waiting to be sent
+        time_t lastSent; // Time the last batch was sent, an empty batch is sent every second so the follower knows the leader is alive
+    };
+
+    Blockchain& chain; // Blockchain served to the clients
+    mutex* chainMutex; // Lock shared with other threads using the blockchain, nullptr when the server is its only user
+    string socketPath; // Path of the Unix domain socket
+    int listenFd; // Socket accepting new clients
+    vector<ClientSession> sessions; // Connected clients
+
+    string replicationPath; // Path of the socket followers connect to
+    int replicationListenFd; // Socket accepting new followers, -1 when blocks are not replicated
+    vector<FollowerLink> followers; // Connected followers
+
+    int leaderFd; // Socket connected to the leader, -1 when this server is not following a leader
+    string leaderInput; // Bytes received from the leader and not yet handled
+    string leaderOutput; // Bytes waiting to be sent to the leader
+    time_t lastLeaderMessage; // Time the last batch arrived from the leader
+    bool readOnly; // Flag to indicate that appends are refused because this server follows a leader
+    bool replicationStopped; // Flag to indicate that this server stopped following a leader that sent bad blocks, it stays read only and does not take over
+    int leaderBlockCount; // Number of blocks on the leader when its last batch was sent
+    ShardedBlockchain* shardSet; // Shards the chain belongs to, nullptr when the chain is not a shard
+    int shardIndex; // Index of the chain in its shards
+
+    bool setNonBlocking(int fd) { // Put a socket in non blocking mode so a slow client never stalls the loop
+        int flags = fcntl(fd, F_GETFL, 0); // Get the current flags
+        return flags != -1 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) != -1; // Add the non blocking flag
+    }
 
-        block.information.push_back(make_pair("Block", "Product Returns Information")); // Add the product returns information block to the block information
-        block.information.push_back(make_pair("Product Return Number", productReturnNumber)); // Add the product return number to the block information
-        block.information.push_back(make_pair("Product Return Status", productReturnStatus)); // Add the product return status to the block information
-        block.information.push_back(make_pair("Product Return Reason", productReturnReason)); // Add the product return reason to the block information
+    bool makeAddress(const string& path, sockaddr_un& address) { // Fill in the address of a Unix domain socket, returns false if the path is too long
+        if (path.size() >= sizeof(address.sun_path)) { // If the path does not fit in the address
+            cout << "Error: Socket path " << path << " is too long." << endl; // Tell the user that the path is too long
+            return false;
+        }
+        memset(&address, 0, sizeof(address)); // Clear the address
+        address.sun_family = AF_UNIX; // Use a Unix domain socket
+        strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1); // Set the path of the socket
+        return true;
+    }
 
-        cout << "\n\nProduct Returns Information Block Successfully Added.\n"; // Tell the user that the product returns information block has been successfully added
+    int openListeningSocket(const string& path) { // Create a non blocking socket listening on the path passed in, returns -1 if it could not be created
+        sockaddr_un address; // Address of the socket
+        if (!makeAddress(path, address)) { // If the path is too long
+            return -1;
+        }
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0); // Create the socket
+        if (fd == -1) { // If the socket could not be created
+            cout << "Error: Unable to create server socket." << endl; // Tell the user that the socket could not be created
+            return -1;
+        }
+        unlink(path.c_str()); // Remove a socket file left over from an earlier run
+        if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == -1 || listen(fd, 64) == -1 || !setNonBlocking(fd)) { // If the socket could not be bound or listened on
+            cout << "Error: Unable to listen on " << path << "." << endl; // Tell the user that the socket could not be used
+            close(fd); // Close the socket
+            return -1;
+        }
+        return fd; // Return the socket
     }
- 
-    void addProductWorthinessInformation(Block& block) { // Function to add the product worthiness information to the block
-        string productWorthinessStatus, productWorthinessReason; // Declare strings to store the product worthiness status and product worthiness reason values
 
-        bool validProductWorthinessStatus = false; // Set the valid product worthiness status flag to false
- 
-        while (!validProductWorthinessStatus) { // While loop to keep asking the user to enter a valid product worthiness status
-            cout << "\nEnter Product Worthiness Status (format: Continue Product, Discontinue Product): "; // Ask the user to enter the product worthiness status, the format is: Continue Product, Discontinue Product
-            getline(cin, productWorthinessStatus); // Get user input for the product worthiness status
+    void queueFrame(string& output, unsigned char code, const string& payload) { // Frame a message and queue it for sending
+        output += static_cast<char>(code); // Append the operation or status code
+        appendUint32(output, static_cast<uint32_t>(payload.size())); // Append the payload length
+        output += payload; // Append the payload
+    }
 
-            transform(productWorthinessStatus.begin(), productWorthinessStatus.end(), productWorthinessStatus.begin(), ::tolower); // Convert the product worthiness status to lowercase
-            if (productWorthinessStatus == "continue product" || productWorthinessStatus == "discontinue product") { // Check if the product worthiness status is valid, the product worthiness status must be: Continue Product, Discontinue Product
-                validProductWorthinessStatus = true; // Set the valid product worthiness status flag to true, this means that the product worthiness status is valid
-            } else { // If the product worthiness status is not valid
-                cout << "Invalid status. Please enter 'Continue Product', 'Discontinue Product'." << endl; // Tell the user that the product worthiness status is invalid, will loop again
+    void queueResponse(ClientSession& session, unsigned char status, const string& payload) { // Frame a response and queue it for sending
+        queueFrame(session.output, status, payload); // Queue the framed response
+    }
+
+    bool readAvailable(int fd, string& input) { // Read everything a socket has received, returns false when the connection should be closed
+        char buffer[4096]; // Buffer for the received bytes
+        while (true) { // Keep reading until the socket has no more data
+            ssize_t received = read(fd, buffer, sizeof(buffer)); // Read from the socket
+            if (received > 0) { // If data was received
+                input.append(buffer, static_cast<size_t>(received)); // Add the data to the input
+            } else if (received == 0) { // If the other side closed the connection
+                return false; // Close the connection
+            } else if (errno == EAGAIN || errno == EWOULDBLOCK) { // If there is nothing more to read
+                return true; // Keep the connection open
+            } else if (errno != EINTR) { // If the read failed
+                return false; // Close the connection
             }
         }
+    }
 
-        cout << "Enter Product Worthiness Reason: "; // Ask the user to enter the product worthiness reason
-        getline(cin, productWorthinessReason); // Get user input for the product worthiness reason
+    bool takeFrames(string& input, vector<pair<unsigned char, string> >& frames, uint32_t maxLength = MAX_FRAME_LENGTH) { // Move every complete frame out of the input, returns false if a frame is longer than the limit passed in
+        size_t pos = 0; // Start of the next frame
+        while (input.size() - pos >= 5) { // While a frame header is available
+            size_t lengthPos = pos + 1; // Position of the payload length
+            uint32_t length = 0; // Payload length
+            readUint32(input, lengthPos, length); // Read the payload length
+            if (length > maxLength) { // If the frame is too large
+                return false; // Close the connection
+            }
+            if (input.size() - lengthPos < length) { // If the payload has not fully arrived
+                break; // Wait for more data
+            }
+            frames.push_back(make_pair(static_cast<unsigned char>(input[pos]), input.substr(lengthPos, length))); // Take the frame
+            pos = lengthPos + length; // Move to the next frame
+        }
+        input.erase(0, pos); // Drop the frames taken
+        return true;
+    }
 
-        bool correctProductWorthiness = false; // Set the correct product worthiness flag to false
-        while (!correctProductWorthiness) { // While loop to keep asking the user to confirm the product worthiness status
-            string userInput; // Declare a string to store the user input
-            cout << "Based on the customer feedback number, the expected product worthiness is '" << expectedProductWorthiness << "'. Enter 'confirm' to proceed or 'reenter' to re-enter the product worthiness status: "; // Ask the user to confirm the product worthiness status, it uses the productworthiness variable to display the expected product worthiness
-            getline(cin, userInput); // Get user input for the product worthiness status confirmation
+    bool writePending(int fd, string& output) { // Send as much queued output as the socket accepts, returns false when the connection should be closed
+        while (!output.empty()) { // While there is output to send
+            ssize_t sent = write(fd, output.data(), output.size()); // Write to the socket
+            if (sent > 0) { // If data was sent
+                output.erase(0, static_cast<size_t>(sent)); // Drop the sent data
+            } else if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) { // If the socket buffer is full
+                break; // Try again when the socket is writable
+            } else if (sent < 0 && errno == EINTR) { // If the write was interrupted
+                continue; // Try again
+            } else { // If the write failed
+                return false; // Close the connection
+            }
+        }
+        return true; // Keep the connection open
+    }
 
-            transform(userInput.begin(), userInput.end(), userInput.begin(), ::tolower); // Convert the user input to lowercase
-            if (userInput == "confirm") { // If the user input is confirm
-                correctProductWorthiness = true; // Set the correct product worthiness flag to true, this means that the product worthiness status is correct
-            } else if (userInput == "reenter") { // If the user input is reenter
-                cout << "\nEnter Product Worthiness Status (format: Continue Product, Discontinue Product): "; // Ask the user to re-enter the product worthiness status, the format is: Continue Product, Discontinue Product
-                getline(cin, productWorthinessStatus); // Get user input for the product worthiness status
+    int replicationLag() { // Work out how many blocks behind the replication is, seen from this server
+        if (leaderFd != -1) { // If this server follows a leader
+            return max(0, leaderBlockCount - chain.getCurrentBlockNumber()); // Blocks the leader has that this server does not
+        }
+        int lag = 0; // Largest lag of the followers
+        for (size_t i = 0; i < followers.size(); ++i) { // For loop over the followers
+            if (followers[i].nextBlockNumber != -1) { // If the follower is being streamed to
+                lag = max(lag, chain.getCurrentBlockNumber() - followers[i].nextBlockNumber); // Blocks not yet sent to the follower
+            }
+        }
+        return lag; // Return the largest lag
+    }
 
-                transform(productWorthinessStatus.begin(), productWorthinessStatus.end(), productWorthinessStatus.begin(), ::tolower); // Convert the product worthiness status to lowercase
-                if (productWorthinessStatus == "continue product" || productWorthinessStatus == "discontinue product") { // Check if the product worthiness status is valid, the product worthiness status must be: Continue Product, Discontinue Product
-                    validProductWorthinessStatus = true; // Set the valid product worthiness status flag to true, this means that the product worthiness status is valid
-                } else { // If the product worthiness status is not valid
-                    cout << "Invalid status. Please enter 'Continue Product', 'Discontinue Product'." << endl; // Tell the user that the product worthiness status is invalid, will loop again
+    void handleRequest(ClientSession& session, unsigned char operation, const string& payload) { // Run one request against the blockchain
+        string response; // Declare the response payload
+        size_t pos = 0; // Read position in the payload
+
+        switch (operation) { // Switch statement based on the operation code
+            case SERVER_APPEND: { // Append a block
+                if (readOnly) { // If this server follows a leader
+                    queueResponse(session, STATUS_READ_ONLY, response); // Appends must go to the leader
+                    return;
                 }
-            } else { // If the user input is not confirm or reenter
-                cout << "Invalid input. Please enter 'confirm' or 'reenter'." << endl; // Tell the user that the input is invalid, will loop again
+                if (!chain.logHealthy()) { // If an earlier record could not be written
+                    queueResponse(session, STATUS_NOT_DURABLE, response); // Refuse appends that could not be kept
+                    return;
+                }
+                uint32_t count; // Number of information pairs
+                if (!readUint32(payload, pos, count)) { // If the count is missing
+                    queueResponse(session, STATUS_BAD_REQUEST, response); // Reject the request
+                    return;
+                }
+                vector<pair<string, string> > information; // Information of the new block
+                for (uint32_t i = 0; i < count; i++) { // For loop to read the pairs
+                    string key, value; // Declare the key and the value
+                    if (!readString(payload, pos, key) || !readString(payload, pos, value)) { // If the pair is incomplete
+                        queueResponse(session, STATUS_BAD_REQUEST, response); // Reject the request
+                        return;
+                    }
+                    information.push_back(make_pair(key, value)); // Add the pair to the information
+                }
+                if (shardSet != nullptr) { // If the chain is a shard
+                    Block probe(0, "", "", 0); // Declare a block to read the shipment ID from
+                    probe.information = information; // Set its information
+                    int owner = shardSet->shardOf(shipmentIdOf(probe)); // Shard the shipment belongs to
+                    if (owner != shardIndex) { // If it is another shard
+                        appendUint32(response, static_cast<uint32_t>(owner)); // Reply with the shard to use
+                        queueResponse(session, STATUS_WRONG_SHARD, response); // Refuse the append
+                        return;
+                    }
+                }
+                appendUint32(response, static_cast<uint32_t>(chain.appendBlock(information))); // Append the block and reply with its block number
+                session.appendResponses.push_back(session.output.size()); // Remember where the status is, it changes if the log fails
+                queueResponse(session, STATUS_OK, response); // Queue the response
+                return;
+            }
+            case SERVER_GET: { // Get one block
+                uint32_t blockNumber; // Block number requested
+                if (!readUint32(payload, pos, blockNumber)) { // If the block number is missing
+                    queueResponse(session, STATUS_BAD_REQUEST, response); // Reject the request
+                    return;
+                }
+                shared_ptr<const Block> block = chain.findBlock(static_cast<int>(blockNumber)); // Find the block
+                if (block == nullptr || block->isHardDeleted) { // Hard deleted blocks are hidden like in the display menu
+                    queueResponse(session, STATUS_NOT_FOUND, response); // Reply that the block was not found
+                    return;
+                }
+                appendEncodedBlock(*block, response); // Append the block's encoding
+                queueResponse(session, STATUS_OK, response); // Queue the response
+                return;
+            }
+            case SERVER_QUERY: { // Find blocks by key and value
+                string key, value; // Declare the key and the value
+                if (!readString(payload, pos, key) || !readString(payload, pos, value)) { // If the key or the value is missing
+                    queueResponse(session, STATUS_BAD_REQUEST, response); // Reject the request
+                    return;
+                }
+                vector<shared_ptr<const Block> > matches = chain.queryBlocks(key, value); // Find the matching blocks
+                appendUint32(response, static_cast<uint32_t>(matches.size())); // Append the number of matches
+                for (size_t i = 0; i < matches.size(); ++i) { // For loop to encode the matches
+                    appendEncodedBlock(*matches[i], response); // Append the block's encoding
+                }
+                queueResponse(session, STATUS_OK, response); // Queue the response
+                return;
+            }
+            case SERVER_QUERY_TEXT: { // Run a query
+                string text, error; // Declare the query text and the error message
+                ChainQuery query; // Declare the parsed query
+                if (!readString(payload, pos, text) || !parseQuery(text, query, error)) { // If the query is missing or not valid
+                    queueResponse(session, STATUS_BAD_REQUEST, response); // Reject the request
+                    return;
+                }
+                string blocks; // Encoded matching blocks
+                uint32_t matches = static_cast<uint32_t>(chain.runQuery(query, [&blocks](const Block& block) { // Run the query
+                    appendEncodedBlock(block, blocks); // Append each match as it is found
+                    return blocks.size() < MAX_FRAME_LENGTH; // Stop before the response grows past the frame limit
+                }));
+                appendUint32(response, matches); // Append the number of matches
+                response += blocks; // Append the blocks
+                queueResponse(session, STATUS_OK, response); // Queue the response
+                return;
+            }
+            case SERVER_LIFECYCLE: { // Get the latest block of every stage of a shipment
+                string shipmentId; // Declare the shipment ID
+                if (!readString(payload, pos, shipmentId)) { // If the shipment ID is missing
+                    queueResponse(session, STATUS_BAD_REQUEST, response); // Reject the request
+                    return;
+                }
+                const ShipmentLifecycle* lifecycle = chain.findShipment(shipmentId); // Look the shipment up in the lifecycle view
+                if (lifecycle == nullptr) { // If the shipment has no blocks
+                    queueResponse(session, STATUS_NOT_FOUND, response); // Reply that the shipment was not found
+                    return;
+                }
+                for (int stage = 0; stage < STAGE_COUNT; stage++) { // For loop over the stages
+                    response += static_cast<char>(lifecycle->stages[stage] != nullptr ? 1 : 0); // Append whether the stage has happened
+                    if (lifecycle->stages[stage] != nullptr) { // If the stage has happened
+                        appendEncodedBlock(*blockOf(lifecycle->stages[stage]), response); // Append its latest block, read back if it was evicted
+                    }
+                }
+                queueResponse(session, STATUS_OK, response); // Queue the response
+                return;
+            }
+            case SERVER_VERIFY: { // Check the chain links
+                response += static_cast<char>(chain.verifyChain() ? 1 : 0); // Append the result
+                queueResponse(session, STATUS_OK, response); // Queue the response
+                return;
+            }
+            case SERVER_STATS: { // Report the role, size and replication lag of this server
+                response += static_cast<char>(leaderFd != -1 || replicationStopped ? 1 : 0); // Append the role
+                appendUint32(response, static_cast<uint32_t>(chain.getCurrentBlockNumber())); // Append the number of blocks
+                appendUint32(response, static_cast<uint32_t>(replicationLag())); // Append the replication lag
+                appendUint32(response, static_cast<uint32_t>(coldStore.hotLimit() == 0 ? chain.getCurrentBlockNumber() : chain.hotBlockCount())); // Append the blocks in memory
+                appendUint32(response, static_cast<uint32_t>(coldStore.evicted.load())); // Append the blocks evicted
+                appendUint32(response, static_cast<uint32_t>(coldStore.cache.hits.load())); // Append the cache hits
+                appendUint32(response, static_cast<uint32_t>(coldStore.cache.misses.load())); // Append the cache misses
+                queueResponse(session, STATUS_OK, response); // Queue the response
+                return;
             }
+            default: // Unknown operation
+                queueResponse(session, STATUS_BAD_REQUEST, response); // Reject the request
+                return;
         }
-
-        block.information.push_back(make_pair("Block", "Product Worthiness Information")); // Add the product worthiness information block to the block information
-        block.information.push_back(make_pair("Product Worthiness Status", productWorthinessStatus)); // Add the product worthiness status to the block information
-        block.information.push_back(make_pair("Product Worthiness Reason", productWorthinessReason)); // Add the product worthiness reason to the block information
-
-        cout << "\n\nProduct Worthiness Information Block Successfully Added.\n"; // Tell the user that the product worthiness information block has been successfully added
     }
 
-    string generateRandomHash() { // Function to generate a random hash
-        srand(static_cast<unsigned int>(time(nullptr)));  // Seed the random number generator
-        string chars = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789"; // Declare a string of characters to use for the random hash
-        string randHash = ""; // Declare a string to store the random hash
-        for (int i = 0; i < 20; i++) { // For loop to generate the random hash, loop 20 times
-            int index = rand() % chars.size(); // Generate a random index
-            randHash += chars[index]; // Add the character at the random index to the random hash
+    bool readFromClient(ClientSession& session) { // Read what the client has sent and handle every complete frame, returns false when the connection should be closed
+        bool open = readAvailable(session.fd, session.input); // Read the data
+        vector<pair<unsigned char, string> > frames; // Declare the complete frames
+        if (!takeFrames(session.input, frames)) { // If a frame is too large
+            return false; // Close the session
         }
-        return randHash; // Return the random hash
-    }
- 
-    void exportBlocksToFile(const string& filename) { // Function to export the blockchain to a file
-        ofstream outfile(filename); // Create an output file stream with the filename
-        if (!outfile.is_open()) { // If the file is not open
-            cout << "Error: Unable to open file for writing." << endl; // Tell the user that there was an error opening the file
-            return; // Return from the function
+        for (size_t i = 0; i < frames.size(); ++i) { // For loop over the frames
+            handleRequest(session, frames[i].first, frames[i].second); // Handle the frame
         }
+        return open; // Keep the session open unless the client closed it
+    }
 
-        BlockNode* temp = head; // Create a temporary block node and set it to the head of the blockchain, this will be used to traverse the blockchain to export the blocks to the file
-        while (temp != nullptr) { // While loop to traverse the blockchain
-            const Block& block = temp->data; // Get the block data from the temporary block node
-            outfile << "Block " << block.blockNumber << " | " << block.currentHashNumber << " | " << block.previousHashNumber << " | " << block.currentTimeStamp << "information: "; // Write the block number, current hash number, previous hash number, and current time stamp to the file
-
-            for (size_t i = 0; i < block.information.size(); ++i) { // For loop to write the block information to the file
-                const pair<string, string>& info = block.information[i]; // Get the block information from the block data
-                outfile << " " << info.first << ": " << info.second << " | "; // Write the block information to the file
+    bool readFromFollower(FollowerLink& follower) { // Read what a follower has sent, returns false when the connection should be closed
+        bool open = readAvailable(follower.fd, follower.input); // Read the data
+        vector<pair<unsigned char, string> > frames; // Declare the complete frames
+        if (!takeFrames(follower.input, frames)) { // If a frame is too large
+            return false; // Close the connection
+        }
+        for (size_t i = 0; i < frames.size(); ++i) { // For loop over the frames
+            size_t pos = 0; // Read position in the payload
+            uint32_t blockCount; // Number of blocks the follower has
+            if (frames[i].first != REPLICATION_HELLO || !readUint32(frames[i].second, pos, blockCount)) { // Followers only say hello
+                return false; // Close the connection
             }
-            outfile << endl; // End the line
-
-            temp = temp->next; // Move to the next block
+            follower.nextBlockNumber = min(static_cast<int>(blockCount), chain.getCurrentBlockNumber()); // Start streaming after the blocks the follower has
+            vector<pair<int, bool> > deleted = chain.deletedBlocksBelow(follower.nextBlockNumber); // Deletions the follower may have missed while it was away, it ignores the ones it has
+            follower.pendingDeletions.assign(deleted.begin(), deleted.end()); // Send them first
+            follower.nextDeletion = chain.deletionCount(); // Later deletions are passed on as they are made
         }
-
-        outfile.close(); // Close the file
-        cout << "Blocks exported to " << filename << " successfully." << endl; // Tell the user that the blocks have been successfully exported to the file
-    } 
-
-    bool isValidLocation(const string& location, const vector<string>& validLocations) { // Method to check if a location is valid
-        return find(validLocations.begin(), validLocations.end(), location) != validLocations.end(); // Return true if the location is found in the valid locations vector, otherwise return false
-    }
-
-    int getCurrentBlockNumber() { // Method to get the current block number, this is a getter method used to get the current block number
-        return currentBlockNumber; // Return the current block number
+        return open; // Keep the connection open unless the follower closed it
     }
 
-    void displayChain() { //Method to display block, this is strictly for displaying purposes and is strictly "virtual"
-        BlockNode* temp = head; // Create a temporary block node and set it to the head of the blockchain, this will be used to traverse the blockchain to search for the block
-        string blockNumberInput; // Declare a variable to store the block number that the user wants to search
-        cout << "\nEnter the block number you want to view (format: 1, 2, 3, ...) (* to view all): "; //Users can enter the specific block number of enter "*" asterisk to view all
-        cin >> blockNumberInput; // Get user input for the block number they want to search
-
-        bool found = false; // Declare a flag to indicate if the block was found
-        while (temp != nullptr) { // While loop to traverse the blockchain
-            const Block& block = temp->data; // Get the block data from the temporary block node
-            if (!block.isHardDeleted && (blockNumberInput == "*" || stoi(blockNumberInput) == block.blockNumber)) {
-                found = true;
-                cout << "\nBlock " << block.blockNumber << " | " << block.currentHashNumber << " | " << block.previousHashNumber << " | " << block.currentTimeStamp;
-
-                if (!block.isSoftDeleted) { //If the block is soft deleted
-                    cout << " information: ";
-                    for (size_t i = 0; i < block.information.size(); ++i) {
-                        const pair<string, string>& info = block.information[i];
-                        cout << " " << info.first << ": " << info.second << " | ";
-                    }
+    void streamToFollowers() { // Queue a batch of new blocks for every follower that has caught up with its previous batch
+        time_t now = time(0); // Get the current time
+        for (size_t i = 0; i < followers.size(); ++i) { // For loop over the followers
+            FollowerLink& follower = followers[i]; // The follower
+            if (follower.nextBlockNumber == -1 || !follower.output.empty()) { // If the follower has not said hello or is still receiving the previous batch
+                continue;
+            }
+            vector<pair<int, bool> > deletions = chain.deletionsFrom(follower.nextDeletion); // Deletions made since the last batch
+            follower.nextDeletion += deletions.size(); // They are dealt with now
+            for (size_t j = 0; j < deletions.size(); ++j) { // For loop over the deletions
+                if (deletions[j].first < follower.nextBlockNumber) { // A block not sent yet carries its flags when it is sent
+                    follower.pendingDeletions.push_back(deletions[j]);
                 }
+            }
+            if (follower.nextBlockNumber >= chain.getCurrentBlockNumber() && follower.pendingDeletions.empty() && follower.lastSent == now) { // If there is nothing new and a batch was sent this second
+                continue;
+            }
 
-                cout << endl;
-
-                if (blockNumberInput != "*") {
-                    return;
+            vector<shared_ptr<const Block> > blocks = chain.blocksFrom(follower.nextBlockNumber, REPLICATION_BATCH_BLOCKS); // Blocks the follower does not have yet, at most one batch so a follower catching up never reads the whole cold store at once, oldest first
+            string encoded; // Declare the encoded blocks of the batch
+            size_t blockCount = 0; // Blocks that fit in the batch
+            for (; blockCount < blocks.size(); ++blockCount) { // For loop over the blocks
+                size_t before = encoded.size(); // Length before the block
+                appendEncodedBlock(*blocks[blockCount], encoded, true); // Append the block with all of its information and its hashes
+                if (blockCount > 0 && 8 + encoded.size() > REPLICATION_BATCH_BYTES) { // If the block would make the batch too large, the first block is always sent
+                    encoded.resize(before); // Leave it for the next batch
+                    break;
                 }
             }
-            temp = temp->next;
-        }
-
-        if (!found) {
-            cout << "\nBlock with number " << blockNumberInput << " not found." << endl;
+            size_t deletionCount = min(follower.pendingDeletions.size(), (REPLICATION_BATCH_BYTES - min(REPLICATION_BATCH_BYTES, 12 + encoded.size())) / 5); // Deletions that fit after the blocks, the rest go in the next batch
+            string payload; // Declare the batch
+            appendUint32(payload, static_cast<uint32_t>(chain.getCurrentBlockNumber())); // Append the number of blocks on the leader, used by the follower to report its lag
+            appendUint32(payload, static_cast<uint32_t>(blockCount)); // Append the number of blocks in the batch
+            payload += encoded; // Append the blocks
+            appendUint32(payload, static_cast<uint32_t>(deletionCount)); // Append the number of deletions
+            for (size_t j = 0; j < deletionCount; ++j) { // For loop over the deletions
+                appendUint32(payload, static_cast<uint32_t>(follower.pendingDeletions.front().first)); // Append the block number
+                payload += static_cast<char>(follower.pendingDeletions.front().second ? 1 : 0); // Append whether it was hard
+                follower.pendingDeletions.pop_front(); // The deletion is sent
+            }
+            queueFrame(follower.output, REPLICATION_BATCH, payload); // Queue the batch
+            follower.nextBlockNumber += static_cast<int>(blockCount); // The follower will have these blocks next
+            follower.lastSent = now; // Remember when the batch was sent
         }
     }
 
-    void searchBlockByNumber() { // Method to search block, unaffected by any deletions
-        BlockNode* temp = head; // Create a temporary block node and set it to the head of the blockchain, this will be used to traverse the blockchain to search for the block
-        bool found = false;  // Declare flag to indicate if the block was found
-        cout << "\nEnter which block number you want to search (format: 1, 2, 3, ...) (* to view all): "; 
-        string blockNumberInput; // Delcare variable
-        cin >> blockNumberInput;  // Get user input
-
-        if (blockNumberInput == "*") { //If is asterisk then show all
-            while (temp != nullptr) { 
-                const Block& block = temp->data; 
-                cout << "\nBlock " << block.blockNumber << " | " << block.currentHashNumber << " | " << block.previousHashNumber << " | " << block.currentTimeStamp << " information: "; 
-
-                for (size_t i = 0; i < block.information.size(); ++i) { 
-                    const pair<string, string>& info = block.information[i]; 
-                    cout << " " << info.first << ": " << info.second << " | "; 
+    int readFromLeader() { // Read and apply the batches sent by the leader, returns LEADER_LINK_LOST when the leader has gone and LEADER_LINK_REJECTED when it sent blocks that must not be applied
+        bool open = readAvailable(leaderFd, leaderInput); // Read the data
+        vector<pair<unsigned char, string> > frames; // Declare the complete frames
+        if (!takeFrames(leaderInput, frames, MAX_REPLICATION_FRAME_LENGTH)) { // If a frame is too large even for a batch
+            cout << "Error: Oversized frame received from the leader." << endl; // Tell the user that the leader sent a frame that cannot be a batch
+            return LEADER_LINK_REJECTED; // Stop replicating
+        }
+        for (size_t i = 0; i < frames.size(); ++i) { // For loop over the batches
+            size_t pos = 0; // Read position in the payload
+            uint32_t leaderCount, blockCount; // Declare the number of blocks on the leader and in the batch
+            if (frames[i].first != REPLICATION_BATCH || !readUint32(frames[i].second, pos, leaderCount) || !readUint32(frames[i].second, pos, blockCount)) { // If the batch is damaged
+                cout << "Error: Damaged batch received from the leader." << endl; // Tell the user that the batch is damaged
+                return LEADER_LINK_REJECTED; // Stop replicating, a leader that is still alive must not be taken over
+            }
+            vector<Block> blocks(blockCount, Block(0, "", "", 0)); // Declare the blocks of the batch
+            vector<const Block*> batch; // Declare the blocks whose signatures are checked
+            for (uint32_t j = 0; j < blockCount; j++) { // For loop over the blocks of the batch
+                if (!decodeBlock(frames[i].second, pos, blocks[j])) { // If the block is damaged
+                    cout << "Error: Damaged block received from the leader." << endl; // Tell the user that the block is damaged
+                    return LEADER_LINK_REJECTED; // Stop replicating, a leader that is still alive must not be taken over
                 }
-                cout << endl; 
-                temp = temp->next; 
-            } 
-            return; 
+                batch.push_back(&blocks[j]); // Check the block
+            }
+            vector<char> signaturesValid = verifyBlockSignatures(batch); // Check the signatures of the batch together
+            for (uint32_t j = 0; j < blockCount; j++) { // For loop to link the blocks
+                if (!signaturesValid[j]) { // If the block's signature does not hold
+                    cout << "Error: Block " << blocks[j].blockNumber << " from the leader has an invalid signature." << endl; // Tell the user that the leader sent a forged block
+                    return LEADER_LINK_REJECTED; // Stop replicating, a leader that is still alive must not be taken over
+                }
+                if (blockClock.isTooFarAhead(blocks[j].currentTimeStamp)) { // If the leader's clock is far ahead of this one
+                    cout << "Error: Block " << blocks[j].blockNumber << " from the leader is stamped more than " << MAX_CLOCK_DRIFT_MILLIS / 1000 << " seconds ahead of this machine's clock." << endl; // Tell the user, following it would drag this clock into the future
+                    return LEADER_LINK_REJECTED; // Stop replicating, a leader that is still alive must not be taken over
+                }
+                if (!chain.appendExistingBlock(blocks[j], true)) { // If the block does not link onto the chain
+                    cout << "Error: Block " << blocks[j].blockNumber << " from the leader does not link onto this chain." << endl; // Tell the user that the chains have diverged
+                    return LEADER_LINK_REJECTED; // Stop replicating, a leader that is still alive must not be taken over
+                }
+            }
+            uint32_t deletionCount; // Number of deletions in the batch
+            if (!readUint32(frames[i].second, pos, deletionCount) || deletionCount > (frames[i].second.size() - pos) / 5) { // If the deletions are missing or cut short
+                cout << "Error: Damaged batch received from the leader." << endl; // Tell the user that the batch is damaged
+                return LEADER_LINK_REJECTED; // Stop replicating, a leader that is still alive must not be taken over
+            }
+            for (uint32_t j = 0; j < deletionCount; j++) { // For loop over the deletions
+                uint32_t blockNumber; // Block deleted on the leader
+                readUint32(frames[i].second, pos, blockNumber); // Read it, the length was checked above
+                bool hard = frames[i].second[pos++] != 0; // Read whether it was hard
+                if (!chain.markDeleted(static_cast<int>(blockNumber), hard)) { // If this chain does not have the block
+                    cout << "Error: The leader deleted block " << blockNumber << ", which this chain does not have." << endl; // Tell the user that the chains have diverged
+                    return LEADER_LINK_REJECTED; // Stop replicating, a leader that is still alive must not be taken over
+                }
+            }
+            leaderBlockCount = static_cast<int>(leaderCount); // Remember the size of the leader's chain
+            lastLeaderMessage = time(0); // The leader is alive
         }
+        return open ? LEADER_LINK_OPEN : LEADER_LINK_LOST; // Keep replicating unless the leader closed the connection
+    }
 
-        int blockNumber = stoi(blockNumberInput);  //convert the string into int so user can search for speciic block
-        while (temp != nullptr) { 
-            const Block& block = temp->data; 
-            if (block.blockNumber == blockNumber) { 
-                found = true; 
-                cout << "\nBlock " << block.blockNumber << " | " << block.currentHashNumber << " | " << block.previousHashNumber << " | " << block.currentTimeStamp << " information: "; 
+    void promote() { // Take over as leader after the leader has been lost
+        close(leaderFd); // Close the link to the leader
+        leaderFd = -1; // No leader any more
+        readOnly = false; // Accept appends from now on
+        leaderInput.clear(); // Drop any partial batch
+        leaderOutput.clear(); // Drop any unsent data
+        cout << "\nLeader lost. Promoted to leader with " << chain.getCurrentBlockNumber() << " block(s)." << endl; // Tell the user that this server is now the leader
+    }
 
-                for (size_t i = 0; i < block.information.size(); ++i) { 
-                    const pair<string, string>& info = block.information[i]; 
-                    cout << " " << info.first << ": " << info.second << " | "; 
-                }
-                cout << endl; 
-                break; 
-            }
-            temp = temp->next; 
-        } 
+    void stopFollowing() { // Stop replicating from a leader that sent bad blocks, this server keeps the blocks it has and stays read only, as a second leader would split the chain
+        close(leaderFd); // Close the link to the leader
+        leaderFd = -1; // No leader any more
+        replicationStopped = true; // Report the server as a follower that has stopped
+        leaderInput.clear(); // Drop any partial batch
+        leaderOutput.clear(); // Drop any unsent data
+        cout << "\nReplication stopped with " << chain.getCurrentBlockNumber() << " block(s), serving read only. Check the leader, then restart this server with --follow." << endl; // Tell the user that the follower needs attention
+    }
 
-        if (!found) { 
-            cout << "\nBlock with number " << blockNumber << " not found." << endl; 
+    void acceptAll(int fd, vector<int>& accepted) { // Accept every connection waiting on a listening socket
+        int clientFd; // Socket of the new connection
+        while ((clientFd = accept(fd, nullptr, nullptr)) != -1) { // Accept every waiting connection
+            if (!setNonBlocking(clientFd)) { // If the socket could not be made non blocking
+                close(clientFd); // Close the socket
+                continue;
+            }
+            accepted.push_back(clientFd); // Add the connection
         }
     }
 
-    void softDeleteBlock(int blockNumber) { // Function to soft delete a block by block number
-        BlockNode* currentNode = head; // Create a temporary block node and set it to the head of the blockchain, this will be used to traverse the blockchain to search for the block
-        while (currentNode != nullptr && currentNode->data.blockNumber != blockNumber) { // While loop to traverse the blockchain to search for the block
-            currentNode = currentNode->next; // Move to the next block
-        }
+public: // Public members
+    ChainServer(Blockchain& blockchain, const string& path, mutex* blockchainMutex = nullptr) : chain(blockchain) { // Constructor for ChainServer, the mutex is held while the server uses the blockchain
+        chainMutex = blockchainMutex; // Set the lock of the blockchain
+        socketPath = path; // Set the socket path
+        listenFd = -1; // No socket yet
+        replicationListenFd = -1; // No followers yet
+        leaderFd = -1; // Not following a leader
+        lastLeaderMessage = 0; // Nothing received from a leader
+        readOnly = false; // Appends are accepted
+        replicationStopped = false; // Replication has not stopped
+        leaderBlockCount = 0; // No leader
+        shardSet = nullptr; // Not a shard
+        shardIndex = 0; // No shard
+    }
 
-        if (currentNode == nullptr) { // If the block was not found
-            cout << "Block with block number " << blockNumber << " not found." << endl; // Tell the user that the block with the specified block number was not found
-            return;
+    ~ChainServer() { // Destructor for ChainServer, closes every socket
+        for (size_t i = 0; i < sessions.size(); ++i) { // For loop to close the client sockets
+            close(sessions[i].fd); // Close the client socket
         }
-
-        if (currentNode->data.isSoftDeleted) { // If the block has already been soft deleted
-            cout << "Block with block number " << blockNumber << " has already been soft deleted." << endl; // Tell the user that the block with the specified block number has already been soft deleted
-            return;
+        for (size_t i = 0; i < followers.size(); ++i) { // For loop to close the follower sockets
+            close(followers[i].fd); // Close the follower socket
         }
-
-        if (currentNode->data.isHardDeleted) { // If the block has already been hard deleted
-            cout << "Block with block number " << blockNumber << " has been hard deleted and cannot be soft deleted." << endl; // Tell the user that the block with the specified block number has already been hard deleted and cannot be soft deleted
-            return;
+        if (leaderFd != -1) { // If following a leader
+            close(leaderFd); // Close the link to the leader
+        }
+        if (replicationListenFd != -1) { // If the replication socket is open
+            close(replicationListenFd); // Close the replication socket
+            unlink(replicationPath.c_str()); // Remove the socket file
+        }
+        if (listenFd != -1) { // If the listening socket is open
+            close(listenFd); // Close the listening socket
+            unlink(socketPath.c_str()); // Remove the socket file
         }
+    }
 
-        currentNode->data.isSoftDeleted = true; // Set the isSoftDeleted flag to true
-        cout << "Information in block with block number " << blockNumber << " has been soft deleted." << endl; // Tell the user that the information in the block with the specified block number has been soft deleted
+    bool start() { // Create the listening socket, returns false if the socket could not be created
+        listenFd = openListeningSocket(socketPath); // Listen for clients
+        return listenFd != -1; // The server is ready if the socket was created
     }
 
-    void hardDeleteBlock(int blockNumber) { // Function to hard delete a block by block number
-        BlockNode* currentNode = head; // Create a temporary block node and set it to the head of the blockchain, this will be used to traverse the blockchain to search for the block
-        while (currentNode != nullptr && currentNode->data.blockNumber != blockNumber) { // While loop to traverse the blockchain to search for the block
-            currentNode = currentNode->next; // Move to the next block
-        }
+    bool startReplication(const string& path) { // Listen for followers on the path passed in and stream every block to them, returns false if the socket could not be created
+        replicationPath = path; // Set the replication socket path
+        replicationListenFd = openListeningSocket(path); // Listen for followers
+        return replicationListenFd != -1; // Replication is ready if the socket was created
+    }
 
-        if (currentNode == nullptr) { // If the block was not found
-            cout << "Block with block number " << blockNumber << " not found." << endl; // Tell the user that the block with the specified block number was not found
-            return;
-        }
+    void serveShard(ShardedBlockchain& shards, int index) { // Serve one shard of a sharded chain, appends whose shipment belongs to another shard are refused so every block of a shipment stays in one shard
+        shardSet = &shards; // Set the shards
+        shardIndex = index; // Set the index of the shard
+    }
 
-        if (currentNode->data.isHardDeleted) { // If the block has already been hard deleted
-            cout << "Block with block number " << blockNumber << " has already been hard deleted." << endl; // Tell the user that the block with the specified block number has already been hard deleted
-            return;
-        }
+    void refuseAppends() { // Serve reads only, used for chains that only this process appends to
+        readOnly = true; // Refuse appends from clients
+    }
 
-        if (currentNode->data.isSoftDeleted) { // If the block has been soft deleted
-            cout << "Block with block number " << blockNumber << " has been soft deleted and cannot be hard deleted." << endl; // Tell the user that the block with the specified block number has been soft deleted and cannot be hard deleted
-            return;
+    bool follow(const string& leaderPath) { // Follow the leader listening on the path passed in, appends are refused until the leader is lost, returns false if the leader could not be reached
+        sockaddr_un address; // Address of the leader
+        if (!makeAddress(leaderPath, address)) { // If the path is too long
+            return false;
         }
-
-        currentNode->data.isHardDeleted = true; // Set the isHardDeleted flag to true
-        cout << "Block with block number " << blockNumber << " has been hard deleted." << endl; // Tell the user that the block with the specified block number has been hard deleted
+        leaderFd = socket(AF_UNIX, SOCK_STREAM, 0); // Create the socket
+        if (leaderFd == -1 || connect(leaderFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == -1 || !setNonBlocking(leaderFd)) { // If the leader could not be reached
+            cout << "Error: Unable to reach the leader on " << leaderPath << "." << endl; // Tell the user that the leader could not be reached
+            if (leaderFd != -1) { // If the socket was created
+                close(leaderFd); // Close the socket
+            }
+            leaderFd = -1; // Not following a leader
+            return false;
+        }
+        string hello; // Declare the hello message
+        appendUint32(hello, static_cast<uint32_t>(chain.getCurrentBlockNumber())); // Tell the leader how many blocks this server already has
+        queueFrame(leaderOutput, REPLICATION_HELLO, hello); // Queue the hello message
+        readOnly = true; // Appends go to the leader
+        lastLeaderMessage = time(0); // Give the leader time to send its first batch
+        return true;
     }
-};
 
-bool authenticate(const string& username, const string& password) { // Function to authenticate the user, this function takes a username and password as parameters
-    ifstream file("username_password.txt"); // Create an input file stream with the filename
-    if (!file.is_open()) { // If the file is not open
-        cout << "Error opening file." << endl; // Tell the user that there was an error opening the file
-        return false; // Return false
-    }
+    void run() { // Serve the clients until the server is asked to stop, every socket is non blocking so one slow client or follower never holds up the others
+        while (!serverStopRequested) { // Loop until a stop signal arrives
+            unique_lock<mutex> chainLock; // Lock on the blockchain, held for the whole round except while waiting
+            if (chainMutex != nullptr) { // If other threads use the blockchain
+                chainLock = unique_lock<mutex>(*chainMutex); // Lock it
+            }
+            vector<pollfd> pollFds; // Declare the sockets to wait on, in the order listening socket, clients, replication socket, followers, leader
+            pollfd entry; // Declare an entry
+            entry.fd = listenFd; // Wait for new clients
+            entry.events = POLLIN; // Wait for incoming connections
+            entry.revents = 0; // No events yet
+            pollFds.push_back(entry); // Add the entry
+            for (size_t i = 0; i < sessions.size(); ++i) { // For loop to add the client sockets
+                entry.fd = sessions[i].fd; // Wait on the client socket
+                entry.events = POLLIN | (sessions[i].output.empty() ? 0 : POLLOUT); // Wait for data, and for space when output is queued
+                pollFds.push_back(entry); // Add the entry
+            }
+            entry.fd = replicationListenFd; // Wait for new followers, poll ignores -1
+            entry.events = POLLIN; // Wait for incoming connections
+            pollFds.push_back(entry); // Add the entry
+            for (size_t i = 0; i < followers.size(); ++i) { // For loop to add the follower sockets
+                entry.fd = followers[i].fd; // Wait on the follower socket
+                entry.events = POLLIN | (followers[i].output.empty() ? 0 : POLLOUT); // Wait for data, and for space when a batch is queued
+                pollFds.push_back(entry); // Add the entry
+            }
+            entry.fd = leaderFd; // Wait on the leader, poll ignores -1
+            entry.events = POLLIN | (leaderOutput.empty() ? 0 : POLLOUT); // Wait for batches, and for space when the hello is queued
+            pollFds.push_back(entry); // Add the entry
+
+            int timeout = 500; // Wake up regularly to check the stop flag and send heartbeats
+            for (size_t i = 0; i < followers.size(); ++i) { // For loop over the followers
+                if (followers[i].nextBlockNumber != -1 && followers[i].nextBlockNumber < chain.getCurrentBlockNumber() && followers[i].output.empty()) { // If a follower is ready for its next batch
+                    timeout = 0; // Send it straight away
+                }
+            }
 
-    string lineUsernamePassword; // Declare a string to store each line of the file
-    while (getline(file, lineUsernamePassword)) { // While loop to read each line of the file
-        stringstream ss(lineUsernamePassword); // Create a string stream with the line
-        string storedUsername, storedPassword; // Declare strings to store the username and password from the file
-        if (getline(ss, storedUsername, ',') && getline(ss, storedPassword)) { // If the username and password are successfully read from the file
-            storedUsername.erase(remove_if(storedUsername.begin(), storedUsername.end(), ::isspace), storedUsername.end()); // Remove any whitespace from the stored username
-            storedPassword.erase(remove_if(storedPassword.begin(), storedPassword.end(), ::isspace), storedPassword.end()); // Remove any whitespace from the stored password
-            if (username == storedUsername && password == storedPassword) { // If the username and password match the stored username and password
-                file.close(); // Close the file
-                return true; // Return true
+            if (chainLock.owns_lock()) { // If the blockchain is locked
+                chainLock.unlock(); // Let other threads use it while waiting
+            }
+            if (poll(pollFds.data(), pollFds.size(), timeout) < 0 && errno != EINTR) { // Wait for activity
+                cout << "Error: Server poll failed." << endl; // Tell the user that waiting failed
+                return;
+            }
+            if (chainMutex != nullptr) { // If other threads use the blockchain
+                chainLock.lock(); // Lock it again for the rest of the round
+            }
+
+            size_t followerBase = sessions.size() + 2; // Position of the first follower in the poll entries
+            if (leaderFd != -1) { // If following a leader
+                short events = pollFds.back().revents; // Events reported for the leader
+                int link = LEADER_LINK_OPEN; // State of the link to the leader
+                if (events & (POLLIN | POLLHUP | POLLERR)) { // If the leader sent data or closed the connection
+                    link = readFromLeader(); // Apply the batches
+                }
+                if (link == LEADER_LINK_OPEN && !writePending(leaderFd, leaderOutput)) { // Send the hello message
+                    link = LEADER_LINK_LOST; // The socket has failed
+                }
+                if (link == LEADER_LINK_OPEN && time(0) - lastLeaderMessage > 3) { // If the leader has stopped sending heartbeats
+                    link = LEADER_LINK_LOST; // Treat the leader as lost
+                }
+                if (link == LEADER_LINK_LOST) { // If the leader is lost
+                    promote(); // Take over as leader
+                } else if (link == LEADER_LINK_REJECTED) { // If the leader sent bad blocks
+                    stopFollowing(); // Stay read only rather than become a second leader
+                }
+            }
+
+            vector<char> sessionOpen(sessions.size(), 1); // Flag for each session that stays open
+            for (size_t i = 0; i < sessions.size(); ++i) { // For loop to handle the requests of the clients
+                short events = pollFds[i + 1].revents; // Events reported for the client
+                if (events & (POLLIN | POLLHUP | POLLERR)) { // If the client sent data or closed the connection
+                    sessionOpen[i] = readFromClient(sessions[i]); // Read and handle the requests
+                }
+            }
+            bool durable = chain.waitForLog(); // Every append of this round reaches the log with one sync before any of them is acknowledged
+            for (size_t i = 0; i < sessions.size(); ++i) { // For loop to settle the append responses of this round
+                if (!durable) { // If the appends could not be written to the log
+                    for (size_t j = 0; j < sessions[i].appendResponses.size(); ++j) { // For loop over the append responses
+                        sessions[i].output[sessions[i].appendResponses[j]] = static_cast<char>(STATUS_NOT_DURABLE); // Tell the client the block is not kept
+                    }
+                }
+                sessions[i].appendResponses.clear(); // The responses can be sent
+            }
+
+            vector<ClientSession> openSessions; // Sessions that stay open after this round
+            for (size_t i = 0; i < sessions.size(); ++i) { // For loop to send the responses
+                bool open = sessionOpen[i]; // Flag to indicate if the session stays open
+                if (open) { // If the session is still open
+                    open = writePending(sessions[i].fd, sessions[i].output); // Send the queued responses
+                }
+                if (open) { // If the session is still open
+                    openSessions.push_back(sessions[i]); // Keep the session
+                } else { // If the session is closed
+                    close(sessions[i].fd); // Close the client socket
+                }
+            }
+            sessions.swap(openSessions); // Keep only the open sessions
+
+            streamToFollowers(); // Queue the blocks appended this round for the followers
+            vector<FollowerLink> openFollowers; // Followers that stay connected after this round
+            for (size_t i = 0; i < followers.size(); ++i) { // For loop to serve the followers
+                short events = pollFds[followerBase + i].revents; // Events reported for the follower
+                bool open = true; // Flag to indicate if the follower stays connected
+                if (events & (POLLIN | POLLHUP | POLLERR)) { // If the follower sent data or closed the connection
+                    open = readFromFollower(followers[i]); // Read the hello message
+                }
+                if (open) { // If the follower is still connected
+                    open = writePending(followers[i].fd, followers[i].output); // Send the queued batch
+                }
+                if (open) { // If the follower is still connected
+                    openFollowers.push_back(followers[i]); // Keep the follower
+                } else { // If the follower has gone
+                    close(followers[i].fd); // Close the follower socket
+                }
+            }
+            followers.swap(openFollowers); // Keep only the connected followers
+
+            vector<int> accepted; // Declare the new connections
+            if (pollFds[0].revents & POLLIN) { // If new clients are waiting
+                acceptAll(listenFd, accepted); // Accept them
+                for (size_t i = 0; i < accepted.size(); ++i) { // For loop over the new clients
+                    ClientSession session; // Declare the new session
+                    session.fd = accepted[i]; // Set the client socket
+                    sessions.push_back(session); // Add the session
+                }
+            }
+            accepted.clear(); // Clear the new connections
+            if (replicationListenFd != -1 && (pollFds[followerBase - 1].revents & POLLIN)) { // If new followers are waiting
+                acceptAll(replicationListenFd, accepted); // Accept them
+                for (size_t i = 0; i < accepted.size(); ++i) { // For loop over the new followers
+                    FollowerLink follower; // Declare the new follower
+                    follower.fd = accepted[i]; // Set the follower socket
+                    follower.nextBlockNumber = -1; // Wait for the follower to say how many blocks it has
+                    follower.nextDeletion = 0; // Set when the follower says hello
+                    follower.lastSent = 0; // Nothing sent yet
+                    followers.push_back(follower); // Add the follower
+                }
             }
         }
     }
+};
 
-    file.close(); // Close the file
-    return false; // Return false
-}
- 
-int main() { // Main function
+int main(int argc, char* argv[]) { // Main function, run with --server <socket path> to serve the blockchain to many clients instead of showing the menu, add --replicate <socket path> to stream blocks to followers, --follow <socket path> to follow a leader, or --shards <count> to serve that many chain shards, --difficulty <bits> to seal every block with a proof of work, --feed <name> to publish appended blocks to a shared memory change feed that --subscribe <name> [--from <block number>] reads, and --hot-blocks <count> [--cache-blocks <count>] to keep only the newest blocks in memory, --data-dir <directory> to keep the log, checkpoints and cold store there, or --self-test alone to check the hashing and signature code and exit
     srand(time(0)); // Seed the random number generator
 
+    if (argc == 2 && string(argv[1]) == "--self-test") { // Check the cryptography without logging in, exits with 1 if any check failed
+        bool passed = runCryptoSelfTest(); // Run the checks
+        cout << "\nSelf-test " << (passed ? "passed." : "FAILED.") << endl; // Tell the user the outcome
+        return passed ? 0 : 1;
+    }
+
+    unique_ptr<PersistenceWriter> writeAheadLog; // Write-ahead log, declared before the blockchain so it outlives any checkpoint the blockchain is still writing
     Blockchain blockchain; // Create a blockchain object
 
     cout << "\nInventory and Transportation Management System." << endl;
@@ -988,9 +6382,9 @@ int main() { // Main function
 
     int attempts = 0; // Declare an integer to store the number of login attempts
     bool authenticated = false; // Declare a boolean to store whether the user has been authenticated
+    string username; // Username of the operator, every block they add is signed with their key
     while (attempts < 3) { // While loop to limit the number of login attempts to 3
         cout << "\n\nEnter Username: "; // Prompt the user to enter their username
-        string username;
         cin >> username;
         cout << "\n\nEnter Password: "; // Prompt the user to enter their password
         string password;
@@ -1010,6 +6404,174 @@ int main() { // Main function
         return 0;
     }
 
+    string serverPath, replicationPath, leaderPath; // Socket paths given on the command line
+    string feedName, subscribeName; // Change feed published to and change feed read from
+    int64_t fromBlockNumber = 0; // Block number a subscriber starts from
+    int shardCount = 1; // Number of chain shards served
+    int difficulty = 0; // Leading zero bits of the proof of work, 0 when blocks are not sealed
+    long long hotBlocks = 0; // Blocks each chain keeps in memory, 0 keeps every block
+    long long cacheBlocks = DEFAULT_CACHE_BLOCKS; // Blocks the cache of the cold store holds
+    string dataDirectory = "."; // Directory of the log, checkpoints and cold store, every process serving a chain on one machine needs its own
+    for (int i = 1; i + 1 < argc; i += 2) { // For loop over the option and value pairs
+        string option = argv[i]; // Get the option
+        if (option == "--server") { // Serve clients on this socket
+            serverPath = argv[i + 1];
+        } else if (option == "--replicate") { // Stream blocks to followers connecting on this socket
+            replicationPath = argv[i + 1];
+        } else if (option == "--follow") { // Follow the leader streaming on this socket
+            leaderPath = argv[i + 1];
+        } else if (option == "--shards") { // Serve this many chain shards, each on its own thread
+            shardCount = atoi(argv[i + 1]);
+        } else if (option == "--difficulty") { // Seal every block with a proof of work of this many leading zero bits
+            char* end = nullptr; // End of the number
+            errno = 0; // Clear any earlier error
+            long bits = strtol(argv[i + 1], &end, 10); // Read the number
+            if (end == argv[i + 1] || *end != '\0' || errno == ERANGE || bits < 0 || bits > MAX_PROOF_OF_WORK_DIFFICULTY) { // If it is not a whole number from 0 to the maximum
+                cout << "\nInvalid difficulty " << argv[i + 1] << ", enter 0 to " << MAX_PROOF_OF_WORK_DIFFICULTY << " leading zero bits." << endl; // Tell the user the allowed range
+                return 1;
+            }
+            difficulty = static_cast<int>(bits);
+        } else if (option == "--feed") { // Publish appended blocks to this shared memory change feed
+            feedName = argv[i + 1];
+        } else if (option == "--subscribe") { // Read blocks from this shared memory change feed instead of serving
+            subscribeName = argv[i + 1];
+        } else if (option == "--from") { // Start reading the change feed from this block number
+            fromBlockNumber = atoll(argv[i + 1]);
+        } else if (option == "--hot-blocks") { // Keep this many of the newest blocks of each chain in memory and evict older ones to the cold store
+            hotBlocks = atoll(argv[i + 1]);
+        } else if (option == "--cache-blocks") { // Cache this many blocks read back from the cold store
+            cacheBlocks = atoll(argv[i + 1]);
+        } else if (option == "--data-dir") { // Keep the log, checkpoints and cold store in this directory
+            dataDirectory = argv[i + 1];
+            if (mkdir(dataDirectory.c_str(), 0755) != 0 && errno != EEXIST) { // If the directory does not exist and could not be made
+                cout << "\nUnable to create data directory " << dataDirectory << "." << endl; // Tell the user
+                return 1;
+            }
+        } else { // If the option is unknown
+            cout << "\nUnknown option " << option << "." << endl; // Tell the user that the option is unknown
+            return 1;
+        }
+    }
+
+    if (!subscribeName.empty()) { // If this process consumes a change feed
+        signal(SIGINT, requestServerStop); // Stop reading on Ctrl+C
+        signal(SIGTERM, requestServerStop); // Stop reading when asked to terminate
+        SharedChangeFeed feed(subscribeName, false); // Open the feed
+        if (!feed.isOpen() || !feed.subscribe(fromBlockNumber)) { // If the feed is missing or has no free consumer slot
+            cout << "\nUnable to subscribe to change feed " << subscribeName << "." << endl; // Tell the user
+            return 1;
+        }
+        cout << "\nReading change feed " << subscribeName << " from block " << fromBlockNumber << ". Press Ctrl+C to stop." << endl; // Tell the user where reading starts
+        Block block(0, "", "", 0); // Declare the block read
+        uint64_t latencyNanos = 0; // Time from publish to read
+        while (!serverStopRequested) { // Loop until a stop signal arrives
+            int status = feed.read(block, latencyNanos, 500); // Read the next block
+            if (status == FEED_BLOCK) { // If a block arrived
+                cout << "[" << latencyNanos / 1000 << " us] " << blockchain.formatBlock(block); // Show it with its latency
+            } else if (status == FEED_BEHIND) { // If the consumer fell behind the ring
+                cout << "Fell behind the feed, skipped to block " << feed.cursor() << ". Fetch the skipped blocks from the server." << endl; // Tell the user which blocks were missed
+            } else if (status == FEED_TOO_LARGE) { // If the block did not fit in the feed
+                cout << "Block " << block.blockNumber << " is too large for the feed. Fetch it from the server." << endl; // Tell the user which block to fetch
+            }
+        }
+        cout << "\nStopped at block " << feed.cursor() << ", resume with --from " << feed.cursor() << "." << endl; // Tell the user how to resume
+        return 0;
+    }
+
+    bool sharded = !serverPath.empty() && shardCount > 1; // Flag to indicate that the shards are served instead of the single chain
+    string dataPrefix = dataDirectory + "/blockchain"; // Start of the name of every data file
+    coldStore.configure(dataPrefix + "_cold.dat", static_cast<size_t>(max(0LL, hotBlocks)), static_cast<size_t>(max(0LL, cacheBlocks))); // Set the limits before any block is recovered, so a long chain is evicted as it is rebuilt
+    if (!sharded) { // The shards recover from their own files
+        if (!blockchain.recover(dataPrefix + "_checkpoint.dat", dataPrefix + "_wal.dat")) { // Rebuild the chain left by the last run from its checkpoint and log
+            return 1;
+        }
+        writeAheadLog.reset(new PersistenceWriter(dataPrefix + "_wal.dat")); // Open the log after recovery has cut off any torn record
+        blockchain.attachPersistence(writeAheadLog.get(), dataPrefix + "_checkpoint.dat"); // Log every append and deletion from now on
+    }
+    blockchain.enableProofOfWork(difficulty); // Seal the blocks appended from now on if asked
+    shared_ptr<const OperatorKey> operatorKey = loadOperatorKey(username); // Load the signing key of the operator who logged in
+    blockchain.enableSigning(operatorKey); // Sign the blocks appended from now on
+    blockchain.loadConsistencyRules("consistency_rules.txt"); // Check the shipments against the consistency rules, the built in rules are used if the file does not exist
+
+    if (!serverPath.empty()) { // If the program was started in server mode
+        signal(SIGINT, requestServerStop); // Stop the server on Ctrl+C
+        signal(SIGTERM, requestServerStop); // Stop the server when asked to terminate
+        signal(SIGPIPE, SIG_IGN); // A client closing early must not end the server
+
+        if (sharded) { // If the chain is split into shards
+            if (!replicationPath.empty() || !leaderPath.empty()) { // Replication works on a single chain
+                cout << "\nReplication cannot be combined with shards." << endl; // Tell the user that the options conflict
+                return 1;
+            }
+            ShardedBlockchain shardedChain(shardCount); // Create the shards and the root chain
+            if (!shardedChain.persist(dataPrefix)) { // Recover the shards and anchors left by the last run and log them from now on
+                return 1;
+            }
+            shardedChain.enableProofOfWork(difficulty); // Seal the shard blocks if asked
+            shardedChain.enableSigning(operatorKey); // Sign the shard blocks and anchors
+            vector<unique_ptr<ChainServer> > shardServers; // Declare a server for every shard and one for the root chain
+            for (int i = 0; i < shardCount; i++) { // For loop to create the shard servers
+                shardServers.push_back(unique_ptr<ChainServer>(new ChainServer(shardedChain.shard(i), serverPath + "." + to_string(i), &shardedChain.shardMutex(i)))); // Serve the shard on its own socket
+                shardServers.back()->serveShard(shardedChain, i); // Only take the shipments of the shard
+            }
+            shardServers.push_back(unique_ptr<ChainServer>(new ChainServer(shardedChain.rootChain(), serverPath + ".root", &shardedChain.rootChainMutex()))); // Serve the root chain
+            shardServers.back()->refuseAppends(); // Only the anchoring thread appends to the root chain
+            for (size_t i = 0; i < shardServers.size(); ++i) { // For loop to start the servers
+                if (!shardServers[i]->start()) { // If a server could not start
+                    return 1;
+                }
+            }
+
+            shardedChain.startAnchoring(1000); // Anchor the shard tips every second
+            vector<thread> serverThreads; // Declare a thread for every server, so the shards append on separate cores
+            for (size_t i = 0; i < shardServers.size(); ++i) { // For loop to start the threads
+                serverThreads.push_back(thread(&ChainServer::run, shardServers[i].get())); // Run the server on its own thread
+            }
+            cout << "\nServing " << shardCount << " shards on " << serverPath << ".0 to " << serverPath << "." << shardCount - 1 << " and the root chain on " << serverPath << ".root. Press Ctrl+C to stop." << endl; // Tell the user where the shards are served
+            for (size_t i = 0; i < serverThreads.size(); ++i) { // For loop to wait for the servers
+                serverThreads[i].join(); // Wait for the server to stop
+            }
+            shardedChain.stopAnchoring(); // Stop anchoring
+            shardedChain.anchor(); // Anchor the final tips
+            cout << "\nServer stopped. Shards and anchors " << (shardedChain.verify() ? "verified." : "FAILED verification.") << endl; // Tell the user that the server has stopped and whether the chains are intact
+            return 0;
+        }
+
+        ChainServer server(blockchain, serverPath); // Create the server
+        if (!server.start()) { // If the server could not start
+            return 1;
+        }
+        if (!replicationPath.empty() && !server.startReplication(replicationPath)) { // If followers were asked for but the socket could not be created
+            return 1;
+        }
+        if (!leaderPath.empty() && !server.follow(leaderPath)) { // If a leader was given but could not be reached
+            return 1;
+        }
+
+        ChangeFeed changeFeed; // In-process feed of appended blocks
+        unique_ptr<SharedChangeFeed> sharedFeed; // Shared memory feed read by other processes
+        atomic<bool> feedStopping(false); // Flag to stop the feed thread
+        thread feedThread; // Thread copying the in-process feed into the shared memory feed
+        if (!feedName.empty()) { // If a change feed was asked for
+            sharedFeed.reset(new SharedChangeFeed(feedName, true)); // Create the shared memory feed
+            if (!sharedFeed->isOpen()) { // If it could not be created
+                return 1;
+            }
+            sharedFeed->start(blockchain.getCurrentBlockNumber()); // Feed the blocks appended from now on
+            blockchain.attachChangeFeed(&changeFeed); // Publish every appended block
+            feedThread = thread(publishToSharedFeed, &changeFeed, sharedFeed.get(), static_cast<int64_t>(blockchain.getCurrentBlockNumber()), &feedStopping); // Start copying blocks into the shared memory feed
+        }
+
+        cout << "\nServing blockchain on " << serverPath << (leaderPath.empty() ? "" : " read only, following " + leaderPath) << ". Press Ctrl+C to stop." << endl; // Tell the user where the server is listening
+        server.run(); // Serve the clients until stopped
+        feedStopping.store(true); // Stop the feed thread
+        if (feedThread.joinable()) { // If the feed was running
+            feedThread.join(); // Wait for it
+        }
+        cout << "\nServer stopped." << endl; // Tell the user that the server has stopped
+        return 0;
+    }
+
     int userChoice; // Declare an integer to store the user's choice
     do { // Do-while loop to display the menu and process the user's choice
         cout << "\nBlockchain Menu\n"
@@ -1019,7 +6581,15 @@ int main() { // Main function
             << "4. Export to text file\n"
             << "5. Hard Delete Block\n"
             << "6. Soft Delete Block\n"
-            << "7. Exit\n"
+            << "7. Export to compressed segments\n"
+            << "8. Search Block in compressed segments\n"
+            << "9. Check if an ID exists\n"
+            << "10. View Shipment Lifecycle\n"
+            << "11. Query Blocks\n"
+            << "12. Check Consistency Rules\n"
+            << "13. Show Storage Statistics\n"
+            << "14. Audit Block Signatures\n"
+            << "15. Exit\n"
             << "Enter your choice: ";
         cin >> userChoice; // User input 
         cin.ignore(); // Ignore the newline character in the input buffer
@@ -1067,13 +6637,45 @@ int main() { // Main function
                 blockchain.softDeleteBlock(blockNumber);
                 break;
             }
-            case 7: // If the user chooses to exit the program
+            case 7: { // If the user chooses to export the blockchain to compressed segments
+                blockchain.exportCompressedSegments("blockchain_segment_");
+                break;
+            }
+            case 8: { // If the user chooses to read a block from the compressed segments
+                blockchain.searchCompressedSegments("blockchain_segment_");
+                break;
+            }
+            case 9: { // If the user chooses to check if an ID exists
+                blockchain.checkIdExists("blockchain_segment_");
+                break;
+            }
+            case 10: { // If the user chooses to view the lifecycle of a shipment
+                blockchain.displayShipmentLifecycle();
+                break;
+            }
+            case 11: { // If the user chooses to run a query
+                blockchain.queryChain();
+                break;
+            }
+            case 12: { // If the user chooses to check the consistency rules
+                blockchain.checkConsistency("consistency_rules.txt");
+                break;
+            }
+            case 13: { // If the user chooses to show the storage statistics
+                blockchain.storageStatistics();
+                break;
+            }
+            case 14: { // If the user chooses to audit the block signatures
+                blockchain.auditSignatures();
+                break;
+            }
+            case 15: // If the user chooses to exit the program
                 cout << "\nExit Program." << endl;
                 break;
             default: // If the user chooses an invalid option
                 cout << "\nInvalid choice. Please enter a valid choice." << endl;
         }
-    } while (userChoice != 7); // If user enters an invalid number
+    } while (userChoice != 15); // If user enters an invalid number
 
     return 0;
 }
\ No newline at end of file